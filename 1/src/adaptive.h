@@ -0,0 +1,592 @@
+#pragma once
+
+#include "bigint.h"
+#include "rational.h"
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// __int128 с std::hash, std::gcd и std::numeric_limits есть только в режиме GNU (-std=gnu++17)
+#if defined(__STRICT_ANSI__)
+#error "adaptive.h requires GNU extensions (-std=gnu++17)"
+#endif
+
+/// Представление AdaptiveRational
+enum class adaptive_level : unsigned char {
+    /// числитель и знаменатель - long long
+    small,
+    /// числитель и знаменатель - __int128
+    wide,
+    /// числитель и знаменатель - BigInt в куче
+    big,
+};
+
+/**
+    \brief НОД (неотрицательный) для встроенных типов и BigInt
+
+    Для встроенных типов НОД считается по беззнаковым модулям, так что
+    минимальное значение типа не переполняется при взятии модуля. Хотя бы
+    один аргумент должен быть положителен (знаменатель), тогда результат
+    помещается в I.
+*/
+template <class I>
+I adaptive_gcd(const I& a, const I& b) {
+    if constexpr (std::numeric_limits<I>::is_bounded) {
+        using U = std::make_unsigned_t<I>;
+        U x = a < 0 ? U(0) - U(a) : U(a);
+        U y = b < 0 ? U(0) - U(b) : U(b);
+        return I(std::gcd(x, y));
+    } else {
+        return get_max_delim(a, b);
+    }
+}
+
+/**
+    \brief Сумма несократимых дробей a/b + c/d в типе I
+
+    Сокращение по Кнуту: g = НОД(b, d), числитель a (d/g) + c (b/g),
+    знаменатель (b/g) d, затем сокращение на НОД(числитель, g). Возвращает
+    false при переполнении I (num и den тогда не определены).
+*/
+template <class I>
+bool adaptive_add(const I& a, const I& b, const I& c, const I& d, I& num, I& den) {
+    I g = adaptive_gcd(b, d);
+    I bg = b / g;
+    I dg = d / g;
+    I x;
+    I y;
+    if (mul_overflow(a, dg, &x) || mul_overflow(c, bg, &y) || add_overflow(x, y, &num) || mul_overflow(bg, d, &den)) {
+        return false;
+    }
+    if (num == 0) {
+        den = 1;
+        return true;
+    }
+    I g2 = adaptive_gcd(num, g);
+    if (g2 != 1) {
+        num /= g2;
+        den /= g2;
+    }
+    return true;
+}
+
+/// Произведение несократимых дробей a/b * c/d в типе I (перекрестное сокращение)
+template <class I>
+bool adaptive_mul(const I& a, const I& b, const I& c, const I& d, I& num, I& den) {
+    if (a == 0 || c == 0) {
+        num = 0;
+        den = 1;
+        return true;
+    }
+    I g1 = adaptive_gcd(a, d);
+    I g2 = adaptive_gcd(c, b);
+    return !mul_overflow(a / g1, c / g2, &num) && !mul_overflow(b / g2, d / g1, &den);
+}
+
+/**
+    \brief Рациональное число с автоматическим расширением
+
+    Начинает с числителя и знаменателя типа long long; при переполнении
+    операция повторяется в __int128, затем в BigInt (в куче). Результат
+    каждой операции хранится в наименьшем представлении, в которое он
+    помещается, так что после сокращения значения возвращаются к long long.
+    Дробь всегда несократима, знаменатель положителен.
+
+    Операции над двумя значениями уровня small выполняются без ветвлений на
+    другие представления и без выделения памяти.
+*/
+class AdaptiveRational {
+public:
+    AdaptiveRational() : small_{0, 1} {}
+
+    /// Конструктор из целого числа
+    AdaptiveRational(long long numerator) : small_{numerator, 1} {}
+
+    /// Конструктор по числителю и знаменателю
+    AdaptiveRational(long long numerator, long long denominator) {
+        check_denominator(denominator);
+        long long g = adaptive_gcd(numerator, denominator);
+        small_ = {numerator / g, denominator / g};
+    }
+
+    /// Конструктор по длинным числителю и знаменателю
+    AdaptiveRational(BigInt numerator, BigInt denominator) {
+        check_denominator(denominator);
+        BigInt g = get_max_delim(numerator, denominator);
+        assign_big(numerator / g, denominator / g);
+    }
+
+    /// Конструктор из RationalNumber
+    template <class T>
+    explicit AdaptiveRational(const RationalNumber<T>& other) :
+        AdaptiveRational(BigInt(other.get_numerator()), BigInt(other.get_denominator())) {}
+
+    AdaptiveRational(const AdaptiveRational& other) :
+        level_(other.level_), wide_(other.wide_)
+    {
+        if (other.big_) {
+            big_ = std::make_unique<big_value>(*other.big_);
+        }
+    }
+
+    /// Конструктор перемещения (исходное значение становится 0/1)
+    AdaptiveRational(AdaptiveRational&& other) noexcept :
+        level_(other.level_), wide_(other.wide_), big_(std::move(other.big_))
+    {
+        other.reset();
+    }
+
+    AdaptiveRational& operator= (const AdaptiveRational& other) {
+        if (this != &other) {
+            level_ = other.level_;
+            wide_ = other.wide_;
+            big_ = other.big_ ? std::make_unique<big_value>(*other.big_) : nullptr;
+        }
+        return *this;
+    }
+
+    /// Оператор перемещения (исходное значение становится 0/1)
+    AdaptiveRational& operator= (AdaptiveRational&& other) noexcept {
+        if (this != &other) {
+            level_ = other.level_;
+            wide_ = other.wide_;
+            big_ = std::move(other.big_);
+            other.reset();
+        }
+        return *this;
+    }
+
+    /// Текущее представление
+    adaptive_level level() const { return level_; }
+
+    /// Метод получения числителя
+    BigInt get_numerator() const {
+        switch (level_) {
+        case adaptive_level::small:
+            return small_.num;
+        case adaptive_level::wide:
+            return wide_.num;
+        default:
+            return big_->first;
+        }
+    }
+
+    /// Метод получения знаменателя
+    BigInt get_denominator() const {
+        switch (level_) {
+        case adaptive_level::small:
+            return small_.den;
+        case adaptive_level::wide:
+            return wide_.den;
+        default:
+            return big_->second;
+        }
+    }
+
+    /// Оператор преобразования в строку
+    operator std::string() const {
+        return to_string(get_numerator()) + "/" + to_string(get_denominator());
+    }
+
+    /// Оператор преобразования к double
+    explicit operator double() const {
+        if (level_ == adaptive_level::small) {
+            return double(small_.num) / double(small_.den);
+        }
+        return double(get_numerator()) / double(get_denominator());
+    }
+
+    /// Оператор унарного минуса
+    AdaptiveRational operator- () const {
+        AdaptiveRational res(*this);
+        switch (level_) {
+        case adaptive_level::small:
+            if (small_.num != std::numeric_limits<long long>::min()) {
+                res.small_.num = -small_.num;
+                return res;
+            }
+            res.assign_wide(-__int128(small_.num), small_.den);
+            return res;
+        case adaptive_level::wide:
+            // -min(__int128) не помещается в __int128, но такие значения хранятся как big
+            res.assign_wide(-wide_.num, wide_.den);
+            return res;
+        default:
+            res.big_->first = -big_->first;
+            return res;
+        }
+    }
+
+    friend AdaptiveRational abs(const AdaptiveRational& value) {
+        return value < 0 ? -value : value;
+    }
+
+    /// Оператор +=
+    AdaptiveRational& operator+= (const AdaptiveRational& rhs) {
+        if (level_ == adaptive_level::small && rhs.level_ == adaptive_level::small) {
+            long long num;
+            long long den;
+            if (adaptive_add(small_.num, small_.den, rhs.small_.num, rhs.small_.den, num, den)) {
+                small_ = {num, den};
+                return *this;
+            }
+        }
+        return combine(rhs, [](const auto& a, const auto& b, const auto& c, const auto& d, auto& num, auto& den) {
+            return adaptive_add(a, b, c, d, num, den);
+        });
+    }
+
+    /// Оператор -=
+    AdaptiveRational& operator-= (const AdaptiveRational& rhs) {
+        if (level_ == adaptive_level::small && rhs.level_ == adaptive_level::small &&
+            rhs.small_.num != std::numeric_limits<long long>::min())
+        {
+            long long num;
+            long long den;
+            if (adaptive_add(small_.num, small_.den, -rhs.small_.num, rhs.small_.den, num, den)) {
+                small_ = {num, den};
+                return *this;
+            }
+        }
+        return operator+=(-rhs);
+    }
+
+    /// Оператор *=
+    AdaptiveRational& operator*= (const AdaptiveRational& rhs) {
+        if (level_ == adaptive_level::small && rhs.level_ == adaptive_level::small) {
+            long long num;
+            long long den;
+            if (adaptive_mul(small_.num, small_.den, rhs.small_.num, rhs.small_.den, num, den)) {
+                small_ = {num, den};
+                return *this;
+            }
+        }
+        return combine(rhs, [](const auto& a, const auto& b, const auto& c, const auto& d, auto& num, auto& den) {
+            return adaptive_mul(a, b, c, d, num, den);
+        });
+    }
+
+    /// Оператор /=
+    AdaptiveRational& operator/= (const AdaptiveRational& rhs) {
+        if (rhs == 0) {
+            throw zero_division_error("division by zero");
+        }
+        if (level_ == adaptive_level::small && rhs.level_ == adaptive_level::small &&
+            rhs.small_.num != std::numeric_limits<long long>::min())
+        {
+            // a/b / (c/d) = a/b * (d/c), знак переносится в числитель
+            long long c = rhs.small_.den;
+            long long d = rhs.small_.num;
+            if (d < 0) {
+                c = -c;
+                d = -d;
+            }
+            long long num;
+            long long den;
+            if (adaptive_mul(small_.num, small_.den, c, d, num, den)) {
+                small_ = {num, den};
+                return *this;
+            }
+        }
+        return operator*=(rhs.inverse());
+    }
+
+    friend AdaptiveRational operator+ (AdaptiveRational lhs, const AdaptiveRational& rhs) { return lhs += rhs; }
+    friend AdaptiveRational operator- (AdaptiveRational lhs, const AdaptiveRational& rhs) { return lhs -= rhs; }
+    friend AdaptiveRational operator* (AdaptiveRational lhs, const AdaptiveRational& rhs) { return lhs *= rhs; }
+    friend AdaptiveRational operator/ (AdaptiveRational lhs, const AdaptiveRational& rhs) { return lhs /= rhs; }
+
+    /// Оператор равенства (представление единственно, т.к. дробь несократима)
+    friend bool operator== (const AdaptiveRational& lhs, const AdaptiveRational& rhs) {
+        if (lhs.level_ != rhs.level_) {
+            return false;
+        }
+        switch (lhs.level_) {
+        case adaptive_level::small:
+            return lhs.small_.num == rhs.small_.num && lhs.small_.den == rhs.small_.den;
+        case adaptive_level::wide:
+            return lhs.wide_.num == rhs.wide_.num && lhs.wide_.den == rhs.wide_.den;
+        default:
+            return *lhs.big_ == *rhs.big_;
+        }
+    }
+
+    friend bool operator!= (const AdaptiveRational& lhs, const AdaptiveRational& rhs) {
+        return !(lhs == rhs);
+    }
+
+    /// Оператор "меньше": сравнение a d < c b без переполнения
+    friend bool operator< (const AdaptiveRational& lhs, const AdaptiveRational& rhs) {
+        if (lhs.level_ == adaptive_level::small && rhs.level_ == adaptive_level::small) {
+            return __int128(lhs.small_.num) * rhs.small_.den < __int128(rhs.small_.num) * lhs.small_.den;
+        }
+        if (lhs.level_ != adaptive_level::big && rhs.level_ != adaptive_level::big) {
+            __int128 x;
+            __int128 y;
+            if (!__builtin_mul_overflow(lhs.wide_num(), rhs.wide_den(), &x) &&
+                !__builtin_mul_overflow(rhs.wide_num(), lhs.wide_den(), &y))
+            {
+                return x < y;
+            }
+        }
+        return lhs.get_numerator() * rhs.get_denominator() < rhs.get_numerator() * lhs.get_denominator();
+    }
+
+    friend bool operator> (const AdaptiveRational& lhs, const AdaptiveRational& rhs) { return rhs < lhs; }
+    friend bool operator<= (const AdaptiveRational& lhs, const AdaptiveRational& rhs) { return !(rhs < lhs); }
+    friend bool operator>= (const AdaptiveRational& lhs, const AdaptiveRational& rhs) { return !(lhs < rhs); }
+
+    /// Оператор вывода на поток вывода
+    friend std::ostream& operator<< (std::ostream& os, const AdaptiveRational& arg) {
+        return os << std::string(arg);
+    }
+
+    /**
+        \brief Хэш значения
+
+        Значение всегда хранится на самом низком подходящем уровне, поэтому
+        small и wide хэшируются как __int128, а big - по разрядам BigInt.
+    */
+    std::size_t hash() const {
+        switch (level_) {
+        case adaptive_level::small:
+            return hash_combine(std::hash<__int128>{}(small_.num), std::hash<__int128>{}(small_.den));
+        case adaptive_level::wide:
+            return hash_combine(std::hash<__int128>{}(wide_.num), std::hash<__int128>{}(wide_.den));
+        default:
+            return hash_combine(big_->first.hash(), big_->second.hash());
+        }
+    }
+
+private:
+    struct small_value {
+        long long num;
+        long long den;
+    };
+
+    struct wide_value {
+        __int128 num;
+        __int128 den;
+    };
+
+    using big_value = std::pair<BigInt, BigInt>;
+
+    template <class I>
+    static void check_denominator(const I& denominator) {
+        if (denominator == 0) {
+            throw zero_division_error("denominator cannot be zero");
+        }
+        if (denominator < 0) {
+            throw negative_denominator_error("denominator cannot be negative");
+        }
+    }
+
+    /// Сброс в 0/1 уровня small
+    void reset() noexcept {
+        level_ = adaptive_level::small;
+        small_ = {0, 1};
+        big_.reset();
+    }
+
+    __int128 wide_num() const { return level_ == adaptive_level::small ? small_.num : wide_.num; }
+    __int128 wide_den() const { return level_ == adaptive_level::small ? small_.den : wide_.den; }
+
+    /// Запись несократимой дроби __int128 в наименьшее представление
+    void assign_wide(__int128 num, __int128 den) {
+        big_.reset();
+        const __int128 min = std::numeric_limits<long long>::min();
+        const __int128 max = std::numeric_limits<long long>::max();
+        if (num >= min && num <= max && den <= max) {
+            level_ = adaptive_level::small;
+            small_ = {(long long)num, (long long)den};
+        } else {
+            level_ = adaptive_level::wide;
+            wide_ = {num, den};
+        }
+    }
+
+    /// Запись несократимой дроби BigInt в наименьшее представление
+    void assign_big(BigInt num, BigInt den) {
+        if (num.fits<__int128>() && den.fits<__int128>() && num != BigInt(std::numeric_limits<__int128>::min())) {
+            assign_wide(static_cast<__int128>(num), static_cast<__int128>(den));
+            return;
+        }
+        level_ = adaptive_level::big;
+        if (big_) {
+            big_->first = std::move(num);
+            big_->second = std::move(den);
+        } else {
+            big_ = std::make_unique<big_value>(std::move(num), std::move(den));
+        }
+    }
+
+    /// Медленный путь: повтор операции в __int128, затем в BigInt
+    template <class Op>
+    AdaptiveRational& combine(const AdaptiveRational& rhs, Op op) {
+        if (level_ != adaptive_level::big && rhs.level_ != adaptive_level::big) {
+            __int128 num;
+            __int128 den;
+            if (op(wide_num(), wide_den(), rhs.wide_num(), rhs.wide_den(), num, den) &&
+                num != std::numeric_limits<__int128>::min())
+            {
+                assign_wide(num, den);
+                return *this;
+            }
+        }
+        BigInt num;
+        BigInt den;
+        op(get_numerator(), get_denominator(), rhs.get_numerator(), rhs.get_denominator(), num, den);
+        assign_big(std::move(num), std::move(den));
+        return *this;
+    }
+
+    AdaptiveRational inverse() const {
+        AdaptiveRational res;
+        BigInt num = get_numerator();
+        BigInt den = get_denominator();
+        if (num < 0) {
+            num = -num;
+            den = -den;
+        }
+        res.assign_big(std::move(den), std::move(num));
+        return res;
+    }
+
+    adaptive_level level_ = adaptive_level::small;
+    union {
+        small_value small_;
+        wide_value wide_;
+    };
+    std::unique_ptr<big_value> big_;
+};
+
+namespace std {
+
+template <>
+struct hash<AdaptiveRational> {
+    std::size_t operator() (const AdaptiveRational& num) const {
+        return num.hash();
+    }
+};
+
+}
+
+/**
+    \brief Класс с тестами для класса AdaptiveRational
+
+    Данный класс содержит тесты переходов между представлениями.
+*/
+class AdaptiveRationalTest {
+public:
+    void operator() () {
+        AdaptiveRational a(3, 5);
+        AdaptiveRational b(5, 6);
+        if (a + b != AdaptiveRational(43, 30) || a - b != AdaptiveRational(-7, 30) ||
+            a * b != AdaptiveRational(1, 2) || a / b != AdaptiveRational(18, 25))
+        {
+            throw test_failed_error("adaptive arithmetic test failed");
+        }
+        if (!(a < b) || a >= b || AdaptiveRational(4, 6) != AdaptiveRational(2, 3) || std::string(-a) != "-3/5") {
+            throw test_failed_error("adaptive comparison test failed");
+        }
+        // RationalNumber<int> здесь выбрасывает overflow_error
+        AdaptiveRational big = 1000000000;
+        big *= 1000000000;
+        big *= 1000000000;
+        if (big.level() != adaptive_level::wide || std::string(big) != "1000000000000000000000000000/1") {
+            throw test_failed_error("wide promotion test failed");
+        }
+        big *= big;
+        if (big.level() != adaptive_level::big) {
+            throw test_failed_error("big promotion test failed");
+        }
+        big /= AdaptiveRational(1000000000000000000ll) * 1000000000000000000ll * 1000000000;
+        if (big.level() != adaptive_level::small || big != 1000000000) {
+            throw test_failed_error("demotion test failed");
+        }
+        AdaptiveRational harmonic;
+        for (int k = 1; k <= 100; ++k) {
+            harmonic += AdaptiveRational(1, k);
+        }
+        if (harmonic.get_numerator() != BigInt("14466636279520351160221518043104131447711") ||
+            harmonic.get_denominator() != BigInt("2788815009188499086581352357412492142272"))
+        {
+            throw test_failed_error("adaptive harmonic test failed");
+        }
+        for (int k = 100; k >= 1; --k) {
+            harmonic -= AdaptiveRational(1, k);
+        }
+        if (harmonic != 0 || harmonic.level() != adaptive_level::small) {
+            throw test_failed_error("adaptive cancellation test failed");
+        }
+        AdaptiveRational min = std::numeric_limits<long long>::min();
+        if (-min <= 0 || (-min).level() != adaptive_level::wide || -(-min) != min || abs(min) != -min) {
+            throw test_failed_error("adaptive negation test failed");
+        }
+        if (a / AdaptiveRational(-5, 6) != AdaptiveRational(-18, 25) || (a / -a).get_denominator() != 1 ||
+            AdaptiveRational(1) / min != AdaptiveRational(-1) / -min || (AdaptiveRational(1) / min).level() != adaptive_level::wide ||
+            (min / AdaptiveRational(1, 2)).level() != adaptive_level::wide || min / min != 1)
+        {
+            throw test_failed_error("adaptive division test failed");
+        }
+        {
+            // НОД с LLONG_MIN считается по модулям без переполнения
+            const long long m = std::numeric_limits<long long>::min();
+            if (adaptive_gcd(m, 6ll) != 2 || adaptive_gcd(m, 1ll) != 1 || AdaptiveRational(m, 4) != AdaptiveRational(m / 4) ||
+                (min * AdaptiveRational(3, 2)).level() != adaptive_level::wide || min * AdaptiveRational(1, 2) != m / 2)
+            {
+                throw test_failed_error("adaptive min gcd test failed");
+            }
+        }
+        if (AdaptiveRational(RationalNumber<int>(2, 4)) != AdaptiveRational(1, 2) || double(AdaptiveRational(1, 4)) != 0.25) {
+            throw test_failed_error("adaptive conversion test failed");
+        }
+        bool catched = false;
+        try {
+            a /= AdaptiveRational(0);
+        } catch (zero_division_error&) {
+            catched = true;
+        }
+        if (!catched) {
+            throw test_failed_error("adaptive zero division test failed");
+        }
+        {
+            // равные значения, полученные на разных уровнях, имеют равный хэш
+            std::hash<AdaptiveRational> adaptive_hash;
+            BigInt big("1267650600228229401496703205376");
+            AdaptiveRational huge(big, BigInt(3));
+            if (adaptive_hash(AdaptiveRational(1, 3)) != adaptive_hash(huge / AdaptiveRational(big, BigInt(1))) ||
+                adaptive_hash(huge * AdaptiveRational(3) - AdaptiveRational(big, BigInt(1)) + AdaptiveRational(5)) !=
+                    adaptive_hash(AdaptiveRational(5)) ||
+                adaptive_hash(AdaptiveRational(1, 3)) == adaptive_hash(AdaptiveRational(-1, 3)))
+            {
+                throw test_failed_error("hash test failed");
+            }
+        }
+        {
+            // перемещенное значение уровня big становится нулем уровня small
+            AdaptiveRational from(BigInt("1361129467683753853853498429727072845824"), BigInt(3));
+            AdaptiveRational to(std::move(from));
+            AdaptiveRational assigned;
+            assigned = std::move(to);
+            if (from.level() != adaptive_level::small || to.level() != adaptive_level::small ||
+                from != 0 || to.get_numerator() != 0 || to.get_denominator() != 1 || std::string(from) != "0/1" ||
+                std::hash<AdaptiveRational>()(to) != std::hash<AdaptiveRational>()(AdaptiveRational()) ||
+                assigned.level() != adaptive_level::big ||
+                assigned * AdaptiveRational(3) != AdaptiveRational(BigInt("1361129467683753853853498429727072845824"), BigInt(1)))
+            {
+                throw test_failed_error("adaptive move test failed");
+            }
+            from = AdaptiveRational(2, 3);
+            if (from != AdaptiveRational(2, 3)) {
+                throw test_failed_error("adaptive moved-from reuse test failed");
+            }
+        }
+        std::cout << "adaptive rational tests completed" << std::endl;
+    }
+};
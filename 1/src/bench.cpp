@@ -0,0 +1,928 @@
+#include "rational.h"
+#include "bigint.h"
+#include "adaptive.h"
+#include "matrix.h"
+#include "solver.h"
+#include "exact.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// Счетчик выделений памяти (для сравнения числа временных объектов)
+static std::size_t allocations = 0;
+
+/// Выделение памяти через malloc с подсчетом (общее для всех форм operator new)
+static void* counted_alloc(std::size_t size, std::size_t align = 0) {
+    ++allocations;
+    size = size ? size : 1;
+    void* p = align > alignof(std::max_align_t) ?
+        std::aligned_alloc(align, (size + align - 1) / align * align) : std::malloc(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new(std::size_t size) {
+    return counted_alloc(size);
+}
+
+void* operator new[](std::size_t size) {
+    return counted_alloc(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    return counted_alloc(size, std::size_t(align));
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) {
+    return counted_alloc(size, std::size_t(align));
+}
+
+// все формы operator delete освобождают память через free, как и выделили
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+/// Количество выделений памяти при выполнении функции
+std::size_t count_allocations(const std::function<void()>& f) {
+    auto before = allocations;
+    f();
+    return allocations - before;
+}
+
+/// Замер времени выполнения функции (лучшее из нескольких запусков), мс
+double measure(const std::function<void()>& f, int repeats = 3) {
+    double best = 0;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto finish = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(finish - start).count();
+        if (i == 0 || ms < best) {
+            best = ms;
+        }
+    }
+    return best;
+}
+
+/// Печать строки результата
+void report(const std::string& name, const std::string& backend, double ms) {
+    std::cout << std::left << std::setw(28) << name << std::setw(10) << backend
+        << std::right << std::setw(12) << std::fixed << std::setprecision(3) << ms << " ms" << std::endl;
+}
+
+/// Случайная разреженная матрица n x n с per_row элементами в строке
+template <template <class...> class M>
+Matrix<double, M> random_sparse(unsigned n, unsigned per_row, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<unsigned> col(1, n);
+    std::uniform_real_distribution<double> val(1, 2);
+    typename Matrix<double, M>::storage_type map;
+    for (unsigned i = 1; i <= n; ++i) {
+        std::map<unsigned, double> row;
+        for (unsigned k = 0; k < per_row; ++k) {
+            row[col(gen)] = val(gen);
+        }
+        for (const auto& [j, v] : row) {
+            storage_append(map, i, j, v);
+        }
+    }
+    return Matrix<double, M>(map, n, n, 1e-12);
+}
+
+/// Сравнение контейнера по умолчанию и CSR
+template <template <class...> class M>
+void bench_backend(const std::string& backend, unsigned n, unsigned per_row) {
+    auto a = random_sparse<M>(n, per_row, 1);
+    auto b = random_sparse<M>(n, per_row, 2);
+    report("build", backend, measure([&] { random_sparse<M>(n, per_row, 3); }));
+    report("element access", backend, measure([&] {
+        double sum = 0;
+        for (unsigned i = 1; i <= n; ++i) {
+            for (unsigned j = 1; j <= 5; ++j) {
+                sum += a(i, j * (n / 5));
+            }
+        }
+        if (sum < 0) {
+            std::cout << sum;
+        }
+    }, 1));
+    report("operator+=", backend, measure([&] { auto c = a; c += b; }));
+    report("operator*=", backend, measure([&] { auto c = a; c *= b; }, 1));
+    report("operator~", backend, measure([&] { auto c = ~a; }));
+    auto a_copy = a;
+    report("operator==", backend, measure([&] {
+        if (!(a == a_copy)) {
+            std::cout << "not equal" << std::endl;
+        }
+    }));
+    auto a_other = a;
+    a_other[std::make_pair(n, n)] += 1;
+    report("copy + content_hash", backend, measure([&] { auto c = a; c.content_hash(); }, 1));
+    a.content_hash();
+    a_other.content_hash();
+    report("operator== (hashed)", backend, measure([&] {
+        if (a == a_other) {
+            std::cout << "equal" << std::endl;
+        }
+    }));
+    report("to_file_string", backend, measure([&] { a.to_file_string(); }));
+}
+
+void bench_csr() {
+    const unsigned n = 2000;
+    const unsigned per_row = 8;
+    std::cout << "== csr vs map: " << n << "x" << n << ", " << per_row << " per row ==" << std::endl;
+    bench_backend<std::map>("map", n, per_row);
+    bench_backend<csr_map>("csr", n, per_row);
+}
+
+void bench_spgemm() {
+    const unsigned n = 100000;
+    const unsigned per_row = 4;
+    std::cout << "== spgemm: " << n << "x" << n << ", " << per_row << " per row ==" << std::endl;
+    auto a = random_sparse<std::map>(n, per_row, 1);
+    auto b = random_sparse<std::map>(n, per_row, 2);
+    report("operator*=", "map", measure([&] { auto c = a; c *= b; }, 1));
+    auto ca = random_sparse<csr_map>(n, per_row, 1);
+    auto cb = random_sparse<csr_map>(n, per_row, 2);
+    report("operator*=", "csr", measure([&] { auto c = ca; c *= cb; }, 1));
+}
+
+/// Поэлементное заполнение и чтение через operator[] / operator()
+template <template <class...> class M>
+void bench_fill_backend(const std::string& backend, unsigned n) {
+    report("fill by operator[]", backend, measure([&] {
+        Matrix<double, M> m(n, n, 1e-12);
+        for (unsigned i = 1; i <= n; ++i) {
+            m[std::make_pair(i, i)] = 1;
+            m[std::make_pair(i, n + 1 - i)] = 2;
+        }
+    }, 1));
+    report("fill by from_triplets", backend, measure([&] {
+        std::vector<std::tuple<unsigned, unsigned, double>> coo;
+        coo.reserve(2 * n);
+        for (unsigned i = 1; i <= n; ++i) {
+            coo.emplace_back(i, i, 1);
+            coo.emplace_back(i, n + 1 - i, 2);
+        }
+        Matrix<double, M>::from_triplets(coo, n, n, 1e-12, triplet_duplicates::overwrite);
+    }, 1));
+    Matrix<double, M> m(n, n, 1e-12);
+    for (unsigned i = 1; i <= n; ++i) {
+        m[std::make_pair(i, i)] = 1;
+    }
+    report("read by operator()", backend, measure([&] {
+        double sum = 0;
+        for (unsigned i = 1; i <= n; ++i) {
+            sum += m(i, i) + m(i, n + 1 - i);
+        }
+        if (sum < 0) {
+            std::cout << sum;
+        }
+    }));
+}
+
+void bench_fill() {
+    const unsigned n = 100000;
+    std::cout << "== element-wise fill: " << n << " rows ==" << std::endl;
+    bench_fill_backend<std::map>("map", n);
+    bench_fill_backend<csr_map>("csr", n);
+}
+
+void bench_parallel() {
+    const unsigned n = 100000;
+    const unsigned per_row = 8;
+    std::cout << "== parallel: " << n << "x" << n << ", " << per_row << " per row, "
+        << std::thread::hardware_concurrency() << " hardware threads ==" << std::endl;
+    auto a = random_sparse<csr_map>(n, per_row, 1);
+    auto b = random_sparse<csr_map>(n, per_row, 2);
+    for (unsigned threads : {1u, 2u, 4u, 8u}) {
+        auto policy = threads == 1 ? Matrix_execution::sequential() : Matrix_execution::parallel(threads);
+        auto name = std::to_string(threads) + " thr";
+        report("multiply", name, measure([&] { auto c = a; c.multiply(b, policy); }, 1));
+        report("add", name, measure([&] { auto c = a; c.add(b, policy); }));
+        report("transpose", name, measure([&] { a.transpose(policy); }));
+    }
+}
+
+/// Случайная плотная матрица
+template <template <class...> class M>
+Matrix<double, M> random_dense(unsigned n, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> val(-1, 1);
+    Matrix<double, M> res(n, n, 1e-300);
+    for (unsigned i = 1; i <= n; ++i) {
+        for (unsigned j = 1; j <= n; ++j) {
+            res[std::make_pair(i, j)] = val(gen);
+        }
+    }
+    return res;
+}
+
+void bench_dense() {
+    std::cout << "== dense gemm ==" << std::endl;
+    for (unsigned n : {256u, 512u, 1024u}) {
+        auto a = random_dense<dense_map>(n, 1);
+        auto b = random_dense<dense_map>(n, 2);
+        double ms = measure([&] { auto c = a; c *= b; });
+        report("dense " + std::to_string(n), "blocked", ms);
+        std::cout << "    " << 2.0 * n * n * n / ms / 1e6 << " GFLOP/s" << std::endl;
+        if (n <= 256) {
+            auto sa = random_dense<std::map>(n, 1);
+            auto sb = random_dense<std::map>(n, 2);
+            report("dense " + std::to_string(n), "map", measure([&] { auto c = sa; c *= sb; }, 1));
+        }
+    }
+}
+
+/// Степени разреженной матрицы: заполненность растет с каждым умножением
+template <template <class...> class M>
+Matrix<double, M> bench_hybrid_backend(const std::string& backend, unsigned n, unsigned per_row) {
+    auto a = random_sparse<M>(n, per_row, 1);
+    for (int k = 1; k <= 4; ++k) {
+        auto b = random_sparse<M>(n, per_row, k + 1);
+        report("power " + std::to_string(k + 1), backend, measure([&] { auto c = a; c *= b; }, 1));
+        a *= b;
+        a *= 1.0 / 4;
+    }
+    return a;
+}
+
+void bench_hybrid() {
+    const unsigned n = 600;
+    const unsigned per_row = 6;
+    std::cout << "== hybrid: products of " << n << "x" << n << ", " << per_row << " per row ==" << std::endl;
+    bench_hybrid_backend<csr_map>("csr", n, per_row);
+    bench_hybrid_backend<dense_map>("dense", n, per_row);
+    auto a = bench_hybrid_backend<hybrid_map>("hybrid", n, per_row);
+    const auto& st = a.get_map().stats();
+    std::cout << "    checks " << st.checks << ", to dense " << st.to_dense
+        << ", to sparse " << st.to_sparse << ", moved " << st.moved_elements << std::endl;
+}
+
+/// Разбор как до отображения файла: getline, split, stod
+double load_by_lines(const std::string& path) {
+    std::ifstream in(path);
+    std::string s;
+    double sum = 0;
+    while (std::getline(in, s)) {
+        auto w = split(s);
+        if (w.size() == 3 && w[0][0] != '#') {
+            sum += stoui(w[0]) + stoui(w[1]) + std::stod(w[2]);
+        }
+    }
+    return sum;
+}
+
+/// Печать пропускной способности
+void report_throughput(const std::string& name, const std::string& backend, double ms, double bytes) {
+    report(name, backend, ms);
+    std::cout << "    " << bytes / ms / 1e3 << " MB/s" << std::endl;
+}
+
+void bench_load() {
+    const unsigned n = 200000;
+    const unsigned per_row = 10;
+    const std::string path = "bench_load_tmp";
+    {
+        std::ofstream out(path);
+        std::mt19937 gen(1);
+        std::uniform_real_distribution<double> val(-100, 100);
+        out << "matrix float " << n << " " << n << "\n";
+        for (unsigned i = 1; i <= n; ++i) {
+            for (unsigned k = 1; k <= per_row; ++k) {
+                out << i << " " << k * (n / per_row) << " " << std::to_string(val(gen)) << "\n";
+            }
+        }
+    }
+    double bytes = Mapped_file(path).size();
+    std::cout << "== load: " << n * per_row << " elements, " << bytes / 1e6 << " MB ==" << std::endl;
+    report_throughput("getline + split", "-", measure([&] { load_by_lines(path); }, 1), bytes);
+    report_throughput("from_file", "map", measure([&] { Matrix<double>::from_file(path, 1e-9); }, 1), bytes);
+    report_throughput("from_file", "csr", measure([&] { Matrix<double, csr_map>::from_file(path, 1e-9); }), bytes);
+    std::cout << "    " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    for (unsigned threads : {2u, 4u, 8u}) {
+        auto policy = Matrix_execution::parallel(threads);
+        report_throughput("from_file " + std::to_string(threads) + " thr", "csr", measure([&] {
+            Matrix<double, csr_map>::from_file(path, 1e-9, policy);
+        }), bytes);
+    }
+    std::remove(path.c_str());
+}
+
+void bench_binary() {
+    const unsigned n = 200000;
+    const unsigned per_row = 10;
+    const std::string text_path = "bench_text_tmp";
+    const std::string binary_path = "bench_binary_tmp";
+    auto a = random_sparse<csr_map>(n, per_row, 1);
+    std::ofstream(text_path) << a.to_file_string();
+    report("to_binary_file", "csr", measure([&] { a.to_binary_file(binary_path); }));
+    std::cout << "== binary: " << a.get_map().nnz() << " elements, text " << Mapped_file(text_path).size() / 1e6
+        << " MB, binary " << Mapped_file(binary_path).size() / 1e6 << " MB ==" << std::endl;
+    report("from_file", "csr", measure([&] { Matrix<double, csr_map>::from_file(text_path, 1e-9); }));
+    report("from_binary_file", "csr", measure([&] { Matrix<double, csr_map>::from_binary_file(binary_path, 1e-9); }));
+    report("open_binary_file", "view", measure([&] {
+        auto view = Matrix<double, csr_map>::open_binary_file(binary_path);
+        if (view(n / 2, n / 2) < 0) {
+            std::cout << "";
+        }
+    }));
+    std::remove(text_path.c_str());
+    std::remove(binary_path.c_str());
+}
+
+/// Сборка строки как до буферизованной записи: += std::to_string
+template <class M>
+std::string write_by_concat(const M& m) {
+    std::string res = "matrix float " + std::to_string(m.get_rows_num()) + " " + std::to_string(m.get_cols_num()) + "\n";
+    for (const auto& [row_num, row] : m.get_map()) {
+        for (const auto& [col_num, elem] : row) {
+            res += std::to_string(row_num) + " " + std::to_string(col_num) + " ";
+            res += std::to_string(double(elem)) + "\n";
+        }
+    }
+    return res;
+}
+
+void bench_write() {
+    const unsigned n = 200000;
+    const unsigned per_row = 10;
+    const std::string path = "bench_write_tmp";
+    auto a = random_sparse<csr_map>(n, per_row, 1);
+    double bytes = a.to_file_string().size();
+    std::cout << "== write: " << a.get_map().nnz() << " elements, " << bytes / 1e6 << " MB ==" << std::endl;
+    report_throughput("+= std::to_string", "csr", measure([&] { write_by_concat(a); }), bytes);
+    report_throughput("to_file_string", "csr", measure([&] { a.to_file_string(); }), bytes);
+    report_throughput("write_to file", "csr", measure([&] {
+        std::ofstream out(path);
+        a.write_to(out);
+    }), bytes);
+    std::remove(path.c_str());
+}
+
+/// Линейная комбинация a + b - c * 2 по шагам и одним выражением
+template <template <class...> class M>
+void bench_expr_backend(const std::string& backend, unsigned n, unsigned per_row) {
+    auto a = random_sparse<M>(n, per_row, 1);
+    auto b = random_sparse<M>(n, per_row, 2);
+    auto c = random_sparse<M>(n, per_row, 3);
+    // по шагам: копия a, слияние с b, копия c, умножение, отрицание, слияние
+    auto stepwise = [&] {
+        auto res = a;
+        res += b;
+        auto scaled = c;
+        scaled *= 2.0;
+        res += -scaled;
+    };
+    auto fused = [&] {
+        Matrix<double, M> res = a + b - c * 2.0;
+    };
+    report("a + b - c * 2 stepwise", backend, measure(stepwise));
+    std::cout << "    " << count_allocations(stepwise) << " allocations, 6 passes" << std::endl;
+    report("a + b - c * 2 fused", backend, measure(fused));
+    std::cout << "    " << count_allocations(fused) << " allocations, 1 pass" << std::endl;
+}
+
+void bench_expr() {
+    const unsigned n = 100000;
+    const unsigned per_row = 8;
+    std::cout << "== expression templates: " << n << "x" << n << ", " << per_row << " per row ==" << std::endl;
+    bench_expr_backend<std::map>("map", n, per_row);
+    bench_expr_backend<csr_map>("csr", n, per_row);
+}
+
+/// Построение, make_unary/make_ones и уничтожение матриц на узлах std::map
+template <template <class...> class M>
+void bench_pool_backend(const std::string& backend, unsigned n, unsigned per_row, unsigned ones_n) {
+    report("build random", backend, measure([&] { random_sparse<M>(n, per_row, 1); }));
+    std::cout << "    " << count_allocations([&] { random_sparse<M>(n, per_row, 1); }) << " allocations" << std::endl;
+    report("make_unary", backend, measure([&] { Matrix<double, M>::make_unary(ones_n, ones_n, 0.5); }));
+    report("make_ones", backend, measure([&] { Matrix<double, M>::make_ones(ones_n, ones_n, 0.5); }));
+    std::cout << "    " << count_allocations([&] { Matrix<double, M>::make_ones(ones_n, ones_n, 0.5); })
+        << " allocations" << std::endl;
+    double best = 0;
+    for (int i = 0; i < 3; ++i) {
+        auto m = std::make_unique<Matrix<double, M>>(random_sparse<M>(n, per_row, 1));
+        double ms = measure([&] { m.reset(); }, 1);
+        if (i == 0 || ms < best) {
+            best = ms;
+        }
+    }
+    report("teardown", backend, best);
+}
+
+void bench_pool() {
+    const unsigned n = 100000;
+    const unsigned per_row = 10;
+    const unsigned ones_n = 1000;
+    std::cout << "== node pool: " << n << "x" << n << ", " << per_row << " per row; ones "
+        << ones_n << "x" << ones_n << " ==" << std::endl;
+    bench_pool_backend<std::map>("map", n, per_row, ones_n);
+    bench_pool_backend<pool_map>("pool", n, per_row, ones_n);
+}
+
+/// Случайные записи и чтения отдельных элементов
+template <template <class...> class M>
+void bench_hash_backend(const std::string& backend, unsigned n, unsigned updates) {
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<unsigned> idx(1, n);
+    std::vector<std::pair<unsigned, unsigned>> cells(updates);
+    for (auto& cell : cells) {
+        cell = {idx(gen), idx(gen)};
+    }
+    Matrix<double, M> m(n, n, 1e-12);
+    report("random write", backend, measure([&] {
+        for (std::size_t k = 0; k < cells.size(); ++k) {
+            m[cells[k]] = double(k % 7 + 1);
+        }
+    }));
+    double sum = 0;
+    report("random read", backend, measure([&] {
+        for (const auto& [i, j] : cells) {
+            sum += m(j, i);
+        }
+    }));
+    report("random add", backend, measure([&] {
+        for (const auto& cell : cells) {
+            m[cell] += 1;
+        }
+    }));
+    if (sum < 0) {
+        std::cout << "";
+    }
+}
+
+void bench_hash() {
+    const unsigned n = 100000;
+    const unsigned updates = 1000000;
+    std::cout << "== random access: " << n << "x" << n << ", " << updates << " cells ==" << std::endl;
+    bench_hash_backend<std::map>("map", n, updates);
+    bench_hash_backend<std::unordered_map>("unordered", n, updates);
+    bench_hash_backend<flat_hash_map>("hash", n, updates);
+}
+
+/// Пятиточечный оператор Лапласа на сетке side x side
+template <template <class...> class M>
+Matrix<double, M> poisson_2d(unsigned side) {
+    unsigned n = side * side;
+    std::vector<std::tuple<unsigned, unsigned, double>> coo;
+    coo.reserve(5 * std::size_t(n));
+    for (unsigned y = 0; y < side; ++y) {
+        for (unsigned x = 0; x < side; ++x) {
+            unsigned i = y * side + x + 1;
+            if (y > 0) coo.emplace_back(i, i - side, -1);
+            if (x > 0) coo.emplace_back(i, i - 1, -1);
+            coo.emplace_back(i, i, 4);
+            if (x + 1 < side) coo.emplace_back(i, i + 1, -1);
+            if (y + 1 < side) coo.emplace_back(i, i + side, -1);
+        }
+    }
+    return Matrix<double, M>::from_triplets(coo, n, n, 1e-300);
+}
+
+void bench_solver() {
+    const unsigned side = 1000;
+    const unsigned n = side * side;
+    std::cout << "== spmv / solvers: 2D Poisson, " << n << " unknowns ==" << std::endl;
+    auto a = poisson_2d<csr_map>(side);
+    std::vector<double> x(n, 1), y;
+    {
+        auto small = poisson_2d<std::map>(300);
+        std::vector<double> sx(300 * 300, 1), sy;
+        Matrix<double, std::map> column(300 * 300, 1, 1e-300);
+        for (unsigned i = 1; i <= 300 * 300; ++i) {
+            column[std::make_pair(i, 1u)] = 1;
+        }
+        report("A * column matrix 300^2", "map", measure([&] { auto c = small * column; }));
+        report("spmv 300^2", "map", measure([&] { spmv(small, sx, sy); }));
+    }
+    report("spmv", "csr", measure([&] { spmv(a, x, y); }));
+    report("spmv parallel", "csr", measure([&] { spmv(a, x, y, Matrix_execution::parallel()); }));
+    // решатели - на меньшей сетке, чтобы замер занимал секунды
+    a = poisson_2d<csr_map>(side / 2);
+    std::vector<double> b(n / 4, 1);
+    std::cout << "solvers on " << b.size() << " unknowns, tolerance 1e-6" << std::endl;
+    solver_options options;
+    options.tolerance = 1e-6;
+    options.max_iterations = 5000;
+    solver_result res;
+    report("cg", "csr", measure([&] { res = conjugate_gradient(a, b, Identity_preconditioner(), options); }, 1));
+    std::cout << "    " << res.iterations << " iterations, residual " << std::scientific << res.residual
+        << std::fixed << std::endl;
+    Jacobi_preconditioner jacobi(a);
+    report("cg + jacobi", "csr", measure([&] { res = conjugate_gradient(a, b, jacobi, options); }, 1));
+    std::cout << "    " << res.iterations << " iterations, residual " << std::scientific << res.residual
+        << std::fixed << std::endl;
+    report("bicgstab + jacobi", "csr", measure([&] { res = bicgstab(a, b, jacobi, options); }, 1));
+    std::cout << "    " << res.iterations << " iterations, residual " << std::scientific << res.residual
+        << std::fixed << std::endl;
+}
+
+void bench_exact_case(const std::string& name, const std::vector<Bareiss_elimination<long long>::row_type>& rows) {
+    unsigned n = rows.size();
+    for (bool markowitz : {false, true}) {
+        std::string order = markowitz ? "markowitz" : "natural";
+        try {
+            std::size_t peak = 0;
+            long long det = 0;
+            report(name, order, measure([&] {
+                Bareiss_elimination<long long> elim(rows, n, n, markowitz);
+                peak = elim.peak_nnz();
+                det = elim.sign() * elim.last_pivot();
+            }, 1));
+            std::cout << "    det " << det << ", peak nnz " << peak << std::endl;
+        } catch (exact_overflow_error&) {
+            std::cout << "    " << order << ": overflow of long long" << std::endl;
+        }
+    }
+}
+
+void bench_exact() {
+    const unsigned n = 1000;
+    std::cout << "== exact Bareiss elimination, " << n << " x " << n << " ==" << std::endl;
+    std::vector<Bareiss_elimination<long long>::row_type> rows(n);
+    for (unsigned i = 0; i < n; ++i) {
+        if (i > 0) {
+            rows[i].emplace_back(i - 1, -1);
+        }
+        rows[i].emplace_back(i, 2);
+        if (i + 1 < n) {
+            rows[i].emplace_back(i + 1, -1);
+        }
+    }
+    bench_exact_case("laplace 1D", rows);
+    // стрела: плотные первая строка и первый столбец, det = 1
+    for (unsigned i = 0; i < n; ++i) {
+        rows[i].clear();
+        if (i == 0) {
+            for (unsigned j = 0; j < n; ++j) {
+                rows[0].emplace_back(j, j == 0 ? n : 1);
+            }
+        } else {
+            rows[i] = {{0, 1}, {i, 1}};
+        }
+    }
+    bench_exact_case("arrow", rows);
+    Matrix<int> a(n, n, 0.5);
+    for (unsigned i = 1; i <= n; ++i) {
+        a[std::make_pair(i, i)] = 2;
+        if (i < n) {
+            a[std::make_pair(i, i + 1)] = -1;
+            a[std::make_pair(i + 1, i)] = -1;
+        }
+    }
+    std::vector<int> b(n, 0);
+    b[0] = 1;
+    std::vector<RationalNumber<long long>> x;
+    report("solve laplace 1D", "map", measure([&] { x = exact_solve(a, b); }, 1));
+    std::cout << "    x_1 = " << x[0].get_numerator() << "/" << x[0].get_denominator() << std::endl;
+}
+
+void bench_bigint() {
+    std::cout << "== bigint ==" << std::endl;
+    std::mt19937_64 gen(42);
+    for (std::size_t n : {std::size_t(64), std::size_t(512), std::size_t(4096)}) {
+        std::vector<BigInt::limb> a(n);
+        std::vector<BigInt::limb> b(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            a[i] = gen();
+            b[i] = gen();
+        }
+        std::vector<BigInt::limb> r(2 * n);
+        std::string name = "mul " + std::to_string(n) + " limbs";
+        report(name, "school", measure([&] {
+            std::fill(r.begin(), r.end(), 0);
+            BigInt::multiply_school(r.data(), a.data(), n, b.data(), n);
+        }));
+        report(name, "karatsuba", measure([&] {
+            std::fill(r.begin(), r.end(), 0);
+            BigInt::multiply(r.data(), a.data(), n, b.data(), n);
+        }));
+    }
+    RationalNumber<BigInt> harmonic;
+    report("harmonic sum 1..2000", "bigint", measure([&] {
+        harmonic = RationalNumber<BigInt>();
+        for (int k = 1; k <= 2000; ++k) {
+            harmonic += RationalNumber<BigInt>(1, k);
+        }
+    }, 1));
+    std::cout << "    denominator has " << to_string(harmonic.get_denominator()).size() << " digits" << std::endl;
+    // 2D Пуассон 20 x 20: определитель не помещается ни в один встроенный тип
+    const unsigned side = 20;
+    const unsigned n = side * side;
+    std::vector<Bareiss_elimination<BigInt>::row_type> rows(n);
+    for (unsigned i = 0; i < side; ++i) {
+        for (unsigned j = 0; j < side; ++j) {
+            unsigned k = i * side + j;
+            if (i > 0) {
+                rows[k].emplace_back(k - side, -1);
+            }
+            if (j > 0) {
+                rows[k].emplace_back(k - 1, -1);
+            }
+            rows[k].emplace_back(k, 4);
+            if (j + 1 < side) {
+                rows[k].emplace_back(k + 1, -1);
+            }
+            if (i + 1 < side) {
+                rows[k].emplace_back(k + side, -1);
+            }
+        }
+    }
+    BigInt det;
+    report("det poisson 20^2", "bigint", measure([&] {
+        Bareiss_elimination<BigInt> elim(rows, n, n);
+        det = elim.last_pivot() * elim.sign();
+    }, 1));
+    std::cout << "    det has " << to_string(det).size() << " digits" << std::endl;
+}
+
+template <class R>
+R bench_rational_sum(const std::vector<std::pair<int, int>>& values) {
+    R sum;
+    for (const auto& [num, den] : values) {
+        sum += R(num, den);
+    }
+    return sum;
+}
+
+void bench_adaptive() {
+    const std::size_t n = 1000000;
+    std::cout << "== adaptive rational: sum of " << n << " fractions with denominators <= 12 ==" << std::endl;
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> num_dist(-1000, 1000);
+    std::uniform_int_distribution<int> den_dist(1, 12);
+    std::vector<std::pair<int, int>> values(n);
+    for (auto& [num, den] : values) {
+        num = num_dist(gen);
+        den = den_dist(gen);
+    }
+    std::string expected = std::string(bench_rational_sum<RationalNumber<long long>>(values));
+    report("sum", "long long", measure([&] { bench_rational_sum<RationalNumber<long long>>(values); }));
+    report("sum", "adaptive", measure([&] {
+        if (std::string(bench_rational_sum<AdaptiveRational>(values)) != expected) {
+            std::cerr << "adaptive sum differs" << std::endl;
+        }
+    }));
+    report("sum", "bigint", measure([&] { bench_rational_sum<RationalNumber<BigInt>>(values); }));
+    // сумма 1/k: long long переполняется на k = 47
+    const int harmonic_n = 2000;
+    report("harmonic sum 1..2000", "adaptive", measure([&] {
+        AdaptiveRational sum;
+        for (int k = 1; k <= harmonic_n; ++k) {
+            sum += AdaptiveRational(1, k);
+        }
+    }, 1));
+}
+
+/// Операции RationalNumber<T> над парами случайных несократимых дробей
+template <class T>
+void bench_rational_type(const std::string& type) {
+    const std::size_t n = 1 << 16;
+    const int rounds = 16;
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<int> num_dist(-30000, 30000);
+    std::uniform_int_distribution<int> den_dist(1, 30000);
+    std::vector<RationalNumber<T>> a;
+    std::vector<RationalNumber<T>> b;
+    // числители без нуля, чтобы деление было определено
+    auto random = [&] { return make_canonical(RationalNumber<T>(num_dist(gen) | 1, den_dist(gen))); };
+    for (std::size_t i = 0; i < n; ++i) {
+        a.push_back(random());
+        b.push_back(random());
+    }
+    long long sink = 0;
+    auto run = [&](const std::string& name, auto op) {
+        double ms = measure([&] {
+            for (int r = 0; r < rounds; ++r) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    sink += op(a[i], b[i]);
+                }
+            }
+        });
+        report(name + " x" + std::to_string(n * rounds), type, ms);
+    };
+    run("add", [](const auto& x, const auto& y) { return (x + y).get_denominator() != 0; });
+    run("sub", [](const auto& x, const auto& y) { return (x - y).get_denominator() != 0; });
+    run("mul", [](const auto& x, const auto& y) { return (x * y).get_denominator() != 0; });
+    run("div", [](const auto& x, const auto& y) { return (x / y).get_denominator() != 0; });
+    run("equal", [](const auto& x, const auto& y) { return x == y; });
+    run("less", [](const auto& x, const auto& y) { return x < y; });
+    run("gcd", [](const auto& x, const auto& y) {
+        return get_max_delim(x.get_numerator() * y.get_denominator(), x.get_denominator() * y.get_numerator()) != 0;
+    });
+    if (sink == 0) {
+        std::cout << "empty sink" << std::endl;
+    }
+}
+
+void bench_rational() {
+    std::cout << "== RationalNumber operations ==" << std::endl;
+    bench_rational_type<int>("int");
+    bench_rational_type<long long>("long long");
+    bench_rational_type<BigInt>("bigint");
+}
+
+/// Срезы-представления: небольшой блок большой разреженной матрицы
+template <template <class...> class M>
+void bench_view_backend(const std::string& backend, unsigned n, unsigned per_row) {
+    auto a = random_sparse<M>(n, per_row, 1);
+    auto block = random_sparse<M>(100, per_row, 2);
+    const Matrix_coords coords(n / 2, n / 2, n / 2 + 99, n / 2 + 99);
+    report("proxy to matrix", backend, measure([&] {
+        auto pr = a[coords];
+        Matrix<double, M> m(*pr, 1e-12);
+        delete pr;
+    }, 10));
+    report("view to matrix", backend, measure([&] { a.view(coords).to_matrix(); }, 10));
+    std::cout << "    allocations per view: " << count_allocations([&] { a.view(coords).get_rows_num(); })
+        << ", per proxy: " << count_allocations([&] { delete a[coords]; }) << std::endl;
+    report("view +=, -=", backend, measure([&] {
+        auto v = a.view(coords);
+        v += block;
+        v -= block;
+    }, 10));
+}
+
+void bench_view() {
+    const unsigned n = 200000;
+    std::cout << "== 100 x 100 slice of " << n << " x " << n << ", 5 per row ==" << std::endl;
+    bench_view_backend<std::map>("map", n, 5);
+    bench_view_backend<csr_map>("csr", n, 5);
+    bench_view_backend<flat_hash_map>("hash", n, 5);
+}
+
+/// Транспонирование разреженной матрицы: поэлементная вставка, operator~ и на месте
+template <template <class...> class M>
+void bench_transpose_backend(const std::string& backend, unsigned n, unsigned per_row, bool naive) {
+    auto a = random_sparse<M>(n, per_row, 1);
+    if (naive) {
+        report("insert per element", backend, measure([&] {
+            Matrix<double, M> res(n, n, 1e-12);
+            for (const auto& [i, j, v] : a.nonzeros()) {
+                res[std::make_pair(j, i)] = v;
+            }
+        }, 1));
+    }
+    report("operator~", backend, measure([&] { auto t = ~a; }, 1));
+    report("transpose_in_place", backend, measure([&] { a.transpose_in_place(); }, 1));
+}
+
+void bench_transpose() {
+    const unsigned n = 1000000;
+    std::cout << "== transpose, " << n << " x " << n << ", 10 per row (10^7 nnz) ==" << std::endl;
+    bench_transpose_backend<std::map>("map", n, 10, true);
+    bench_transpose_backend<csr_map>("csr", n, 10, false);
+    bench_transpose_backend<flat_hash_map>("hash", n, 10, false);
+    const unsigned d = 3163;
+    std::cout << "== dense transpose, " << d << " x " << d << " (10^7 cells) ==" << std::endl;
+    dense_map<unsigned, dense_map<unsigned, double>> src, dst;
+    src.resize(d, d);
+    dst.resize(d, d);
+    for (std::size_t k = 0; k < std::size_t(d) * src.stride(); ++k) {
+        src.data()[k] = double(k % 1000);
+    }
+    report("row by row", "dense", measure([&] {
+        for (unsigned i = 0; i < d; ++i) {
+            for (unsigned j = 0; j < d; ++j) {
+                dst.data()[j * dst.stride() + i] = src.data()[i * src.stride() + j];
+            }
+        }
+    }));
+    report("cache-oblivious", "dense", measure([&] { storage_transpose(src, dst); }));
+    report("in place", "dense", measure([&] { dense_transpose_in_place(src); }));
+}
+
+/// Цепочка A1 * ... * Ak * v: слева направо и в порядке Matrix_chain
+template <template <class...> class M>
+void bench_chain_backend(const std::string& backend, unsigned n, unsigned per_row, unsigned length) {
+    std::vector<Matrix<double, M>> factors;
+    for (unsigned k = 0; k < length; ++k) {
+        factors.push_back(random_sparse<M>(n, per_row, k + 1));
+    }
+    Matrix<double, M> v(n, 1, 1e-12);
+    for (unsigned i = 1; i <= n; i += 3) {
+        v[std::make_pair(i, 1)] = 1;
+    }
+    report("left to right", backend, measure([&] {
+        auto res = factors[0];
+        for (unsigned k = 1; k < length; ++k) {
+            res *= factors[k];
+        }
+        res *= v;
+    }, 1));
+    Matrix_chain<double, M> chain;
+    for (const auto& f : factors) {
+        chain.add(f);
+    }
+    chain.add(v);
+    report("Matrix_chain", backend, measure([&] { chain.evaluate(); }, 1));
+    std::cout << "    order " << chain.order() << std::endl;
+}
+
+void bench_chain() {
+    const unsigned n = 20000;
+    std::cout << "== chain of 4 sparse " << n << " x " << n << " (5 per row) and a vector ==" << std::endl;
+    bench_chain_backend<std::map>("map", n, 5, 4);
+    bench_chain_backend<csr_map>("csr", n, 5, 4);
+    const unsigned d = 200;
+    const unsigned k = 64;
+    std::cout << "== power " << k << " of dense " << d << " x " << d << " ==" << std::endl;
+    Matrix<double, dense_map> a(d, d, 1e-12);
+    for (unsigned i = 1; i <= d; ++i) {
+        for (unsigned j = 1; j <= d; ++j) {
+            a[std::make_pair(i, j)] = double((i * 7 + j * 3) % 11) / (11.0 * d);
+        }
+    }
+    report("repeated multiply", "dense", measure([&] {
+        auto res = a;
+        for (unsigned p = 1; p < k; ++p) {
+            res *= a;
+        }
+    }, 1));
+    report("pow", "dense", measure([&] { pow(a, k); }, 1));
+}
+
+int main(int argc, char** argv) {
+    std::map<std::string, std::function<void()>> benches = {
+        {"csr", bench_csr},
+        {"spgemm", bench_spgemm},
+        {"fill", bench_fill},
+        {"parallel", bench_parallel},
+        {"dense", bench_dense},
+        {"hybrid", bench_hybrid},
+        {"load", bench_load},
+        {"binary", bench_binary},
+        {"write", bench_write},
+        {"expr", bench_expr},
+        {"pool", bench_pool},
+        {"hash", bench_hash},
+        {"solver", bench_solver},
+        {"exact", bench_exact},
+        {"bigint", bench_bigint},
+        {"adaptive", bench_adaptive},
+        {"rational", bench_rational},
+        {"view", bench_view},
+        {"transpose", bench_transpose},
+        {"chain", bench_chain},
+    };
+    if (argc < 2) {
+        for (const auto& [name, f] : benches) {
+            f();
+        }
+        return 0;
+    }
+    for (int i = 1; i < argc; ++i) {
+        auto it = benches.find(argv[i]);
+        if (it == benches.end()) {
+            std::cerr << "unknown benchmark: " << argv[i] << std::endl;
+            return 1;
+        }
+        it->second();
+    }
+    return 0;
+}
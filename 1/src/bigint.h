@@ -0,0 +1,833 @@
+#pragma once
+
+#include "rational.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+    \brief Целое число произвольной длины
+
+    Хранится как знак и модуль в системе счисления 2^64 (младшие разряды
+    первыми). Модули до 128 бит лежат во внутреннем буфере объекта, так
+    что операции над числами, помещающимися в машинное слово, не выделяют
+    память. Умножение длинных чисел - по Карацубе, НОД - бинарный с шагом
+    деления при разной длине операндов.
+
+    Деление и остаток - как у встроенных типов: частное округляется к
+    нулю, знак остатка совпадает со знаком делимого.
+*/
+class BigInt {
+public:
+    using limb = std::uint64_t;
+
+    /// Количество разрядов во внутреннем буфере
+    static constexpr std::size_t inline_limbs = 2;
+
+    /// Длина операндов, начиная с которой применяется умножение Карацубы
+    static constexpr std::size_t karatsuba_threshold = 32;
+
+    BigInt() noexcept {}
+
+    /// Конструктор из встроенного целого
+    template <class I, std::enable_if_t<std::is_integral_v<I>, int> = 0>
+    BigInt(I value) {
+        using wide = unsigned __int128;
+        wide mag = wide(value);
+        if constexpr (std::is_signed_v<I>) {
+            if (value < 0) {
+                negative_ = true;
+                mag = wide(0) - mag;
+            }
+        }
+        inline_[0] = limb(mag);
+        inline_[1] = limb(mag >> 64);
+        size_ = inline_[1] ? 2 : inline_[0] ? 1 : 0;
+    }
+
+    /// Конструктор из вещественного числа (дробная часть отбрасывается)
+    explicit BigInt(double value) {
+        bool negative = value < 0;
+        value = std::trunc(std::fabs(value));
+        int exp;
+        double mant = std::frexp(value, &exp);
+        if (exp <= 64) {
+            *this = BigInt(limb(value));
+        } else {
+            *this = BigInt(limb(std::ldexp(mant, 64)));
+            shift_left(exp - 64);
+        }
+        negative_ = negative && size_ != 0;
+    }
+
+    /// Конструктор из десятичной строки
+    explicit BigInt(const std::string& str) {
+        std::size_t pos = !str.empty() && str[0] == '-' ? 1 : 0;
+        if (pos == str.size()) {
+            throw invalid_string_error("invalid string", str);
+        }
+        for (; pos < str.size(); pos += 19) {
+            std::size_t len = std::min<std::size_t>(19, str.size() - pos);
+            limb chunk = 0;
+            limb scale = 1;
+            for (std::size_t i = pos; i < pos + len; ++i) {
+                if (str[i] < '0' || str[i] > '9') {
+                    throw invalid_string_error("invalid string", str);
+                }
+                chunk = chunk * 10 + (str[i] - '0');
+                scale *= 10;
+            }
+            mul_add_small(scale, chunk);
+        }
+        negative_ = str[0] == '-' && size_ != 0;
+    }
+
+    BigInt(const BigInt& other) {
+        assign(other);
+    }
+
+    BigInt(BigInt&& other) noexcept {
+        steal(other);
+    }
+
+    BigInt& operator= (const BigInt& other) {
+        if (this != &other) {
+            assign(other);
+        }
+        return *this;
+    }
+
+    BigInt& operator= (BigInt&& other) noexcept {
+        if (this != &other) {
+            release();
+            steal(other);
+        }
+        return *this;
+    }
+
+    ~BigInt() {
+        release();
+    }
+
+    /// Количество разрядов модуля
+    std::size_t limbs() const { return size_; }
+
+    /// Хэш значения (по знаку и разрядам модуля)
+    std::size_t hash() const {
+        std::size_t res = negative_;
+        for (std::uint32_t i = 0; i < size_; ++i) {
+            res = hash_combine(res, std::hash<limb>{}(data()[i]));
+        }
+        return res;
+    }
+
+    /// Хранится ли модуль во внутреннем буфере
+    bool is_inline() const { return capacity_ == inline_limbs; }
+
+    /// Помещается ли значение во встроенный тип I
+    template <class I>
+    bool fits() const {
+        return *this >= BigInt(std::numeric_limits<I>::min()) && *this <= BigInt(std::numeric_limits<I>::max());
+    }
+
+    /// Приведение к встроенному целому (младшие разряды, как при сужении)
+    template <class I, std::enable_if_t<std::is_integral_v<I>, int> = 0>
+    explicit operator I() const {
+        using wide = unsigned __int128;
+        wide mag = size_ == 0 ? 0 : size_ == 1 ? wide(data()[0]) : (wide(data()[1]) << 64) | data()[0];
+        return I(negative_ ? wide(0) - mag : mag);
+    }
+
+    explicit operator double() const {
+        double res = 0;
+        std::size_t low = size_ > 3 ? size_ - 3 : 0;
+        for (std::size_t i = size_; i-- > low;) {
+            res = res * 18446744073709551616.0 + double(data()[i]);
+        }
+        res = std::ldexp(res, int(64 * low));
+        return negative_ ? -res : res;
+    }
+
+    explicit operator bool() const { return size_ != 0; }
+
+    BigInt operator- () const {
+        BigInt res(*this);
+        res.negative_ = !res.negative_ && res.size_ != 0;
+        return res;
+    }
+
+    friend BigInt abs(BigInt value) {
+        value.negative_ = false;
+        return value;
+    }
+
+    BigInt& operator+= (const BigInt& rhs) {
+        add_signed(rhs, rhs.negative_);
+        return *this;
+    }
+
+    BigInt& operator-= (const BigInt& rhs) {
+        add_signed(rhs, !rhs.negative_);
+        return *this;
+    }
+
+    BigInt& operator*= (const BigInt& rhs) {
+        bool negative = negative_ != rhs.negative_;
+        if (size_ <= 1 && rhs.size_ <= 1) {
+            unsigned __int128 prod = (unsigned __int128)low() * rhs.low();
+            set_inline(limb(prod), limb(prod >> 64));
+        } else {
+            BigInt res;
+            res.resize(size_ + rhs.size_);
+            multiply(res.data(), data(), size_, rhs.data(), rhs.size_);
+            res.trim();
+            *this = std::move(res);
+        }
+        negative_ = negative && size_ != 0;
+        return *this;
+    }
+
+    BigInt& operator/= (const BigInt& rhs) {
+        BigInt rem;
+        divmod(*this, rhs, this, &rem);
+        return *this;
+    }
+
+    BigInt& operator%= (const BigInt& rhs) {
+        BigInt quot;
+        divmod(*this, rhs, &quot, this);
+        return *this;
+    }
+
+    BigInt& operator++ () { return *this += BigInt(1); }
+    BigInt& operator-- () { return *this -= BigInt(1); }
+
+    friend BigInt operator+ (BigInt lhs, const BigInt& rhs) { return lhs += rhs; }
+    friend BigInt operator- (BigInt lhs, const BigInt& rhs) { return lhs -= rhs; }
+    friend BigInt operator* (BigInt lhs, const BigInt& rhs) { return lhs *= rhs; }
+    friend BigInt operator/ (BigInt lhs, const BigInt& rhs) { return lhs /= rhs; }
+    friend BigInt operator% (BigInt lhs, const BigInt& rhs) { return lhs %= rhs; }
+
+    friend bool operator== (const BigInt& lhs, const BigInt& rhs) { return compare(lhs, rhs) == 0; }
+    friend bool operator!= (const BigInt& lhs, const BigInt& rhs) { return compare(lhs, rhs) != 0; }
+    friend bool operator< (const BigInt& lhs, const BigInt& rhs) { return compare(lhs, rhs) < 0; }
+    friend bool operator> (const BigInt& lhs, const BigInt& rhs) { return compare(lhs, rhs) > 0; }
+    friend bool operator<= (const BigInt& lhs, const BigInt& rhs) { return compare(lhs, rhs) <= 0; }
+    friend bool operator>= (const BigInt& lhs, const BigInt& rhs) { return compare(lhs, rhs) >= 0; }
+
+    /**
+        \brief Деление с остатком
+
+        Любой из указателей quot и rem может быть нулевым или указывать на
+        один из операндов.
+    */
+    friend void divmod(const BigInt& lhs, const BigInt& rhs, BigInt* quot, BigInt* rem) {
+        if (rhs.size_ == 0) {
+            throw zero_division_error("division by zero");
+        }
+        bool quot_negative = lhs.negative_ != rhs.negative_;
+        bool rem_negative = lhs.negative_;
+        BigInt q;
+        BigInt r;
+        if (compare_mag(lhs.data(), lhs.size_, rhs.data(), rhs.size_) < 0) {
+            r = lhs;
+        } else if (rhs.size_ == 1) {
+            q = lhs;
+            r = BigInt(q.div_small(rhs.data()[0]));
+        } else {
+            divide_knuth(lhs, rhs, q, r);
+        }
+        q.negative_ = quot_negative && q.size_ != 0;
+        r.negative_ = rem_negative && r.size_ != 0;
+        if (quot) {
+            *quot = std::move(q);
+        }
+        if (rem) {
+            *rem = std::move(r);
+        }
+    }
+
+    /// НОД (неотрицательный): бинарный алгоритм, при разной длине - шаг Евклида
+    friend BigInt get_max_delim(BigInt a, BigInt b) {
+        a.negative_ = false;
+        b.negative_ = false;
+        while (a.size_ != b.size_ && a.size_ != 0 && b.size_ != 0) {
+            if (a.size_ < b.size_) {
+                std::swap(a, b);
+            }
+            a %= b;
+        }
+        if (a.size_ == 0) {
+            return b;
+        }
+        if (b.size_ == 0) {
+            return a;
+        }
+        std::size_t a_zeros = a.trailing_zeros();
+        std::size_t b_zeros = b.trailing_zeros();
+        std::size_t shift = std::min(a_zeros, b_zeros);
+        a.shift_right(a_zeros);
+        b.shift_right(b_zeros);
+        // оба нечетные, a > b после перестановки
+        while (true) {
+            if (a.size_ <= 1 && b.size_ <= 1) {
+                a.set_inline(binary_gcd(a.low(), b.low()), 0);
+                break;
+            }
+            int cmp = compare_mag(a.data(), a.size_, b.data(), b.size_);
+            if (cmp == 0) {
+                break;
+            }
+            if (cmp < 0) {
+                std::swap(a, b);
+            }
+            if (a.size_ > b.size_ + 1) {
+                a %= b;
+            } else {
+                a.sub_mag(b);
+            }
+            if (a.size_ == 0) {
+                a = std::move(b);
+                break;
+            }
+            a.shift_right(a.trailing_zeros());
+        }
+        a.shift_left(shift);
+        return a;
+    }
+
+    /// Десятичная запись
+    friend std::string to_string(const BigInt& value) {
+        if (value.size_ == 0) {
+            return "0";
+        }
+        const limb base = 10000000000000000000ull;
+        BigInt mag = abs(value);
+        std::vector<limb> chunks;
+        while (mag.size_ != 0) {
+            chunks.push_back(mag.div_small(base));
+        }
+        std::string res = value.negative_ ? "-" : "";
+        res += std::to_string(chunks.back());
+        for (std::size_t i = chunks.size() - 1; i-- > 0;) {
+            std::string chunk = std::to_string(chunks[i]);
+            res += std::string(19 - chunk.size(), '0') + chunk;
+        }
+        return res;
+    }
+
+    friend std::ostream& operator<< (std::ostream& os, const BigInt& value) {
+        return os << to_string(value);
+    }
+
+    /// Произведение модулей в r (na + nb разрядов, обнуленных, без пересечения с операндами)
+    static void multiply(limb* r, const limb* a, std::size_t na, const limb* b, std::size_t nb) {
+        if (na < nb) {
+            std::swap(a, b);
+            std::swap(na, nb);
+        }
+        if (nb < karatsuba_threshold) {
+            multiply_school(r, a, na, b, nb);
+            return;
+        }
+        std::size_t m = na / 2;
+        if (nb <= m) {
+            // несбалансированные длины: a делится на куски длины nb
+            std::vector<limb> part(2 * nb);
+            for (std::size_t i = 0; i < na; i += nb) {
+                std::size_t len = std::min(nb, na - i);
+                std::fill(part.begin(), part.end(), 0);
+                multiply(part.data(), a + i, len, b, nb);
+                add_to(r + i, r + i, na + nb - i, part.data(), len + nb);
+            }
+            return;
+        }
+        // a = a1 * B^m + a0, b = b1 * B^m + b0;
+        // a * b = z2 * B^2m + (z1 - z2 - z0) * B^m + z0, z1 = (a0 + a1)(b0 + b1)
+        std::size_t na1 = na - m;
+        std::size_t nb1 = nb - m;
+        multiply(r, a, m, b, m);
+        multiply(r + 2 * m, a + m, na1, b + m, nb1);
+        std::vector<limb> sa(na1 + 1);
+        std::vector<limb> sb(std::max(m, nb1) + 1);
+        sa[na1] = add_to(sa.data(), a + m, na1, a, m);
+        if (nb1 >= m) {
+            sb[nb1] = add_to(sb.data(), b + m, nb1, b, m);
+        } else {
+            sb[m] = add_to(sb.data(), b, m, b + m, nb1);
+        }
+        std::vector<limb> z1(sa.size() + sb.size());
+        multiply(z1.data(), sa.data(), sa.size(), sb.data(), sb.size());
+        sub_from(z1.data(), z1.data(), z1.size(), r, 2 * m);
+        sub_from(z1.data(), z1.data(), z1.size(), r + 2 * m, na1 + nb1);
+        add_to(r + m, r + m, na + nb - m, z1.data(), std::min(z1.size(), na + nb - m));
+    }
+
+    /// Умножение модулей столбиком (r обнулен, na + nb разрядов)
+    static void multiply_school(limb* r, const limb* a, std::size_t na, const limb* b, std::size_t nb) {
+        for (std::size_t i = 0; i < na; ++i) {
+            limb carry = 0;
+            for (std::size_t j = 0; j < nb; ++j) {
+                unsigned __int128 cur = (unsigned __int128)a[i] * b[j] + r[i + j] + carry;
+                r[i + j] = limb(cur);
+                carry = limb(cur >> 64);
+            }
+            r[i + nb] = carry;
+        }
+    }
+
+private:
+    const limb* data() const { return capacity_ > inline_limbs ? heap_ : inline_; }
+    limb* data() { return capacity_ > inline_limbs ? heap_ : inline_; }
+    limb low() const { return size_ == 0 ? 0 : data()[0]; }
+
+    void set_inline(limb lo, limb hi) {
+        release();
+        inline_[0] = lo;
+        inline_[1] = hi;
+        size_ = hi ? 2 : lo ? 1 : 0;
+    }
+
+    void release() {
+        if (capacity_ > inline_limbs) {
+            delete[] heap_;
+            capacity_ = inline_limbs;
+        }
+    }
+
+    void steal(BigInt& other) {
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        negative_ = other.negative_;
+        if (other.capacity_ > inline_limbs) {
+            heap_ = other.heap_;
+            other.capacity_ = inline_limbs;
+        } else {
+            inline_[0] = other.inline_[0];
+            inline_[1] = other.inline_[1];
+        }
+        other.size_ = 0;
+        other.negative_ = false;
+    }
+
+    void assign(const BigInt& other) {
+        size_ = 0;
+        reserve(other.size_);
+        std::copy(other.data(), other.data() + other.size_, data());
+        size_ = other.size_;
+        negative_ = other.negative_;
+    }
+
+    void reserve(std::size_t capacity) {
+        if (capacity <= capacity_) {
+            return;
+        }
+        capacity = std::max<std::size_t>(capacity, 2 * capacity_);
+        limb* buffer = new limb[capacity];
+        std::copy(data(), data() + size_, buffer);
+        release();
+        heap_ = buffer;
+        capacity_ = capacity;
+    }
+
+    /// Изменение количества разрядов (новые - нулевые)
+    void resize(std::size_t size) {
+        reserve(size);
+        if (size > size_) {
+            std::fill(data() + size_, data() + size, 0);
+        }
+        size_ = size;
+    }
+
+    void trim() {
+        while (size_ != 0 && data()[size_ - 1] == 0) {
+            --size_;
+        }
+        if (size_ == 0) {
+            negative_ = false;
+        }
+    }
+
+    static int compare_mag(const limb* a, std::size_t na, const limb* b, std::size_t nb) {
+        if (na != nb) {
+            return na < nb ? -1 : 1;
+        }
+        for (std::size_t i = na; i-- > 0;) {
+            if (a[i] != b[i]) {
+                return a[i] < b[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    static int compare(const BigInt& lhs, const BigInt& rhs) {
+        if (lhs.negative_ != rhs.negative_) {
+            return lhs.negative_ ? -1 : 1;
+        }
+        int cmp = compare_mag(lhs.data(), lhs.size_, rhs.data(), rhs.size_);
+        return lhs.negative_ ? -cmp : cmp;
+    }
+
+    /// r = a + b (na >= nb, r на na разрядов может совпадать с a или b), возвращает перенос
+    static limb add_to(limb* r, const limb* a, std::size_t na, const limb* b, std::size_t nb) {
+        limb carry = 0;
+        std::size_t i = 0;
+        for (; i < nb; ++i) {
+            unsigned __int128 cur = (unsigned __int128)a[i] + b[i] + carry;
+            r[i] = limb(cur);
+            carry = limb(cur >> 64);
+        }
+        for (; i < na; ++i) {
+            r[i] = a[i] + carry;
+            carry = carry && r[i] == 0;
+        }
+        return carry;
+    }
+
+    /// r = a - b (na >= nb, r на na разрядов может совпадать с a или b), возвращает заем
+    static limb sub_from(limb* r, const limb* a, std::size_t na, const limb* b, std::size_t nb) {
+        limb borrow = 0;
+        std::size_t i = 0;
+        for (; i < nb; ++i) {
+            limb ai = a[i];
+            limb bi = b[i];
+            r[i] = ai - bi - borrow;
+            borrow = ai < bi || (ai == bi && borrow);
+        }
+        for (; i < na; ++i) {
+            limb ai = a[i];
+            r[i] = ai - borrow;
+            borrow = borrow && ai == 0;
+        }
+        return borrow;
+    }
+
+    void add_signed(const BigInt& rhs, bool rhs_negative) {
+        if (&rhs == this) {
+            BigInt copy(rhs);
+            add_signed(copy, rhs_negative);
+            return;
+        }
+        if (negative_ == rhs_negative) {
+            std::size_t n = std::max(size_, rhs.size_);
+            resize(n + 1);
+            data()[n] = add_to(data(), data(), n, rhs.data(), rhs.size_);
+            trim();
+            negative_ = rhs_negative && size_ != 0;
+        } else if (compare_mag(data(), size_, rhs.data(), rhs.size_) >= 0) {
+            sub_mag(rhs);
+        } else {
+            std::size_t old_size = size_;
+            resize(rhs.size_);
+            sub_from(data(), rhs.data(), rhs.size_, data(), old_size);
+            trim();
+            negative_ = rhs_negative && size_ != 0;
+        }
+    }
+
+    /// |this| -= |rhs| при |this| >= |rhs|, знак сохраняется
+    void sub_mag(const BigInt& rhs) {
+        sub_from(data(), data(), size_, rhs.data(), rhs.size_);
+        trim();
+    }
+
+    /// this = this * mul + add (модуль)
+    void mul_add_small(limb mul, limb add) {
+        limb carry = add;
+        for (std::size_t i = 0; i < size_; ++i) {
+            unsigned __int128 cur = (unsigned __int128)data()[i] * mul + carry;
+            data()[i] = limb(cur);
+            carry = limb(cur >> 64);
+        }
+        if (carry) {
+            resize(size_ + 1);
+            data()[size_ - 1] = carry;
+        }
+    }
+
+    /// Деление модуля на разряд, возвращает остаток
+    limb div_small(limb divisor) {
+        unsigned __int128 rem = 0;
+        for (std::size_t i = size_; i-- > 0;) {
+            unsigned __int128 cur = (rem << 64) | data()[i];
+            data()[i] = limb(cur / divisor);
+            rem = cur % divisor;
+        }
+        trim();
+        return limb(rem);
+    }
+
+    std::size_t trailing_zeros() const {
+        std::size_t i = 0;
+        while (data()[i] == 0) {
+            ++i;
+        }
+        return 64 * i + __builtin_ctzll(data()[i]);
+    }
+
+    void shift_left(std::size_t bits) {
+        if (size_ == 0 || bits == 0) {
+            return;
+        }
+        std::size_t limbs = bits / 64;
+        unsigned rest = bits % 64;
+        std::size_t old_size = size_;
+        resize(size_ + limbs + 1);
+        limb* d = data();
+        for (std::size_t i = old_size + 1; i-- > 0;) {
+            limb hi = i < old_size ? d[i] << rest : 0;
+            limb lo = rest != 0 && i > 0 ? d[i - 1] >> (64 - rest) : 0;
+            d[i + limbs] = hi | lo;
+        }
+        std::fill(d, d + limbs, 0);
+        trim();
+    }
+
+    void shift_right(std::size_t bits) {
+        std::size_t limbs = bits / 64;
+        unsigned rest = bits % 64;
+        if (limbs >= size_) {
+            size_ = 0;
+            trim();
+            return;
+        }
+        limb* d = data();
+        for (std::size_t i = 0; i + limbs < size_; ++i) {
+            limb lo = d[i + limbs] >> rest;
+            limb hi = rest != 0 && i + limbs + 1 < size_ ? d[i + limbs + 1] << (64 - rest) : 0;
+            d[i] = lo | hi;
+        }
+        size_ -= limbs;
+        trim();
+    }
+
+    static limb binary_gcd(limb u, limb v) {
+        if (u == 0 || v == 0) {
+            return u | v;
+        }
+        int shift = __builtin_ctzll(u | v);
+        u >>= __builtin_ctzll(u);
+        do {
+            v >>= __builtin_ctzll(v);
+            if (u > v) {
+                std::swap(u, v);
+            }
+            v -= u;
+        } while (v != 0);
+        return u << shift;
+    }
+
+    /// Деление модулей (алгоритм D Кнута), |lhs| >= |rhs|, rhs - не менее двух разрядов
+    static void divide_knuth(const BigInt& lhs, const BigInt& rhs, BigInt& quot, BigInt& rem) {
+        using wide = unsigned __int128;
+        const wide base = wide(1) << 64;
+        unsigned shift = __builtin_clzll(rhs.data()[rhs.size_ - 1]);
+        BigInt u = abs(lhs);
+        BigInt v = abs(rhs);
+        u.shift_left(shift);
+        v.shift_left(shift);
+        std::size_t n = v.size_;
+        std::size_t m = lhs.size_ - rhs.size_;
+        u.resize(lhs.size_ + 1);
+        limb* un = u.data();
+        const limb* vn = v.data();
+        quot = BigInt();
+        quot.resize(m + 1);
+        for (std::size_t j = m + 1; j-- > 0;) {
+            wide num = (wide(un[j + n]) << 64) | un[j + n - 1];
+            wide qhat = num / vn[n - 1];
+            wide rhat = num % vn[n - 1];
+            if (qhat >= base) {
+                qhat = base - 1;
+                rhat = num - qhat * vn[n - 1];
+            }
+            while (rhat < base && qhat * vn[n - 2] > ((rhat << 64) | un[j + n - 2])) {
+                --qhat;
+                rhat += vn[n - 1];
+            }
+            limb borrow = 0;
+            limb carry = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                wide prod = qhat * vn[i] + carry;
+                carry = limb(prod >> 64);
+                limb sub = limb(prod);
+                limb cur = un[i + j];
+                un[i + j] = cur - sub - borrow;
+                borrow = cur < sub || (cur == sub && borrow);
+            }
+            limb cur = un[j + n];
+            un[j + n] = cur - carry - borrow;
+            borrow = cur < carry || (cur == carry && borrow);
+            if (borrow) {
+                --qhat;
+                un[j + n] += add_to(un + j, un + j, n, vn, n);
+            }
+            quot.data()[j] = limb(qhat);
+        }
+        quot.trim();
+        u.size_ = n;
+        u.trim();
+        u.shift_right(shift);
+        rem = std::move(u);
+    }
+
+    union {
+        limb inline_[inline_limbs] = {0, 0};
+        limb* heap_;
+    };
+    std::uint32_t size_ = 0;
+    std::uint32_t capacity_ = inline_limbs;
+    bool negative_ = false;
+};
+
+namespace std {
+
+template <>
+struct hash<BigInt> {
+    std::size_t operator() (const BigInt& num) const {
+        return num.hash();
+    }
+};
+
+template <>
+class numeric_limits<BigInt> {
+public:
+    static constexpr bool is_specialized = true;
+    static constexpr bool is_signed = true;
+    static constexpr bool is_integer = true;
+    static constexpr bool is_exact = true;
+    static constexpr bool is_bounded = false;
+    static constexpr bool is_modulo = false;
+    static constexpr int radix = 2;
+    static constexpr int digits = 0;
+    static constexpr int digits10 = 0;
+};
+
+}
+
+/**
+    \brief Класс с тестами для класса BigInt
+
+    Данный класс содержит тесты длинной арифметики и рациональных чисел
+    над ней.
+*/
+class BigIntTest {
+public:
+    void operator() () {
+        BigInt fact = 1;
+        for (int i = 2; i <= 100; ++i) {
+            fact *= i;
+        }
+        if (to_string(fact) != "93326215443944152681699238856266700490715968264381621468592963895217599993229915608941463976156518286253697920827223758251185210916864000000000000000000000000") {
+            throw test_failed_error("factorial test failed");
+        }
+        if (BigInt(to_string(fact)) != fact || BigInt(to_string(-fact)) != -fact) {
+            throw test_failed_error("string round trip test failed");
+        }
+        BigInt quot = fact;
+        for (int i = 100; i >= 2; --i) {
+            if (quot % i != 0) {
+                throw test_failed_error("remainder test failed");
+            }
+            quot /= i;
+        }
+        if (quot != 1) {
+            throw test_failed_error("division test failed");
+        }
+        BigInt small = 123456789;
+        small *= 987654321;
+        small -= 121932631112635269ll;
+        if (small != 0 || !small.is_inline() || !BigInt(std::numeric_limits<long long>::min()).is_inline()) {
+            throw test_failed_error("small value test failed");
+        }
+        if (BigInt(-7) / 2 != -3 || BigInt(-7) % 2 != -1 || BigInt(7) / -2 != -3 || BigInt(7) % -2 != 1) {
+            throw test_failed_error("signed division test failed");
+        }
+        if (static_cast<long long>(BigInt(std::numeric_limits<long long>::min()) + 4) != std::numeric_limits<long long>::min() + 4 ||
+            !(BigInt(-1) < BigInt(0)) || !(fact > -fact) || !BigInt(1ll << 62).fits<long long>() ||
+            (BigInt(1ll << 62) * 2).fits<long long>())
+        {
+            throw test_failed_error("conversion test failed");
+        }
+        if (std::abs(double(fact) / 9.33262154439441e157 - 1) > 1e-12 || BigInt(-1e30) != -BigInt("1000000000000000019884624838656")) {
+            throw test_failed_error("double conversion test failed");
+        }
+        // Карацуба против умножения столбиком
+        std::vector<BigInt::limb> a(300);
+        std::vector<BigInt::limb> b(170);
+        BigInt::limb seed = 88172645463325252ull;
+        auto next = [&seed] {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            return seed;
+        };
+        for (auto& x : a) {
+            x = next();
+        }
+        for (auto& x : b) {
+            x = next();
+        }
+        for (std::size_t nb : {std::size_t(40), std::size_t(100), std::size_t(170)}) {
+            std::vector<BigInt::limb> fast(a.size() + nb, 0);
+            std::vector<BigInt::limb> slow(a.size() + nb, 0);
+            BigInt::multiply(fast.data(), a.data(), a.size(), b.data(), nb);
+            BigInt::multiply_school(slow.data(), a.data(), a.size(), b.data(), nb);
+            if (fast != slow) {
+                throw test_failed_error("karatsuba test failed");
+            }
+        }
+        BigInt x = 1;
+        BigInt y = 1;
+        for (int i = 0; i < 40; ++i) {
+            x = x * BigInt(next()) + BigInt(next());
+            if (i < 25) {
+                y = y * BigInt(next()) + BigInt(next());
+            }
+        }
+        BigInt q;
+        BigInt r;
+        divmod(x, y, &q, &r);
+        if (q * y + r != x || r < 0 || r >= y) {
+            throw test_failed_error("long division test failed");
+        }
+        BigInt g = BigInt(3 * 5 * 7) * fact;
+        if (get_max_delim(g * x, fact * y) != fact * get_max_delim(BigInt(105) * x, y) ||
+            get_max_delim(-fact, BigInt(1)) != 1 || get_max_delim(BigInt(0), -fact) != fact)
+        {
+            throw test_failed_error("gcd test failed");
+        }
+        RationalNumber<BigInt> harmonic;
+        for (int k = 1; k <= 100; ++k) {
+            harmonic += RationalNumber<BigInt>(1, k);
+        }
+        if (harmonic != RationalNumber<BigInt>(BigInt("14466636279520351160221518043104131447711"),
+            BigInt("2788815009188499086581352357412492142272")))
+        {
+            throw test_failed_error("harmonic sum test failed");
+        }
+        if (std::string(RationalNumber<BigInt>("12/34")) != "12/34" || RationalNumber<BigInt>(7, 2).floor() != 3 ||
+            !(RationalNumber<BigInt>(1, 3) < RationalNumber<BigInt>(1, 2)))
+        {
+            throw test_failed_error("big rational test failed");
+        }
+        {
+            std::hash<BigInt> big_hash;
+            BigInt big("1267650600228229401496703205376");
+            if (big_hash((big * 3) / 3) != big_hash(big) || big_hash(big) == big_hash(-big) ||
+                big_hash(BigInt(5)) != big_hash(BigInt("5")))
+            {
+                throw test_failed_error("hash test failed");
+            }
+        }
+        std::cout << "bigint tests completed" << std::endl;
+    }
+};
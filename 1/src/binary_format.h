@@ -0,0 +1,210 @@
+#pragma once
+
+#include "rational.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+#include <utility>
+
+/**
+    \brief Двоичный формат матрицы
+
+    Файл состоит из заголовка matrix_binary_header и трех массивов CSR,
+    каждый с выравниванием 8 байт:
+    - row_ptr: rows + 1 чисел uint64, элементы строки i (с 1) занимают
+      позиции [row_ptr[i - 1], row_ptr[i]);
+    - col_idx: nnz чисел uint32, номера столбцов (с 1) по возрастанию внутри строки;
+    - values: nnz значений типа matrix_binary_type<T>::stored_type.
+    Числа хранятся в порядке байт машины; файл другого порядка байт не
+    пройдет проверку версии.
+*/
+struct matrix_binary_header {
+    /// Сигнатура формата
+    char magic[8];
+    /// Версия формата
+    std::uint32_t version;
+    /// Тип элементов (matrix_binary_type<T>::tag)
+    std::uint32_t type_tag;
+    std::uint32_t rows;
+    std::uint32_t cols;
+    std::uint64_t nnz;
+    /// Размер одного значения в байтах
+    std::uint32_t value_size;
+    std::uint32_t reserved;
+};
+
+/// Сигнатура двоичного формата
+inline constexpr char matrix_binary_magic[8] = {'M', 'A', 'T', 'R', 'I', 'X', 'B', '\0'};
+/// Текущая версия двоичного формата
+inline constexpr std::uint32_t matrix_binary_version = 1;
+
+/// Хранимое представление рационального числа
+struct matrix_binary_rational {
+    std::int32_t numerator;
+    std::int32_t denominator;
+};
+
+/// Описание типа элементов в двоичном формате (для неподдерживаемых типов не определено)
+template <class T>
+struct matrix_binary_type;
+
+template <>
+struct matrix_binary_type<int> {
+    static constexpr std::uint32_t tag = 1;
+    using stored_type = std::int32_t;
+    static stored_type store(int value) { return value; }
+    static int load(stored_type value) { return value; }
+};
+
+template <>
+struct matrix_binary_type<double> {
+    static constexpr std::uint32_t tag = 2;
+    using stored_type = double;
+    static stored_type store(double value) { return value; }
+    static double load(stored_type value) { return value; }
+};
+
+template <>
+struct matrix_binary_type<RationalNumber<int>> {
+    static constexpr std::uint32_t tag = 3;
+    using stored_type = matrix_binary_rational;
+    static stored_type store(const RationalNumber<int>& value) {
+        return {value.get_numerator(), value.get_denominator()};
+    }
+    static RationalNumber<int> load(stored_type value) {
+        return RationalNumber<int>(value.numerator, value.denominator);
+    }
+};
+
+/// Округление смещения вверх до кратного 8
+inline constexpr std::uint64_t matrix_binary_align(std::uint64_t offset) {
+    return (offset + 7) / 8 * 8;
+}
+
+/// Смещения массивов в файле
+struct matrix_binary_layout {
+    std::uint64_t row_ptr;
+    std::uint64_t col_idx;
+    std::uint64_t values;
+    std::uint64_t size;
+
+    matrix_binary_layout(std::uint64_t rows, std::uint64_t nnz, std::uint64_t value_size) {
+        row_ptr = matrix_binary_align(sizeof(matrix_binary_header));
+        col_idx = row_ptr + (rows + 1) * sizeof(std::uint64_t);
+        values = matrix_binary_align(col_idx + nnz * sizeof(std::uint32_t));
+        size = values + nnz * value_size;
+    }
+};
+
+/**
+    \brief Проверка содержимого двоичного файла
+
+    Проверяются заголовок, размер файла и монотонность row_ptr. Номера
+    столбцов не проверяются, чтобы открытие не читало весь файл.
+    Возвращает описание ошибки или nullptr.
+*/
+template <class T>
+const char* matrix_binary_check(std::string_view data) {
+    using traits = matrix_binary_type<T>;
+    matrix_binary_header header;
+    if (data.size() < sizeof(header)) {
+        return "file header broken";
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, matrix_binary_magic, sizeof(header.magic)) != 0) {
+        return "no matrix in file";
+    }
+    if (header.version != matrix_binary_version) {
+        return "unsupported format version";
+    }
+    if (header.type_tag != traits::tag || header.value_size != sizeof(typename traits::stored_type)) {
+        return "invalid type";
+    }
+    if (header.nnz > std::uint64_t(header.rows) * header.cols) {
+        return "invalid matrix size";
+    }
+    // до подсчета размеров: nnz * (4 + value_size) не должно переполниться
+    if (header.nnz > (data.size() - sizeof(header)) / (sizeof(std::uint32_t) + header.value_size)) {
+        return "invalid file size";
+    }
+    matrix_binary_layout layout(header.rows, header.nnz, header.value_size);
+    if (data.size() != layout.size) {
+        return "invalid file size";
+    }
+    auto row_ptr = reinterpret_cast<const std::uint64_t*>(data.data() + layout.row_ptr);
+    if (row_ptr[0] != 0 || row_ptr[header.rows] != header.nnz) {
+        return "invalid row pointers";
+    }
+    for (std::uint32_t i = 0; i < header.rows; ++i) {
+        if (row_ptr[i] > row_ptr[i + 1]) {
+            return "invalid row pointers";
+        }
+    }
+    return nullptr;
+}
+
+/**
+    \brief Представление матрицы в двоичном файле, отображенном в память
+
+    Ничего не копирует: массивы читаются прямо из отображения. Создается
+    через Matrix::open_binary_file, которая проверяет файл.
+*/
+template <class T>
+class Matrix_binary_view {
+public:
+    using traits = matrix_binary_type<T>;
+    using stored_type = typename traits::stored_type;
+
+    /// Конструктор по проверенному отображению файла
+    explicit Matrix_binary_view(Mapped_file&& file) : file_(std::move(file)) {
+        std::memcpy(&header_, file_.data(), sizeof(header_));
+        matrix_binary_layout layout(header_.rows, header_.nnz, header_.value_size);
+        row_ptr_ = reinterpret_cast<const std::uint64_t*>(file_.data() + layout.row_ptr);
+        col_idx_ = reinterpret_cast<const std::uint32_t*>(file_.data() + layout.col_idx);
+        values_ = reinterpret_cast<const stored_type*>(file_.data() + layout.values);
+    }
+
+    unsigned get_rows_num() const { return header_.rows; }
+    unsigned get_cols_num() const { return header_.cols; }
+    std::uint64_t nnz() const { return header_.nnz; }
+
+    /// Массив начал строк (rows + 1 элементов)
+    const std::uint64_t* row_ptr() const { return row_ptr_; }
+    /// Массив номеров столбцов
+    const std::uint32_t* col_idx() const { return col_idx_; }
+    /// Массив значений в хранимом представлении
+    const stored_type* values() const { return values_; }
+
+    /// Оператор получения элемента (двоичный поиск в строке)
+    T operator() (unsigned row_num, unsigned col_num) const {
+        if (row_num < 1 || row_num > header_.rows) {
+            return T(0);
+        }
+        auto first = col_idx_ + row_ptr_[row_num - 1];
+        auto last = col_idx_ + row_ptr_[row_num];
+        auto it = std::lower_bound(first, last, col_num);
+        if (it == last || *it != col_num) {
+            return T(0);
+        }
+        return traits::load(values_[it - col_idx_]);
+    }
+
+    /// Обход элементов f(строка, столбец, значение) по порядку
+    template <class F>
+    void for_each(F f) const {
+        for (std::uint32_t i = 0; i < header_.rows; ++i) {
+            for (auto pos = row_ptr_[i]; pos < row_ptr_[i + 1]; ++pos) {
+                f(i + 1, col_idx_[pos], traits::load(values_[pos]));
+            }
+        }
+    }
+
+private:
+    Mapped_file file_;
+    matrix_binary_header header_;
+    const std::uint64_t* row_ptr_;
+    const std::uint32_t* col_idx_;
+    const stored_type* values_;
+};
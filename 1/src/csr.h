@@ -0,0 +1,542 @@
+#pragma once
+
+#include "storage.h"
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/**
+    \brief Плоский упорядоченный словарь
+
+    Хранит пары (ключ, значение) в отсортированном массиве. Используется
+    как строка матрицы при задании элементов списком инициализации, а также
+    как самостоятельный контейнер.
+*/
+template <class K, class V>
+class csr_map {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    /// Конструктор по умолчанию
+    csr_map() = default;
+
+    /// Конструктор по списку пар (при повторе ключа остается первое значение)
+    csr_map(std::initializer_list<value_type> init) {
+        for (const auto& [key, value] : init) {
+            if (find(key) == end()) {
+                operator[](key) = value;
+            }
+        }
+    }
+
+    iterator begin() { return data_.begin(); }
+    iterator end() { return data_.end(); }
+    const_iterator begin() const { return data_.begin(); }
+    const_iterator end() const { return data_.end(); }
+
+    /// Метод получения первого элемента с ключом не меньше заданного
+    iterator lower_bound(const K& key) {
+        return std::lower_bound(data_.begin(), data_.end(), key,
+            [](const value_type& elem, const K& k) { return elem.first < k; });
+    }
+
+    /// Метод получения первого элемента с ключом не меньше заданного
+    const_iterator lower_bound(const K& key) const {
+        return std::lower_bound(data_.begin(), data_.end(), key,
+            [](const value_type& elem, const K& k) { return elem.first < k; });
+    }
+
+    /// Метод поиска элемента
+    iterator find(const K& key) {
+        auto it = lower_bound(key);
+        return (it != end() && it->first == key) ? it : end();
+    }
+
+    /// Метод поиска элемента
+    const_iterator find(const K& key) const {
+        auto it = lower_bound(key);
+        return (it != end() && it->first == key) ? it : end();
+    }
+
+    /// Оператор доступа к элементу (с созданием при отсутствии)
+    V& operator[] (const K& key) {
+        auto it = lower_bound(key);
+        if (it == end() || it->first != key) {
+            it = data_.insert(it, value_type(key, V{}));
+        }
+        return it->second;
+    }
+
+    /// Вставка с подсказкой (в конец - за амортизированное O(1))
+    iterator emplace_hint(const_iterator, const K& key, const V& value) {
+        if (data_.empty() || data_.back().first < key) {
+            data_.emplace_back(key, value);
+            return std::prev(data_.end());
+        }
+        auto it = lower_bound(key);
+        if (it != end() && it->first == key) {
+            return it;
+        }
+        return data_.insert(it, value_type(key, value));
+    }
+
+    /// Метод удаления элемента по ключу
+    std::size_t erase(const K& key) {
+        auto it = find(key);
+        if (it == end()) {
+            return 0;
+        }
+        data_.erase(it);
+        return 1;
+    }
+
+    bool empty() const { return data_.empty(); }
+    std::size_t size() const { return data_.size(); }
+    void clear() { data_.clear(); }
+
+private:
+    /// Отсортированный по ключу массив пар
+    std::vector<value_type> data_;
+};
+
+/**
+    \brief Контейнер элементов матрицы в формате CSR
+
+    Специализация для M<unsigned, M<unsigned, T>>: элементы хранятся в
+    трех непрерывных массивах. row_ptr_[r]..row_ptr_[r + 1] - диапазон
+    строки r в массивах col_idx_ (номера столбцов по возрастанию) и values_.
+    Интерфейс повторяет вложенный словарь, поэтому контейнер можно
+    передавать в Matrix вместо std::map: Matrix<double, csr_map>.
+
+    Вставка в середину стоит O(nnz), поэтому операции над матрицами строят
+    результат добавлением в конец (storage_append). Представление CSC
+    той же матрицы совпадает с CSR транспонированной и строится методом
+    transposed() за один проход подсчета.
+*/
+template <class T>
+class csr_map<unsigned, csr_map<unsigned, T>> {
+public:
+    using key_type = unsigned;
+    using mapped_type = csr_map<unsigned, T>;
+
+    /// Итератор по элементам строки
+    template <bool Const>
+    class basic_elem_iterator {
+    public:
+        using parent_type = std::conditional_t<Const, const csr_map, csr_map>;
+        using value_ref = std::conditional_t<Const, const T, T>;
+        using value_type = storage_entry<unsigned, value_ref>;
+        using reference = value_type&;
+        using pointer = value_type*;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        basic_elem_iterator(parent_type* parent, std::size_t pos) :
+            parent_(parent), pos_(pos) {}
+
+        basic_elem_iterator(const basic_elem_iterator& other) :
+            parent_(other.parent_), pos_(other.pos_) {}
+
+        basic_elem_iterator& operator= (const basic_elem_iterator& other) {
+            parent_ = other.parent_;
+            pos_ = other.pos_;
+            current_.reset();
+            return *this;
+        }
+
+        reference operator* () const {
+            current_.emplace(value_type{parent_->col_idx_[pos_], parent_->values_[pos_]});
+            return *current_;
+        }
+
+        pointer operator-> () const {
+            return &operator*();
+        }
+
+        basic_elem_iterator& operator++ () {
+            ++pos_;
+            return *this;
+        }
+
+        basic_elem_iterator operator++ (int) {
+            auto old = *this;
+            ++pos_;
+            return old;
+        }
+
+        bool operator== (const basic_elem_iterator& other) const { return pos_ == other.pos_; }
+        bool operator!= (const basic_elem_iterator& other) const { return pos_ != other.pos_; }
+
+        /// Метод получения позиции в массивах col_idx/values
+        std::size_t pos() const { return pos_; }
+
+    private:
+        parent_type* parent_;
+        std::size_t pos_;
+        mutable std::optional<value_type> current_;
+    };
+
+    using elem_iterator = basic_elem_iterator<false>;
+    using const_elem_iterator = basic_elem_iterator<true>;
+
+    /// Представление одной строки (ссылка на часть массивов)
+    template <bool Const>
+    class basic_row {
+    public:
+        using parent_type = std::conditional_t<Const, const csr_map, csr_map>;
+        using iterator = basic_elem_iterator<Const>;
+
+        basic_row(parent_type* parent, unsigned row_num) :
+            parent_(parent), row_num_(row_num) {}
+
+        iterator begin() const { return iterator(parent_, first()); }
+        iterator end() const { return iterator(parent_, last()); }
+
+        /// Метод получения первого элемента со столбцом не меньше заданного
+        iterator lower_bound(unsigned col_num) const {
+            auto b = parent_->col_idx_.begin();
+            return iterator(parent_, std::lower_bound(b + first(), b + last(), col_num) - b);
+        }
+
+        /// Метод поиска элемента
+        iterator find(unsigned col_num) const {
+            auto it = lower_bound(col_num);
+            if (it.pos() != last() && parent_->col_idx_[it.pos()] == col_num) {
+                return it;
+            }
+            return end();
+        }
+
+        /// Оператор доступа к элементу (с созданием при отсутствии)
+        template <bool C = Const, class = std::enable_if_t<!C>>
+        T& operator[] (unsigned col_num) const {
+            auto pos = lower_bound(col_num).pos();
+            if (pos == last() || parent_->col_idx_[pos] != col_num) {
+                parent_->insert_at(row_num_, pos, col_num, T{});
+            }
+            return parent_->values_[pos];
+        }
+
+        /// Метод удаления элемента строки
+        template <bool C = Const, class = std::enable_if_t<!C>>
+        std::size_t erase(unsigned col_num) const {
+            auto it = find(col_num);
+            if (it == end()) {
+                return 0;
+            }
+            parent_->erase_at(row_num_, it.pos());
+            return 1;
+        }
+
+        /// Замена содержимого строки
+        template <bool C = Const, class = std::enable_if_t<!C>>
+        basic_row& operator= (std::initializer_list<std::pair<const unsigned, T>> init) {
+            parent_->erase(row_num_);
+            for (const auto& [col_num, value] : init) {
+                operator[](col_num) = value;
+            }
+            return *this;
+        }
+
+        bool empty() const { return first() == last(); }
+        std::size_t size() const { return last() - first(); }
+
+    private:
+        std::size_t first() const {
+            return row_num_ + 1 < parent_->row_ptr_.size() ? parent_->row_ptr_[row_num_] : parent_->values_.size();
+        }
+
+        std::size_t last() const {
+            return row_num_ + 1 < parent_->row_ptr_.size() ? parent_->row_ptr_[row_num_ + 1] : parent_->values_.size();
+        }
+
+        parent_type* parent_;
+        unsigned row_num_;
+    };
+
+    using row_ref = basic_row<false>;
+    using const_row_ref = basic_row<true>;
+
+    /// Итератор по непустым строкам
+    template <bool Const>
+    class basic_iterator {
+    public:
+        using parent_type = std::conditional_t<Const, const csr_map, csr_map>;
+        using value_type = std::pair<unsigned, basic_row<Const>>;
+        using reference = value_type&;
+        using pointer = value_type*;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        basic_iterator(parent_type* parent, unsigned row_num) :
+            parent_(parent), row_num_(row_num), current_(row_num, basic_row<Const>(parent, row_num))
+        {
+            skip_empty();
+        }
+
+        reference operator* () const {
+            current_ = value_type(row_num_, basic_row<Const>(parent_, row_num_));
+            return current_;
+        }
+
+        pointer operator-> () const {
+            return &operator*();
+        }
+
+        basic_iterator& operator++ () {
+            ++row_num_;
+            skip_empty();
+            return *this;
+        }
+
+        basic_iterator operator++ (int) {
+            auto old = *this;
+            operator++();
+            return old;
+        }
+
+        bool operator== (const basic_iterator& other) const { return row_num_ == other.row_num_; }
+        bool operator!= (const basic_iterator& other) const { return row_num_ != other.row_num_; }
+
+    private:
+        void skip_empty() {
+            while (row_num_ + 1 < parent_->row_ptr_.size() &&
+                parent_->row_ptr_[row_num_] == parent_->row_ptr_[row_num_ + 1])
+            {
+                ++row_num_;
+            }
+        }
+
+        parent_type* parent_;
+        unsigned row_num_;
+        mutable value_type current_;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    /// Конструктор по умолчанию
+    csr_map() = default;
+
+    /// Конструктор по списку строк
+    csr_map(std::initializer_list<std::pair<const unsigned, csr_map<unsigned, T>>> init) {
+        std::vector<std::pair<unsigned, const csr_map<unsigned, T>*>> rows;
+        for (const auto& [row_num, row] : init) {
+            rows.emplace_back(row_num, &row);
+        }
+        std::stable_sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            if (i > 0 && rows[i].first == rows[i - 1].first) {
+                continue;
+            }
+            for (const auto& [col_num, value] : *rows[i].second) {
+                push_back(rows[i].first, col_num, value);
+            }
+        }
+    }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, end_row()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, end_row()); }
+
+    /// Метод поиска непустой строки
+    iterator find(unsigned row_num) {
+        return has_row(row_num) ? iterator(this, row_num) : end();
+    }
+
+    /// Метод поиска непустой строки
+    const_iterator find(unsigned row_num) const {
+        return has_row(row_num) ? const_iterator(this, row_num) : end();
+    }
+
+    /// Оператор доступа к строке (строка создается при необходимости)
+    row_ref operator[] (unsigned row_num) {
+        ensure_row(row_num);
+        return row_ref(this, row_num);
+    }
+
+    /// Метод очистки строки
+    std::size_t erase(unsigned row_num) {
+        if (!has_row(row_num)) {
+            return 0;
+        }
+        auto first = row_ptr_[row_num];
+        auto count = row_ptr_[row_num + 1] - first;
+        col_idx_.erase(col_idx_.begin() + first, col_idx_.begin() + first + count);
+        values_.erase(values_.begin() + first, values_.begin() + first + count);
+        for (std::size_t r = row_num + 1; r < row_ptr_.size(); ++r) {
+            row_ptr_[r] -= count;
+        }
+        return 1;
+    }
+
+    /// Метод добавления элемента в конец (строка и столбец не меньше последних)
+    void push_back(unsigned row_num, unsigned col_num, const T& value) {
+        if (row_num + 1 >= row_ptr_.size()) {
+            ensure_row(row_num);
+        } else if (row_num + 2 < row_ptr_.size()) {
+            // строка не последняя - обычная вставка
+            operator[](row_num)[col_num] = value;
+            return;
+        }
+        auto& row_last = row_ptr_[row_num + 1];
+        if (row_last > row_ptr_[row_num] && col_idx_[row_last - 1] >= col_num) {
+            operator[](row_num)[col_num] = value;
+            return;
+        }
+        col_idx_.push_back(col_num);
+        values_.push_back(value);
+        ++row_last;
+    }
+
+    /// Метод резервирования памяти под элементы
+    void reserve(std::size_t nnz) {
+        col_idx_.reserve(nnz);
+        values_.reserve(nnz);
+    }
+
+    /// Метод удаления элементов по условию за один проход
+    template <class Pred>
+    void erase_if(Pred pred) {
+        std::size_t out = 0;
+        std::size_t row_begin = 0;
+        for (std::size_t r = 0; r + 1 < row_ptr_.size(); ++r) {
+            auto row_end = row_ptr_[r + 1];
+            for (std::size_t pos = row_begin; pos < row_end; ++pos) {
+                if (!pred(values_[pos])) {
+                    if (out != pos) {
+                        col_idx_[out] = col_idx_[pos];
+                        values_[out] = std::move(values_[pos]);
+                    }
+                    ++out;
+                }
+            }
+            row_begin = row_end;
+            row_ptr_[r + 1] = out;
+        }
+        col_idx_.resize(out);
+        values_.resize(out);
+    }
+
+    /**
+        \brief Транспонирование (CSC исходного контейнера)
+
+        Строит CSR транспонированной матрицы: подсчет элементов в каждом
+        столбце, префиксные суммы, затем раскладка элементов. Номера строк
+        внутри каждого столбца получаются упорядоченными автоматически.
+    */
+    csr_map transposed() const {
+        csr_map res;
+        unsigned cols = 0;
+        for (auto col_num : col_idx_) {
+            cols = std::max(cols, col_num + 1);
+        }
+        res.row_ptr_.assign(cols + 1, 0);
+        for (auto col_num : col_idx_) {
+            ++res.row_ptr_[col_num + 1];
+        }
+        for (std::size_t c = 0; c < cols; ++c) {
+            res.row_ptr_[c + 1] += res.row_ptr_[c];
+        }
+        res.col_idx_.resize(col_idx_.size());
+        res.values_.resize(values_.size());
+        std::vector<std::size_t> next(res.row_ptr_.begin(), res.row_ptr_.end() - 1);
+        for (std::size_t r = 0; r + 1 < row_ptr_.size(); ++r) {
+            for (auto pos = row_ptr_[r]; pos < row_ptr_[r + 1]; ++pos) {
+                auto dst = next[col_idx_[pos]]++;
+                res.col_idx_[dst] = r;
+                res.values_[dst] = values_[pos];
+            }
+        }
+        return res;
+    }
+
+    bool empty() const { return values_.empty(); }
+    void clear() { row_ptr_.assign(1, 0); col_idx_.clear(); values_.clear(); }
+
+    /// Метод получения количества хранимых элементов
+    std::size_t nnz() const { return values_.size(); }
+
+    /// Массив начал строк
+    const std::vector<std::size_t>& row_ptr() const { return row_ptr_; }
+    /// Массив номеров столбцов
+    const std::vector<unsigned>& col_idx() const { return col_idx_; }
+    /// Массив значений
+    const std::vector<T>& values() const { return values_; }
+
+private:
+    unsigned end_row() const {
+        return row_ptr_.size() - 1;
+    }
+
+    bool has_row(unsigned row_num) const {
+        return row_num + 1 < row_ptr_.size() && row_ptr_[row_num] != row_ptr_[row_num + 1];
+    }
+
+    void ensure_row(unsigned row_num) {
+        if (row_num + 1 >= row_ptr_.size()) {
+            row_ptr_.resize(row_num + 2, row_ptr_.back());
+        }
+    }
+
+    void insert_at(unsigned row_num, std::size_t pos, unsigned col_num, const T& value) {
+        col_idx_.insert(col_idx_.begin() + pos, col_num);
+        values_.insert(values_.begin() + pos, value);
+        for (std::size_t r = row_num + 1; r < row_ptr_.size(); ++r) {
+            ++row_ptr_[r];
+        }
+    }
+
+    void erase_at(unsigned row_num, std::size_t pos) {
+        col_idx_.erase(col_idx_.begin() + pos);
+        values_.erase(values_.begin() + pos);
+        for (std::size_t r = row_num + 1; r < row_ptr_.size(); ++r) {
+            --row_ptr_[r];
+        }
+    }
+
+    /// Начала строк (размер - максимальный номер строки + 2)
+    std::vector<std::size_t> row_ptr_{0};
+    /// Номера столбцов
+    std::vector<unsigned> col_idx_;
+    /// Значения
+    std::vector<T> values_;
+};
+
+/// Добавление элемента в конец CSR-контейнера
+template <class T>
+void storage_append(csr_map<unsigned, csr_map<unsigned, T>>& map,
+    unsigned row_num, unsigned col_num, const T& value)
+{
+    map.push_back(row_num, col_num, value);
+}
+
+/// Вставка в середину CSR-контейнера сдвигает массивы
+template <class T>
+bool storage_shifting(const csr_map<unsigned, csr_map<unsigned, T>>&) {
+    return true;
+}
+
+/// Удаление элементов CSR-контейнера по условию (сжатие массивов)
+template <class T, class Pred>
+void storage_erase_if(csr_map<unsigned, csr_map<unsigned, T>>& map, Pred pred) {
+    map.erase_if(pred);
+}
+
+/// Транспонирование CSR-контейнера проходом подсчета
+template <class T>
+void storage_transpose(const csr_map<unsigned, csr_map<unsigned, T>>& src,
+    csr_map<unsigned, csr_map<unsigned, T>>& dst)
+{
+    dst = src.transposed();
+}
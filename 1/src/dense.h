@@ -0,0 +1,796 @@
+#pragma once
+
+#include "storage.h"
+#include "csr.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <initializer_list>
+#include <new>
+#include <optional>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/**
+    \brief Аллокатор с выравниванием
+
+    Выделяет память, выровненную по Align байт (по умолчанию - по строке
+    кэша, что подходит и для загрузки регистров AVX).
+*/
+template <class T, std::size_t Align = 64>
+class aligned_allocator {
+public:
+    using value_type = T;
+
+    template <class U>
+    struct rebind {
+        using other = aligned_allocator<U, Align>;
+    };
+
+    aligned_allocator() = default;
+
+    template <class U>
+    aligned_allocator(const aligned_allocator<U, Align>&) {}
+
+    T* allocate(std::size_t n) {
+        std::size_t bytes = (n * sizeof(T) + Align - 1) / Align * Align;
+        void* ptr = std::aligned_alloc(Align, std::max(bytes, Align));
+        if (ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, std::size_t) {
+        std::free(ptr);
+    }
+
+    template <class U>
+    bool operator== (const aligned_allocator<U, Align>&) const { return true; }
+
+    template <class U>
+    bool operator!= (const aligned_allocator<U, Align>&) const { return false; }
+};
+
+/**
+    \brief Строка плотной матрицы при задании списком инициализации
+
+    Совпадает с плоским упорядоченным словарем csr_map.
+*/
+template <class K, class V>
+class dense_map : public csr_map<K, V> {
+public:
+    using csr_map<K, V>::csr_map;
+};
+
+/**
+    \brief Плотный контейнер элементов матрицы
+
+    Специализация для M<unsigned, M<unsigned, T>>: все ячейки хранятся в
+    одном выровненном массиве по строкам; длина строки в массиве (stride)
+    округляется до 8 элементов, чтобы каждая строка начиналась с
+    выровненного адреса. Нумерация строк и столбцов - с 1, как в Matrix.
+
+    Элементом контейнера считается ненулевая ячейка или ячейка, записанная
+    явно (operator[] строки, set()): как и в словарных контейнерах,
+    записанный ноль хранится, пока его не удалят erase(). Явные записи
+    отмечаются в битовой маске, которая создается при первой такой записи.
+    Обход строки и find() пропускают остальные нули, erase() записывает
+    ноль и снимает отметку. Обход по строкам идет по всем строкам матрицы.
+*/
+template <class T>
+class dense_map<unsigned, dense_map<unsigned, T>> {
+public:
+    using key_type = unsigned;
+    using mapped_type = dense_map<unsigned, T>;
+
+    /// Итератор по хранимым элементам строки
+    template <bool Const>
+    class basic_elem_iterator {
+    public:
+        using value_ref = std::conditional_t<Const, const T, T>;
+        using value_type = storage_entry<unsigned, value_ref>;
+        using reference = value_type&;
+        using pointer = value_type*;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        /// Конструктор (marks - отметки ячеек строки или nullptr, если отметок нет)
+        basic_elem_iterator(value_ref* row, const std::vector<bool>* marks, std::size_t marks_offset,
+            unsigned col_num, unsigned cols_num) :
+            row_(row), marks_(marks), marks_offset_(marks_offset), col_num_(col_num), cols_num_(cols_num)
+        {
+            skip_zeros();
+        }
+
+        basic_elem_iterator(const basic_elem_iterator& other) :
+            row_(other.row_), marks_(other.marks_), marks_offset_(other.marks_offset_),
+            col_num_(other.col_num_), cols_num_(other.cols_num_) {}
+
+        basic_elem_iterator& operator= (const basic_elem_iterator& other) {
+            row_ = other.row_;
+            marks_ = other.marks_;
+            marks_offset_ = other.marks_offset_;
+            col_num_ = other.col_num_;
+            cols_num_ = other.cols_num_;
+            current_.reset();
+            return *this;
+        }
+
+        reference operator* () const {
+            current_.emplace(value_type{col_num_, row_[col_num_ - 1]});
+            return *current_;
+        }
+
+        pointer operator-> () const {
+            return &operator*();
+        }
+
+        basic_elem_iterator& operator++ () {
+            ++col_num_;
+            skip_zeros();
+            return *this;
+        }
+
+        basic_elem_iterator operator++ (int) {
+            auto old = *this;
+            operator++();
+            return old;
+        }
+
+        bool operator== (const basic_elem_iterator& other) const { return col_num_ == other.col_num_; }
+        bool operator!= (const basic_elem_iterator& other) const { return col_num_ != other.col_num_; }
+
+    private:
+        void skip_zeros() {
+            while (col_num_ <= cols_num_ && row_[col_num_ - 1] == T(0) &&
+                !(marks_ && (*marks_)[marks_offset_ + col_num_ - 1]))
+            {
+                ++col_num_;
+            }
+        }
+
+        value_ref* row_;
+        const std::vector<bool>* marks_;
+        std::size_t marks_offset_;
+        unsigned col_num_;
+        unsigned cols_num_;
+        mutable std::optional<value_type> current_;
+    };
+
+    /// Представление одной строки
+    template <bool Const>
+    class basic_row {
+    public:
+        using parent_type = std::conditional_t<Const, const dense_map, dense_map>;
+        using iterator = basic_elem_iterator<Const>;
+
+        basic_row(parent_type* parent, unsigned row_num) :
+            parent_(parent), row_num_(row_num) {}
+
+        iterator begin() const { return make_iterator(1); }
+        iterator end() const { return make_iterator(parent_->cols_ + 1); }
+
+        /// Метод получения первого хранимого элемента со столбцом не меньше заданного
+        iterator lower_bound(unsigned col_num) const {
+            return make_iterator(std::max(1u, std::min(col_num, parent_->cols_ + 1)));
+        }
+
+        /// Метод поиска хранимого элемента
+        iterator find(unsigned col_num) const {
+            if (col_num < 1 || col_num > parent_->cols_ || !parent_->stored(row_num_, col_num)) {
+                return end();
+            }
+            return make_iterator(col_num);
+        }
+
+        /// Оператор доступа к ячейке (ячейка отмечается как хранимая)
+        template <bool C = Const, class = std::enable_if_t<!C>>
+        T& operator[] (unsigned col_num) const {
+            if (col_num > parent_->cols_) {
+                parent_->resize(parent_->rows_, col_num);
+            }
+            parent_->mark(row_num_, col_num);
+            return data()[col_num - 1];
+        }
+
+        /// Метод удаления ячейки (записывается ноль)
+        template <bool C = Const, class = std::enable_if_t<!C>>
+        std::size_t erase(unsigned col_num) const {
+            if (find(col_num) == end()) {
+                return 0;
+            }
+            data()[col_num - 1] = T(0);
+            parent_->unmark(row_num_, col_num);
+            return 1;
+        }
+
+        /// Замена содержимого строки
+        template <bool C = Const, class = std::enable_if_t<!C>>
+        basic_row& operator= (std::initializer_list<std::pair<const unsigned, T>> init) {
+            parent_->erase(row_num_);
+            for (const auto& [col_num, value] : init) {
+                operator[](col_num) = value;
+            }
+            return *this;
+        }
+
+        bool empty() const { return begin() == end(); }
+
+    private:
+        auto data() const {
+            return parent_->data() + std::size_t(row_num_ - 1) * parent_->stride_;
+        }
+
+        iterator make_iterator(unsigned col_num) const {
+            const auto* marks = parent_->marks_.empty() ? nullptr : &parent_->marks_;
+            return iterator(data(), marks, std::size_t(row_num_ - 1) * parent_->stride_, col_num, parent_->cols_);
+        }
+
+        parent_type* parent_;
+        unsigned row_num_;
+    };
+
+    using row_ref = basic_row<false>;
+    using const_row_ref = basic_row<true>;
+
+    /// Итератор по строкам
+    template <bool Const>
+    class basic_iterator {
+    public:
+        using parent_type = std::conditional_t<Const, const dense_map, dense_map>;
+        using value_type = std::pair<unsigned, basic_row<Const>>;
+        using reference = value_type&;
+        using pointer = value_type*;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        basic_iterator(parent_type* parent, unsigned row_num) :
+            parent_(parent), row_num_(row_num), current_(row_num, basic_row<Const>(parent, row_num)) {}
+
+        reference operator* () const {
+            current_ = value_type(row_num_, basic_row<Const>(parent_, row_num_));
+            return current_;
+        }
+
+        pointer operator-> () const {
+            return &operator*();
+        }
+
+        basic_iterator& operator++ () {
+            ++row_num_;
+            return *this;
+        }
+
+        basic_iterator operator++ (int) {
+            auto old = *this;
+            ++row_num_;
+            return old;
+        }
+
+        bool operator== (const basic_iterator& other) const { return row_num_ == other.row_num_; }
+        bool operator!= (const basic_iterator& other) const { return row_num_ != other.row_num_; }
+
+    private:
+        parent_type* parent_;
+        unsigned row_num_;
+        mutable value_type current_;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    /// Конструктор по умолчанию
+    dense_map() = default;
+
+    /// Конструктор по списку строк (размер - по наибольшим номерам)
+    dense_map(std::initializer_list<std::pair<const unsigned, dense_map<unsigned, T>>> init) {
+        unsigned rows = 0;
+        unsigned cols = 0;
+        for (const auto& [row_num, row] : init) {
+            rows = std::max(rows, row_num);
+            for (const auto& [col_num, value] : row) {
+                cols = std::max(cols, col_num);
+            }
+        }
+        resize(rows, cols);
+        for (const auto& [row_num, row] : init) {
+            for (const auto& [col_num, value] : row) {
+                set(row_num, col_num, value);
+            }
+        }
+    }
+
+    iterator begin() { return iterator(this, 1); }
+    iterator end() { return iterator(this, rows_ + 1); }
+    const_iterator begin() const { return const_iterator(this, 1); }
+    const_iterator end() const { return const_iterator(this, rows_ + 1); }
+
+    /// Метод поиска строки
+    iterator find(unsigned row_num) {
+        return (row_num >= 1 && row_num <= rows_) ? iterator(this, row_num) : end();
+    }
+
+    /// Метод поиска строки
+    const_iterator find(unsigned row_num) const {
+        return (row_num >= 1 && row_num <= rows_) ? const_iterator(this, row_num) : end();
+    }
+
+    /// Оператор доступа к строке
+    row_ref operator[] (unsigned row_num) {
+        if (row_num > rows_) {
+            resize(row_num, cols_);
+        }
+        return row_ref(this, row_num);
+    }
+
+    /// Метод удаления всех элементов строки
+    std::size_t erase(unsigned row_num) {
+        if (row_num < 1 || row_num > rows_) {
+            return 0;
+        }
+        std::size_t offset = std::size_t(row_num - 1) * stride_;
+        std::fill_n(data() + offset, cols_, T(0));
+        if (!marks_.empty()) {
+            std::fill_n(marks_.begin() + offset, cols_, false);
+        }
+        return 1;
+    }
+
+    /// Метод доступа к ячейке (с расширением при необходимости)
+    T& at(unsigned row_num, unsigned col_num) {
+        if (row_num > rows_ || col_num > cols_) {
+            resize(std::max(rows_, row_num), std::max(cols_, col_num));
+        }
+        return data_[std::size_t(row_num - 1) * stride_ + col_num - 1];
+    }
+
+    /// Запись значения ячейки (записанный ноль хранится)
+    void set(unsigned row_num, unsigned col_num, const T& value) {
+        at(row_num, col_num) = value;
+        if (value == T(0)) {
+            mark(row_num, col_num);
+        }
+    }
+
+    /// Хранится ли ячейка (не ноль или записана явно)
+    bool stored(unsigned row_num, unsigned col_num) const {
+        std::size_t pos = std::size_t(row_num - 1) * stride_ + col_num - 1;
+        return data_[pos] != T(0) || (!marks_.empty() && marks_[pos]);
+    }
+
+    /// Отметка ячейки как хранимой
+    void mark(unsigned row_num, unsigned col_num) {
+        if (marks_.empty()) {
+            marks_.assign(data_.size(), false);
+        }
+        marks_[std::size_t(row_num - 1) * stride_ + col_num - 1] = true;
+    }
+
+    /// Отметка всех ячеек матрицы как хранимых (выравнивание строк не отмечается)
+    void mark_all() {
+        marks_.assign(data_.size(), false);
+        for (std::size_t r = 0; r < rows_; ++r) {
+            std::fill_n(marks_.begin() + r * stride_, cols_, true);
+        }
+    }
+
+    /// Снятие отметки ячейки
+    void unmark(unsigned row_num, unsigned col_num) {
+        if (!marks_.empty()) {
+            marks_[std::size_t(row_num - 1) * stride_ + col_num - 1] = false;
+        }
+    }
+
+    /// Отметки явно записанных ячеек (пусто, если их не было)
+    const std::vector<bool>& marks() const { return marks_; }
+
+    /// Метод изменения размеров (содержимое общей части сохраняется)
+    void resize(unsigned rows_num, unsigned cols_num) {
+        if (rows_num == rows_ && cols_num == cols_) {
+            return;
+        }
+        std::size_t stride = (std::size_t(cols_num) + 7) / 8 * 8;
+        std::vector<T, aligned_allocator<T>> data(rows_num * stride, T(0));
+        for (unsigned r = 0; r < std::min(rows_, rows_num); ++r) {
+            std::copy_n(data_.begin() + r * stride_, std::min(cols_, cols_num), data.begin() + r * stride);
+        }
+        if (!marks_.empty()) {
+            std::vector<bool> marks(data.size(), false);
+            for (std::size_t r = 0; r < std::min(rows_, rows_num); ++r) {
+                for (std::size_t c = 0; c < std::min(cols_, cols_num); ++c) {
+                    marks[r * stride + c] = marks_[r * stride_ + c];
+                }
+            }
+            marks_ = std::move(marks);
+        }
+        data_ = std::move(data);
+        rows_ = rows_num;
+        cols_ = cols_num;
+        stride_ = stride;
+    }
+
+    /// Метод удаления хранимых ячеек по условию (возвращает количество оставшихся)
+    template <class Pred>
+    std::size_t erase_if(Pred pred) {
+        std::size_t kept = 0;
+        if (marks_.empty()) {
+            for (auto& elem : data_) {
+                if (elem != T(0)) {
+                    if (pred(elem)) {
+                        elem = T(0);
+                    } else {
+                        ++kept;
+                    }
+                }
+            }
+            return kept;
+        }
+        for (std::size_t pos = 0; pos < data_.size(); ++pos) {
+            if (data_[pos] != T(0) || marks_[pos]) {
+                if (pred(data_[pos])) {
+                    data_[pos] = T(0);
+                    marks_[pos] = false;
+                } else {
+                    ++kept;
+                }
+            }
+        }
+        return kept;
+    }
+
+    bool empty() const {
+        return std::all_of(data_.begin(), data_.end(), [](const T& elem) { return elem == T(0); }) &&
+            std::find(marks_.begin(), marks_.end(), true) == marks_.end();
+    }
+
+    void clear() {
+        std::fill(data_.begin(), data_.end(), T(0));
+        marks_.clear();
+    }
+
+    /// Количество строк
+    unsigned rows() const { return rows_; }
+    /// Количество столбцов
+    unsigned cols() const { return cols_; }
+    /// Расстояние между началами строк в массиве
+    std::size_t stride() const { return stride_; }
+    /// Массив ячеек
+    T* data() { return data_.data(); }
+    /// Массив ячеек
+    const T* data() const { return data_.data(); }
+
+private:
+    unsigned rows_ = 0;
+    unsigned cols_ = 0;
+    std::size_t stride_ = 0;
+    /// Ячейки по строкам, строка занимает stride_ элементов
+    std::vector<T, aligned_allocator<T>> data_;
+    /// Отметки явно записанных ячеек (раскладка как у data_; пусто, пока отметок нет)
+    std::vector<bool> marks_;
+};
+
+template <class T>
+struct is_dense_storage<dense_map<unsigned, dense_map<unsigned, T>>> : std::true_type {};
+
+/// Доступ к плотному представлению (всегда есть)
+template <class T>
+dense_map<unsigned, dense_map<unsigned, T>>* storage_dense(dense_map<unsigned, dense_map<unsigned, T>>& map) {
+    return &map;
+}
+
+/// Доступ к плотному представлению константного контейнера (всегда есть)
+template <class T>
+const dense_map<unsigned, dense_map<unsigned, T>>* storage_dense(const dense_map<unsigned, dense_map<unsigned, T>>& map) {
+    return &map;
+}
+
+/**
+    \brief Замена содержимого контейнера плотным представлением
+
+    Общая версия переносит ненулевые элементы по одному.
+*/
+template <class C, class T>
+void storage_assign_dense(C& map, dense_map<unsigned, dense_map<unsigned, T>>&& dense) {
+    map = C{};
+    storage_resize(map, dense.rows(), dense.cols());
+    for (const auto& [row_num, row] : dense) {
+        for (const auto& [col_num, elem] : row) {
+            storage_append(map, row_num, col_num, elem);
+        }
+    }
+}
+
+/// Замена содержимого плотного контейнера
+template <class T>
+void storage_assign_dense(dense_map<unsigned, dense_map<unsigned, T>>& map,
+    dense_map<unsigned, dense_map<unsigned, T>>&& dense)
+{
+    map = std::move(dense);
+}
+
+/// Задание размеров плотного контейнера
+template <class T>
+void storage_resize(dense_map<unsigned, dense_map<unsigned, T>>& map, unsigned rows_num, unsigned cols_num) {
+    map.resize(rows_num, cols_num);
+}
+
+/// Запись элемента плотного контейнера
+template <class T>
+void storage_append(dense_map<unsigned, dense_map<unsigned, T>>& map,
+    unsigned row_num, unsigned col_num, const T& value)
+{
+    map.set(row_num, col_num, value);
+}
+
+/// Обнуление ячеек плотного контейнера по условию
+template <class T, class Pred>
+void storage_erase_if(dense_map<unsigned, dense_map<unsigned, T>>& map, Pred pred) {
+    map.erase_if(pred);
+}
+
+/// Сторона листа рекурсивного транспонирования
+constexpr unsigned dense_transpose_leaf = 16;
+
+/**
+    \brief Кэш-независимое транспонирование блока [r0, r1) x [c0, c1)
+
+    Большая сторона блока делится пополам, пока блок не станет не больше
+    листа. На каждом уровне кэша найдется уровень рекурсии, где блоки
+    источника и результата в нем помещаются, поэтому размер блока не
+    подбирается под конкретный кэш.
+*/
+template <class T>
+void dense_transpose_block(const T* src, std::size_t src_stride, T* dst, std::size_t dst_stride,
+    unsigned r0, unsigned r1, unsigned c0, unsigned c1)
+{
+    if (r1 - r0 <= dense_transpose_leaf && c1 - c0 <= dense_transpose_leaf) {
+        for (unsigned i = r0; i < r1; ++i) {
+            for (unsigned j = c0; j < c1; ++j) {
+                dst[j * dst_stride + i] = src[i * src_stride + j];
+            }
+        }
+    } else if (r1 - r0 >= c1 - c0) {
+        unsigned mid = r0 + (r1 - r0) / 2;
+        dense_transpose_block(src, src_stride, dst, dst_stride, r0, mid, c0, c1);
+        dense_transpose_block(src, src_stride, dst, dst_stride, mid, r1, c0, c1);
+    } else {
+        unsigned mid = c0 + (c1 - c0) / 2;
+        dense_transpose_block(src, src_stride, dst, dst_stride, r0, r1, c0, mid);
+        dense_transpose_block(src, src_stride, dst, dst_stride, r0, r1, mid, c1);
+    }
+}
+
+/// Обмен блока [r0, r1) x [c0, c1) с симметричным ему относительно диагонали (блоки не пересекаются)
+template <class T>
+void dense_transpose_swap(T* data, std::size_t stride, unsigned r0, unsigned r1, unsigned c0, unsigned c1) {
+    using std::swap;
+    if (r1 - r0 <= dense_transpose_leaf && c1 - c0 <= dense_transpose_leaf) {
+        for (unsigned i = r0; i < r1; ++i) {
+            for (unsigned j = c0; j < c1; ++j) {
+                swap(data[i * stride + j], data[j * stride + i]);
+            }
+        }
+    } else if (r1 - r0 >= c1 - c0) {
+        unsigned mid = r0 + (r1 - r0) / 2;
+        dense_transpose_swap(data, stride, r0, mid, c0, c1);
+        dense_transpose_swap(data, stride, mid, r1, c0, c1);
+    } else {
+        unsigned mid = c0 + (c1 - c0) / 2;
+        dense_transpose_swap(data, stride, r0, r1, c0, mid);
+        dense_transpose_swap(data, stride, r0, r1, mid, c1);
+    }
+}
+
+/// Транспонирование на месте диагонального блока [b0, b1) x [b0, b1)
+template <class T>
+void dense_transpose_diagonal(T* data, std::size_t stride, unsigned b0, unsigned b1) {
+    using std::swap;
+    if (b1 - b0 <= dense_transpose_leaf) {
+        for (unsigned i = b0; i < b1; ++i) {
+            for (unsigned j = i + 1; j < b1; ++j) {
+                swap(data[i * stride + j], data[j * stride + i]);
+            }
+        }
+        return;
+    }
+    unsigned mid = b0 + (b1 - b0) / 2;
+    dense_transpose_diagonal(data, stride, b0, mid);
+    dense_transpose_diagonal(data, stride, mid, b1);
+    dense_transpose_swap(data, stride, mid, b1, b0, mid);
+}
+
+/// Транспонирование плотного контейнера (кэш-независимое)
+template <class T>
+void storage_transpose(const dense_map<unsigned, dense_map<unsigned, T>>& src,
+    dense_map<unsigned, dense_map<unsigned, T>>& dst)
+{
+    dst.resize(src.cols(), src.rows());
+    dense_transpose_block(src.data(), src.stride(), dst.data(), dst.stride(), 0, src.rows(), 0, src.cols());
+    const auto& marks = src.marks();
+    if (!marks.empty()) {
+        for (unsigned i = 1; i <= src.rows(); ++i) {
+            for (unsigned j = 1; j <= src.cols(); ++j) {
+                if (marks[std::size_t(i - 1) * src.stride() + j - 1]) {
+                    dst.mark(j, i);
+                }
+            }
+        }
+    }
+}
+
+/// Транспонирование квадратного плотного контейнера на месте
+template <class T>
+void dense_transpose_in_place(dense_map<unsigned, dense_map<unsigned, T>>& map) {
+    dense_transpose_diagonal(map.data(), map.stride(), 0, map.rows());
+    const auto& marks = map.marks();
+    if (!marks.empty()) {
+        for (unsigned i = 1; i <= map.rows(); ++i) {
+            for (unsigned j = i + 1; j <= map.rows(); ++j) {
+                bool upper = marks[std::size_t(i - 1) * map.stride() + j - 1];
+                bool lower = marks[std::size_t(j - 1) * map.stride() + i - 1];
+                if (upper != lower) {
+                    if (upper) {
+                        map.unmark(i, j);
+                        map.mark(j, i);
+                    } else {
+                        map.unmark(j, i);
+                        map.mark(i, j);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// Размеры блоков умножения: регистровая плитка MR x NR, блок K и блок N
+constexpr std::size_t dense_gemm_mr = 4;
+constexpr std::size_t dense_gemm_nr = 8;
+constexpr std::size_t dense_gemm_kc = 256;
+constexpr std::size_t dense_gemm_nc = 512;
+
+/**
+    \brief Микроядро умножения (переносимая версия)
+
+    tile[MR][NR] = A(MR x kc) * Bp(kc x NR), где Bp - упакованная панель B.
+*/
+inline void dense_gemm_micro_scalar(std::size_t kc, const double* a, std::size_t lda,
+    const double* bp, double* tile)
+{
+    double acc[dense_gemm_mr][dense_gemm_nr] = {};
+    for (std::size_t p = 0; p < kc; ++p) {
+        for (std::size_t r = 0; r < dense_gemm_mr; ++r) {
+            double ar = a[r * lda + p];
+            for (std::size_t j = 0; j < dense_gemm_nr; ++j) {
+                acc[r][j] += ar * bp[p * dense_gemm_nr + j];
+            }
+        }
+    }
+    for (std::size_t r = 0; r < dense_gemm_mr; ++r) {
+        for (std::size_t j = 0; j < dense_gemm_nr; ++j) {
+            tile[r * dense_gemm_nr + j] = acc[r][j];
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/// Микроядро умножения на AVX2/FMA: плитка 4 x 8 в восьми регистрах
+__attribute__((target("avx2,fma")))
+inline void dense_gemm_micro_avx2(std::size_t kc, const double* a, std::size_t lda,
+    const double* bp, double* tile)
+{
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    const double* a0 = a;
+    const double* a1 = a + lda;
+    const double* a2 = a + 2 * lda;
+    const double* a3 = a + 3 * lda;
+    for (std::size_t p = 0; p < kc; ++p) {
+        __m256d b0 = _mm256_load_pd(bp + p * dense_gemm_nr);
+        __m256d b1 = _mm256_load_pd(bp + p * dense_gemm_nr + 4);
+        __m256d av = _mm256_broadcast_sd(a0 + p);
+        c00 = _mm256_fmadd_pd(av, b0, c00);
+        c01 = _mm256_fmadd_pd(av, b1, c01);
+        av = _mm256_broadcast_sd(a1 + p);
+        c10 = _mm256_fmadd_pd(av, b0, c10);
+        c11 = _mm256_fmadd_pd(av, b1, c11);
+        av = _mm256_broadcast_sd(a2 + p);
+        c20 = _mm256_fmadd_pd(av, b0, c20);
+        c21 = _mm256_fmadd_pd(av, b1, c21);
+        av = _mm256_broadcast_sd(a3 + p);
+        c30 = _mm256_fmadd_pd(av, b0, c30);
+        c31 = _mm256_fmadd_pd(av, b1, c31);
+    }
+    _mm256_storeu_pd(tile, c00);
+    _mm256_storeu_pd(tile + 4, c01);
+    _mm256_storeu_pd(tile + 8, c10);
+    _mm256_storeu_pd(tile + 12, c11);
+    _mm256_storeu_pd(tile + 16, c20);
+    _mm256_storeu_pd(tile + 20, c21);
+    _mm256_storeu_pd(tile + 24, c30);
+    _mm256_storeu_pd(tile + 28, c31);
+}
+#endif
+
+/// Проверка наличия AVX2 и FMA у процессора (один раз за запуск)
+inline bool dense_gemm_has_avx2() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool res = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return res;
+#else
+    return false;
+#endif
+}
+
+/**
+    \brief Умножение плотных матриц: C(m x n) += A(m x k) * B(k x n)
+
+    Блоки B размером kc x nc упаковываются в панели по NR столбцов
+    (дополняются нулями), затем по каждой плитке MR x NR считается
+    микроядро. Неполные по строкам плитки считаются по A, дополненной
+    нулевыми строками.
+*/
+inline void dense_gemm(const double* a, std::size_t lda, const double* b, std::size_t ldb,
+    double* c, std::size_t ldc, std::size_t m, std::size_t n, std::size_t k)
+{
+    const std::size_t mr = dense_gemm_mr;
+    const std::size_t nr = dense_gemm_nr;
+    bool avx2 = dense_gemm_has_avx2();
+    std::vector<double, aligned_allocator<double>> packed(dense_gemm_kc * dense_gemm_nc);
+    std::vector<double> a_tail(mr * dense_gemm_kc);
+    alignas(64) double tile[dense_gemm_mr * dense_gemm_nr];
+    for (std::size_t jc = 0; jc < n; jc += dense_gemm_nc) {
+        std::size_t nc = std::min(dense_gemm_nc, n - jc);
+        std::size_t panels = (nc + nr - 1) / nr;
+        for (std::size_t pc = 0; pc < k; pc += dense_gemm_kc) {
+            std::size_t kc = std::min(dense_gemm_kc, k - pc);
+            for (std::size_t jp = 0; jp < panels; ++jp) {
+                double* panel = packed.data() + jp * kc * nr;
+                for (std::size_t p = 0; p < kc; ++p) {
+                    const double* brow = b + (pc + p) * ldb + jc + jp * nr;
+                    std::size_t width = std::min(nr, nc - jp * nr);
+                    for (std::size_t j = 0; j < nr; ++j) {
+                        panel[p * nr + j] = j < width ? brow[j] : 0.0;
+                    }
+                }
+            }
+            for (std::size_t ic = 0; ic < m; ic += mr) {
+                std::size_t rows = std::min(mr, m - ic);
+                const double* a_block = a + ic * lda + pc;
+                std::size_t a_stride = lda;
+                if (rows < mr) {
+                    std::fill(a_tail.begin(), a_tail.end(), 0.0);
+                    for (std::size_t r = 0; r < rows; ++r) {
+                        std::copy_n(a_block + r * lda, kc, a_tail.begin() + r * kc);
+                    }
+                    a_block = a_tail.data();
+                    a_stride = kc;
+                }
+                for (std::size_t jp = 0; jp < panels; ++jp) {
+                    const double* panel = packed.data() + jp * kc * nr;
+#if defined(__x86_64__) || defined(__i386__)
+                    if (avx2) {
+                        dense_gemm_micro_avx2(kc, a_block, a_stride, panel, tile);
+                    } else {
+                        dense_gemm_micro_scalar(kc, a_block, a_stride, panel, tile);
+                    }
+#else
+                    dense_gemm_micro_scalar(kc, a_block, a_stride, panel, tile);
+#endif
+                    std::size_t width = std::min(nr, nc - jp * nr);
+                    for (std::size_t r = 0; r < rows; ++r) {
+                        double* crow = c + (ic + r) * ldc + jc + jp * nr;
+                        for (std::size_t j = 0; j < width; ++j) {
+                            crow[j] += tile[r * nr + j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
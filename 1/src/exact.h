@@ -0,0 +1,653 @@
+#pragma once
+
+#include "bigint.h"
+#include "matrix.h"
+#include "solver.h"
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+    \brief Исключение переполнения при точном исключении
+
+    Данный класс является исключением для ситуации, когда промежуточное
+    значение не помещается в выбранный целочисленный тип.
+*/
+class exact_overflow_error : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+/**
+    \brief Исключение вырожденной матрицы
+
+    Данный класс является исключением для ситуации, когда система не
+    имеет единственного решения.
+*/
+class singular_matrix_error : public std::runtime_error {
+public:
+    singular_matrix_error(std::string what, unsigned rank) :
+        std::runtime_error(what), rank(rank) {}
+    unsigned rank;
+};
+
+/// Проверять ли переполнение встроенными функциями для типа I
+template <class I>
+struct exact_checked : std::is_integral<I> {};
+
+template <>
+struct exact_checked<__int128> : std::true_type {};
+
+/// Умножение с проверкой переполнения
+template <class I>
+I exact_mul(const I& a, const I& b) {
+    if constexpr (exact_checked<I>::value) {
+        I res;
+        if (__builtin_mul_overflow(a, b, &res)) {
+            throw exact_overflow_error("integer overflow in exact elimination");
+        }
+        return res;
+    } else {
+        return a * b;
+    }
+}
+
+/// Сложение с проверкой переполнения
+template <class I>
+I exact_add(const I& a, const I& b) {
+    if constexpr (exact_checked<I>::value) {
+        I res;
+        if (__builtin_add_overflow(a, b, &res)) {
+            throw exact_overflow_error("integer overflow in exact elimination");
+        }
+        return res;
+    } else {
+        return a + b;
+    }
+}
+
+/// Вычитание с проверкой переполнения
+template <class I>
+I exact_sub(const I& a, const I& b) {
+    if constexpr (exact_checked<I>::value) {
+        I res;
+        if (__builtin_sub_overflow(a, b, &res)) {
+            throw exact_overflow_error("integer overflow in exact elimination");
+        }
+        return res;
+    } else {
+        return a - b;
+    }
+}
+
+/// НОД (неотрицательный)
+template <class I>
+I exact_gcd(I a, I b) {
+    if (a < 0) {
+        a = -a;
+    }
+    if (b < 0) {
+        b = -b;
+    }
+    while (b != 0) {
+        I tmp = a % b;
+        a = b;
+        b = tmp;
+    }
+    return a;
+}
+
+/// Несократимая дробь num / den со знаменателем больше нуля
+template <class I>
+RationalNumber<I> exact_fraction(I num, I den) {
+    if (den < 0) {
+        num = -num;
+        den = -den;
+    }
+    I g = exact_gcd(num, den);
+    if (g > 1) {
+        num = num / g;
+        den = den / g;
+    }
+    return RationalNumber<I>(num, den);
+}
+
+/// Числитель и знаменатель элемента матрицы
+template <class T>
+struct exact_traits {
+    static constexpr bool rational = false;
+    template <class I> static I numerator(const T& value) { return I(value); }
+    template <class I> static I denominator(const T&) { return I(1); }
+};
+
+template <class U>
+struct exact_traits<RationalNumber<U>> {
+    static constexpr bool rational = true;
+    template <class I> static I numerator(const RationalNumber<U>& value) { return I(value.get_numerator()); }
+    template <class I> static I denominator(const RationalNumber<U>& value) { return I(value.get_denominator()); }
+};
+
+/**
+    \brief Исключение Барейса без дробей
+
+    Работает с разреженными строками целых чисел типа I. На шаге k
+    элементы активной части заменяются по формуле
+    a_ij = (p * a_ij - a_ic * p_j) / p_prev, где p - ведущий элемент,
+    p_prev - ведущий элемент предыдущего шага; деление всегда нацело,
+    а все промежуточные значения - миноры исходной матрицы, поэтому их
+    размер растет линейно, а не экспоненциально.
+
+    Ведущий элемент выбирается по Марковицу (упрощенно): столбец с
+    наименьшим числом элементов в активной части, в нем - самая короткая
+    строка. Это удерживает заполнение разреженной матрицы. Ведущими
+    могут быть только столбцы с номерами меньше pivot_cols (остальные -
+    правые части систем).
+*/
+template <class I>
+class Bareiss_elimination {
+public:
+    using row_type = std::vector<std::pair<unsigned, I>>;
+
+    /// Конструктор по строкам (столбцы в строке - по возрастанию, с 0)
+    Bareiss_elimination(std::vector<row_type> rows, unsigned cols_num, unsigned pivot_cols, bool markowitz = true) :
+        rows_(std::move(rows)), cols_num_(cols_num), pivot_cols_num_(pivot_cols), markowitz_(markowitz)
+    {
+        run();
+    }
+
+    /// Ранг (количество выполненных шагов)
+    unsigned rank() const { return pivot_rows_.size(); }
+
+    /// Последний ведущий элемент: старший минор переставленной матрицы
+    const I& last_pivot() const { return last_pivot_; }
+
+    /// Строки, выбранные ведущими, по шагам
+    const std::vector<unsigned>& pivot_rows() const { return pivot_rows_; }
+
+    /// Столбцы, выбранные ведущими, по шагам
+    const std::vector<unsigned>& pivot_cols() const { return pivot_cols_; }
+
+    /// Строка после исключения (для ведущих строк - строка треугольной матрицы)
+    const row_type& row(unsigned row_num) const { return rows_[row_num]; }
+
+    /// Наибольшее количество хранимых элементов за время исключения
+    std::size_t peak_nnz() const { return peak_nnz_; }
+
+    /**
+        \brief Знак перестановок строк и столбцов
+
+        Для полного ранга квадратной части: det = sign() * last_pivot().
+    */
+    int sign() const {
+        return parity(pivot_rows_) * parity(pivot_cols_);
+    }
+
+private:
+    static int parity(const std::vector<unsigned>& perm) {
+        std::vector<bool> seen(perm.size(), false);
+        int res = 1;
+        for (std::size_t i = 0; i < perm.size(); ++i) {
+            if (seen[i]) {
+                continue;
+            }
+            std::size_t length = 0;
+            for (auto j = i; !seen[j]; j = perm[j]) {
+                seen[j] = true;
+                ++length;
+            }
+            if (length % 2 == 0) {
+                res = -res;
+            }
+        }
+        return res;
+    }
+
+    static const I* find(const row_type& row, unsigned col_num) {
+        auto it = std::lower_bound(row.begin(), row.end(), col_num,
+            [](const auto& entry, unsigned c) { return entry.first < c; });
+        return it != row.end() && it->first == col_num ? &it->second : nullptr;
+    }
+
+    void count(const row_type& row, int delta) {
+        for (const auto& [col_num, value] : row) {
+            col_count_[col_num] += delta;
+        }
+        nnz_ += delta * std::ptrdiff_t(row.size());
+    }
+
+    /// Выбор ведущего элемента среди активных строк, false - активная часть нулевая
+    bool choose(unsigned& pivot_row, unsigned& pivot_col) const {
+        bool found = false;
+        for (unsigned c = 0; c < pivot_cols_num_; ++c) {
+            if (col_done_[c] || col_count_[c] == 0) {
+                continue;
+            }
+            if (!found || col_count_[c] < col_count_[pivot_col]) {
+                pivot_col = c;
+                found = true;
+                if (!markowitz_ || col_count_[c] == 1) {
+                    break;
+                }
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        found = false;
+        for (unsigned r = 0; r < rows_.size(); ++r) {
+            if (row_done_[r] || find(rows_[r], pivot_col) == nullptr) {
+                continue;
+            }
+            if (!found || rows_[r].size() < rows_[pivot_row].size()) {
+                pivot_row = r;
+                found = true;
+                if (!markowitz_) {
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    void run() {
+        row_done_.assign(rows_.size(), false);
+        col_done_.assign(cols_num_, false);
+        col_count_.assign(cols_num_, 0);
+        for (const auto& row : rows_) {
+            count(row, 1);
+        }
+        peak_nnz_ = nnz_;
+        I prev = 1;
+        unsigned pivot_row = 0;
+        unsigned pivot_col = 0;
+        row_type next;
+        while (choose(pivot_row, pivot_col)) {
+            const auto& prow = rows_[pivot_row];
+            I pivot = *find(prow, pivot_col);
+            row_done_[pivot_row] = true;
+            col_done_[pivot_col] = true;
+            count(prow, -1);
+            for (unsigned r = 0; r < rows_.size(); ++r) {
+                if (row_done_[r]) {
+                    continue;
+                }
+                auto& row = rows_[r];
+                const I* coef = find(row, pivot_col);
+                if (coef == nullptr) {
+                    // элемента в ведущем столбце нет: строка только масштабируется
+                    if (pivot != prev) {
+                        for (auto& [col_num, value] : row) {
+                            value = exact_mul(value, pivot) / prev;
+                        }
+                    }
+                    continue;
+                }
+                I a = *coef;
+                count(row, -1);
+                next.clear();
+                auto it = row.begin();
+                auto pit = prow.begin();
+                while (it != row.end() || pit != prow.end()) {
+                    unsigned col_num;
+                    I value;
+                    if (pit == prow.end() || (it != row.end() && it->first < pit->first)) {
+                        col_num = it->first;
+                        value = exact_mul(it->second, pivot) / prev;
+                        ++it;
+                    } else if (it == row.end() || pit->first < it->first) {
+                        col_num = pit->first;
+                        value = exact_sub(I(0), exact_mul(a, pit->second)) / prev;
+                        ++pit;
+                    } else {
+                        col_num = it->first;
+                        value = exact_sub(exact_mul(it->second, pivot), exact_mul(a, pit->second)) / prev;
+                        ++it;
+                        ++pit;
+                    }
+                    if (col_num != pivot_col && value != 0) {
+                        next.emplace_back(col_num, std::move(value));
+                    }
+                }
+                std::swap(row, next);
+                count(row, 1);
+            }
+            peak_nnz_ = std::max<std::size_t>(peak_nnz_, nnz_ + prow.size());
+            pivot_rows_.push_back(pivot_row);
+            pivot_cols_.push_back(pivot_col);
+            prev = pivot;
+        }
+        last_pivot_ = prev;
+    }
+
+    std::vector<row_type> rows_;
+    unsigned cols_num_;
+    unsigned pivot_cols_num_;
+    bool markowitz_;
+    std::vector<bool> row_done_;
+    std::vector<bool> col_done_;
+    /// Количество элементов активных строк в каждом столбце
+    std::vector<std::size_t> col_count_;
+    std::ptrdiff_t nnz_ = 0;
+    std::size_t peak_nnz_ = 0;
+    std::vector<unsigned> pivot_rows_;
+    std::vector<unsigned> pivot_cols_;
+    I last_pivot_ = 1;
+};
+
+/**
+    \brief Строки матрицы (и правой части) в целых числах типа I
+
+    Рациональная строка умножается на НОК знаменателей своих элементов
+    (вместе с элементом правой части); множители строк записываются в
+    scales. Столбцы - с 0, правая часть - столбец с номером cols_num.
+*/
+template <class I, class T, template <class...> class M>
+std::vector<typename Bareiss_elimination<I>::row_type> exact_rows(const Matrix<T, M>& a,
+    const std::vector<typename Matrix<T, M>::value_type>* b, std::vector<I>* scales)
+{
+    using traits = exact_traits<T>;
+    a.delete_zeros();
+    std::vector<typename Bareiss_elimination<I>::row_type> rows(a.get_rows_num());
+    std::vector<std::vector<std::pair<unsigned, T>>> values(a.get_rows_num());
+    for (const auto& [row_num, row] : a.get_map()) {
+        for (const auto& [col_num, elem] : row) {
+            values[row_num - 1].emplace_back(col_num - 1, elem);
+        }
+    }
+    if (b) {
+        for (std::size_t i = 0; i < b->size(); ++i) {
+            if ((*b)[i] != T(0)) {
+                values[i].emplace_back(a.get_cols_num(), (*b)[i]);
+            }
+        }
+    }
+    if (scales) {
+        scales->assign(rows.size(), I(1));
+    }
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        auto& row = values[i];
+        std::sort(row.begin(), row.end(), [](const auto& x, const auto& y) { return x.first < y.first; });
+        I scale = 1;
+        if constexpr (traits::rational) {
+            for (const auto& [col_num, elem] : row) {
+                I den = traits::template denominator<I>(elem);
+                scale = exact_mul(scale / exact_gcd(scale, den), den);
+            }
+            if (scales) {
+                (*scales)[i] = scale;
+            }
+        }
+        rows[i].reserve(row.size());
+        for (const auto& [col_num, elem] : row) {
+            I value = traits::template numerator<I>(elem);
+            if constexpr (traits::rational) {
+                value = exact_mul(value, scale / traits::template denominator<I>(elem));
+            }
+            rows[i].emplace_back(col_num, value);
+        }
+    }
+    return rows;
+}
+
+/// Проверка квадратности матрицы
+template <class T, template <class...> class M>
+void exact_check_square(const Matrix<T, M>& a) {
+    if (a.get_rows_num() != a.get_cols_num()) {
+        throw vector_size_error("matrix is not square", a.get_rows_num(), a.get_cols_num());
+    }
+}
+
+/**
+    \brief Точный определитель
+
+    Для целых матриц возвращает I, для рациональных - RationalNumber<I>.
+    При переполнении I выбрасывает exact_overflow_error.
+*/
+template <class I = long long, class T, template <class...> class M>
+auto exact_determinant(const Matrix<T, M>& a) {
+    exact_check_square(a);
+    std::vector<I> scales;
+    Bareiss_elimination<I> elim(exact_rows<I>(a, nullptr, &scales), a.get_cols_num(), a.get_cols_num());
+    bool singular = elim.rank() < a.get_rows_num();
+    I det = singular ? I(0) : I(elim.sign()) * elim.last_pivot();
+    if constexpr (exact_traits<T>::rational) {
+        if (singular) {
+            // произведение масштабов строк не нужно и может переполниться
+            return exact_fraction(det, I(1));
+        }
+        I den = 1;
+        for (const auto& scale : scales) {
+            den = exact_mul(den, scale);
+        }
+        return exact_fraction(det, den);
+    } else {
+        return det;
+    }
+}
+
+/// Точный ранг матрицы
+template <class I = long long, class T, template <class...> class M>
+unsigned exact_rank(const Matrix<T, M>& a) {
+    return Bareiss_elimination<I>(exact_rows<I>(a, nullptr, nullptr), a.get_cols_num(), a.get_cols_num()).rank();
+}
+
+/**
+    \brief Точное решение системы A x = b
+
+    Прямой ход - исключение Барейса над расширенной матрицей [A | b],
+    обратный ход тоже без дробей: y = det * x - целый вектор (по
+    правилу Крамера), и каждое деление в обратной подстановке нацело.
+    Для вырожденной матрицы выбрасывает singular_matrix_error.
+*/
+template <class I = long long, class T, template <class...> class M>
+std::vector<RationalNumber<I>> exact_solve(const Matrix<T, M>& a, const std::vector<T>& b) {
+    exact_check_square(a);
+    unsigned n = a.get_cols_num();
+    if (b.size() != n) {
+        throw vector_size_error("right side size differs", n, b.size());
+    }
+    Bareiss_elimination<I> elim(exact_rows<I>(a, &b, nullptr), n + 1, n);
+    if (elim.rank() != n) {
+        throw singular_matrix_error("matrix is singular", elim.rank());
+    }
+    const I& det = elim.last_pivot();
+    std::vector<I> y(n, I(0));
+    for (unsigned k = n; k-- > 0;) {
+        const auto& row = elim.row(elim.pivot_rows()[k]);
+        unsigned pivot_col = elim.pivot_cols()[k];
+        // det * b_k - sum_j u_kj y_j
+        I sum = 0;
+        I pivot = 0;
+        for (const auto& [col_num, value] : row) {
+            if (col_num == n) {
+                sum = exact_add(sum, exact_mul(det, value));
+            } else if (col_num == pivot_col) {
+                pivot = value;
+            } else {
+                sum = exact_sub(sum, exact_mul(value, y[col_num]));
+            }
+        }
+        y[pivot_col] = sum / pivot;
+    }
+    std::vector<RationalNumber<I>> x;
+    x.reserve(n);
+    for (const auto& value : y) {
+        x.push_back(exact_fraction(value, det));
+    }
+    return x;
+}
+
+/// Класс тестирования точного исключения
+class ExactTest {
+public:
+    /// Проверка A x = b в целых числах общего знаменателя
+    template <class I, class T>
+    static bool satisfies(const Matrix<T>& a, const std::vector<RationalNumber<I>>& x, const std::vector<T>& b) {
+        using traits = exact_traits<T>;
+        for (unsigned i = 1; i <= a.get_rows_num(); ++i) {
+            // sum_j a_ij x_j - b_i = 0 как дробь, знаменатели по очереди
+            I num = 0;
+            I den = 1;
+            auto add = [&](I n2, I d2) {
+                num = num * d2 + n2 * den;
+                den = den * d2;
+                I g = exact_gcd(num, den);
+                if (g > 1) {
+                    num /= g;
+                    den /= g;
+                }
+            };
+            for (unsigned j = 1; j <= a.get_cols_num(); ++j) {
+                T elem = a(i, j);
+                add(traits::template numerator<I>(elem) * x[j - 1].get_numerator(),
+                    traits::template denominator<I>(elem) * x[j - 1].get_denominator());
+            }
+            add(-traits::template numerator<I>(b[i - 1]), traits::template denominator<I>(b[i - 1]));
+            if (num != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void operator() () {
+        std::vector<std::tuple<unsigned, unsigned, int>> lap;
+        const unsigned n = 30;
+        for (unsigned i = 1; i <= n; ++i) {
+            lap.emplace_back(i, i, 2);
+            if (i < n) {
+                lap.emplace_back(i, i + 1, -1);
+                lap.emplace_back(i + 1, i, -1);
+            }
+        }
+        auto laplace = Matrix<int>::from_triplets(lap, n, n, 0.5);
+        if (exact_determinant(laplace) != n + 1 || exact_rank(laplace) != n) {
+            throw test_failed_error("laplace determinant test failed");
+        }
+        auto perm = Matrix<int>({{1, {{2, 3}}}, {2, {{3, 5}}}, {3, {{1, 7}}}}, 3, 3, 0.5);
+        if (exact_determinant(perm) != 105 || exact_determinant(-perm) != -105) {
+            throw test_failed_error("permutation determinant test failed");
+        }
+        // матрица Гильберта 6 x 6: det = 1 / 186313420339200000
+        Matrix<RationalNumber<int>> hilbert(6, 6, 0);
+        for (int i = 1; i <= 6; ++i) {
+            for (int j = 1; j <= 6; ++j) {
+                hilbert[std::make_pair(i, j)] = RationalNumber<int>(1, i + j - 1);
+            }
+        }
+        auto hdet = exact_determinant<__int128>(hilbert);
+        if (hdet.get_numerator() != 1 || hdet.get_denominator() != __int128(186313420339200000ll)) {
+            throw test_failed_error("hilbert determinant test failed");
+        }
+        // 12 x 12: знаменатель не помещается в __int128
+        Matrix<RationalNumber<int>> hilbert12(12, 12, 0);
+        for (int i = 1; i <= 12; ++i) {
+            for (int j = 1; j <= 12; ++j) {
+                hilbert12[std::make_pair(i, j)] = RationalNumber<int>(1, i + j - 1);
+            }
+        }
+        auto hdet12 = exact_determinant<BigInt>(hilbert12);
+        if (hdet12.get_numerator() != 1 ||
+            hdet12.get_denominator() != BigInt("379106579436304517151885479034796391880188687864118464104324304732160000000000"))
+        {
+            throw test_failed_error("big hilbert determinant test failed");
+        }
+        std::vector<RationalNumber<int>> hb(6, RationalNumber<int>(1));
+        auto hx = exact_solve<__int128>(hilbert, hb);
+        if (!satisfies(hilbert, hx, hb) || hx[0] != RationalNumber<__int128>(-6)) {
+            throw test_failed_error("hilbert solve test failed");
+        }
+        auto dep = Matrix<int>({
+            {1, {{1, 1}, {2, 2}, {4, 3}}},
+            {2, {{2, 1}, {3, 4}}},
+            {3, {{1, 1}, {2, 3}, {3, 4}, {4, 3}}},
+            {4, {{5, 2}}},
+        }, 4, 5, 0.5);
+        if (exact_rank(dep) != 3 || exact_rank(~dep) != 3) {
+            throw test_failed_error("rank test failed");
+        }
+        auto sys = Matrix<int>({{1, {{1, 2}, {2, 1}}}, {2, {{1, 1}, {3, 3}}}, {3, {{2, 4}, {3, 1}}}}, 3, 3, 0.5);
+        std::vector<int> b = {1, 2, 3};
+        auto x = exact_solve(sys, b);
+        if (!satisfies(sys, x, b)) {
+            throw test_failed_error("solve test failed");
+        }
+        bool thrown = false;
+        try {
+            exact_solve(Matrix<int>({{1, {{1, 1}, {2, 2}}}, {2, {{1, 2}, {2, 4}}}}, 2, 2, 0.5), std::vector<int>{1, 1});
+        } catch (singular_matrix_error& ex) {
+            thrown = ex.rank == 1;
+        }
+        if (!thrown) {
+            throw test_failed_error("singular solve test failed");
+        }
+        thrown = false;
+        try {
+            exact_solve(Matrix<int>(2, 2, 0.5), std::vector<int>{1, 1});
+        } catch (std::runtime_error& ex) {
+            thrown = true;
+        }
+        if (!thrown) {
+            throw test_failed_error("singular solve base class test failed");
+        }
+        thrown = false;
+        try {
+            exact_solve(sys, std::vector<int>{1, 2});
+        } catch (std::runtime_error& ex) {
+            thrown = dynamic_cast<vector_size_error*>(&ex) != nullptr;
+        }
+        if (!thrown) {
+            throw test_failed_error("solve size base class test failed");
+        }
+        {
+            // вырожденная матрица: произведение масштабов строк переполнило бы long long
+            const int p = 46337;
+            const int q = 46349;
+            Matrix<RationalNumber<int>> sing({
+                {1, {{1, RationalNumber<int>(1, p)}, {2, RationalNumber<int>(1, q)}}},
+                {2, {{1, RationalNumber<int>(2, p)}, {2, RationalNumber<int>(2, q)}}},
+                {3, {{3, RationalNumber<int>(1, p)}}},
+            }, 3, 3, 0);
+            if (exact_determinant(sing).get_numerator() != 0) {
+                throw test_failed_error("singular rational determinant test failed");
+            }
+        }
+        auto big = Matrix<int>({{1, {{1, 100000}, {2, 1}}}, {2, {{1, 1}, {2, 100000}}}}, 2, 2, 0.5);
+        thrown = false;
+        try {
+            exact_determinant<int>(big);
+        } catch (exact_overflow_error&) {
+            thrown = true;
+        }
+        if (!thrown || exact_determinant(big) != 9999999999ll) {
+            throw test_failed_error("overflow determinant test failed");
+        }
+        {
+            // стрела: плотные первая строка и столбец; естественный порядок
+            // заполняет всю матрицу, выбор по Марковицу - нет
+            const unsigned m = 60;
+            std::vector<typename Bareiss_elimination<long long>::row_type> rows(m);
+            for (unsigned i = 0; i < m; ++i) {
+                if (i == 0) {
+                    for (unsigned j = 0; j < m; ++j) {
+                        rows[0].emplace_back(j, j == 0 ? 2 * m : 1);
+                    }
+                } else {
+                    rows[i] = {{0, 1}, {i, 1}};
+                }
+            }
+            Bareiss_elimination<long long> natural(rows, m, m, false);
+            Bareiss_elimination<long long> markowitz(rows, m, m);
+            if (natural.last_pivot() * natural.sign() != markowitz.last_pivot() * markowitz.sign() ||
+                markowitz.peak_nnz() > 3 * m || natural.peak_nnz() < m * m / 2)
+            {
+                throw test_failed_error("markowitz fill test failed");
+            }
+        }
+        std::cout << "exact tests completed" << std::endl;
+    }
+};
@@ -0,0 +1,364 @@
+#pragma once
+
+#include "storage.h"
+#include <cmath>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+template <typename T, template <class...> class M>
+class Matrix;
+
+/**
+    \brief Ленивое выражение над матрицами
+
+    Базовый класс (CRTP) узлов дерева выражения, которое строят операторы
+    +, - и умножение на число. Выражение вычисляется при присваивании в
+    Matrix (или вызове eval()) за один проход по ненулевым элементам всех
+    операндов: курсоры операндов сливаются по (строка, столбец), и каждый
+    элемент результата сразу добавляется в контейнер.
+
+    Операнды-lvalue хранятся по ссылке, временные матрицы - по значению,
+    поэтому выражение, сохраненное в переменную, не должно переживать
+    матрицы, на которые ссылается.
+*/
+template <class E>
+class Matrix_expr {
+public:
+    /// Узел выражения
+    const E& self() const {
+        return static_cast<const E&>(*this);
+    }
+
+    /// Вычисление выражения в матрицу
+    auto eval() const {
+        return typename E::matrix_type(self());
+    }
+
+    unsigned get_rows_num() const { return self().rows_num(); }
+    unsigned get_cols_num() const { return self().cols_num(); }
+    double get_eps() const { return self().eps(); }
+
+    /// Значение элемента (без вычисления всего выражения)
+    auto operator() (unsigned row_num, unsigned col_num) const {
+        return self().value(row_num, col_num);
+    }
+
+    /// Оператор превращения выражения в строку
+    std::string to_file_string() const {
+        return eval().to_file_string();
+    }
+
+    /// Запись результата в поток в текстовом формате
+    void write_to(std::ostream& out) const {
+        eval().write_to(out);
+    }
+};
+
+/**
+    \brief Лист выражения - матрица
+
+    При Owned = true матрица хранится по значению (временный операнд),
+    иначе по ссылке.
+*/
+template <class Mat, bool Owned>
+class Matrix_leaf : public Matrix_expr<Matrix_leaf<Mat, Owned>> {
+public:
+    using matrix_type = Mat;
+    using value_type = typename Mat::value_type;
+    /// Можно ли вычислять слиянием (контейнер упорядочен)
+    static constexpr bool ordered = is_ordered_storage<typename Mat::storage_type>::value;
+
+    /// Курсор по ненулевым элементам в порядке (строка, столбец)
+    class cursor {
+    public:
+        using map_type = typename Mat::storage_type;
+        using row_iterator = decltype(std::declval<const map_type&>().begin());
+        using elem_iterator = decltype(std::declval<row_iterator&>()->second.begin());
+
+        explicit cursor(const map_type& map) : rit_(map.begin()), rend_(map.end()) {
+            enter_row();
+        }
+
+        /// Переход к следующему элементу
+        void advance() {
+            ++*eit_;
+            if (*eit_ == *eend_) {
+                ++rit_;
+                enter_row();
+            } else {
+                load();
+            }
+        }
+
+        bool valid = false;
+        unsigned row = 0;
+        unsigned col = 0;
+        value_type value{};
+
+    private:
+        /// Поиск первой непустой строки, начиная с текущей
+        void enter_row() {
+            for (; rit_ != rend_; ++rit_) {
+                eit_.emplace(rit_->second.begin());
+                eend_.emplace(rit_->second.end());
+                if (*eit_ != *eend_) {
+                    load();
+                    return;
+                }
+            }
+            valid = false;
+        }
+
+        void load() {
+            const auto& elem = **eit_;
+            valid = true;
+            row = rit_->first;
+            col = elem.first;
+            value = elem.second;
+        }
+
+        row_iterator rit_;
+        row_iterator rend_;
+        std::optional<elem_iterator> eit_;
+        std::optional<elem_iterator> eend_;
+    };
+
+    explicit Matrix_leaf(const Mat& matrix) : matrix_(matrix) {}
+
+    template <bool O = Owned, class = std::enable_if_t<O>>
+    explicit Matrix_leaf(Mat&& matrix) : matrix_(std::move(matrix)) {}
+
+    unsigned rows_num() const { return matrix_.get_rows_num(); }
+    unsigned cols_num() const { return matrix_.get_cols_num(); }
+    double eps() const { return matrix_.get_eps(); }
+
+    value_type value(unsigned row_num, unsigned col_num) const {
+        return matrix_(row_num, col_num);
+    }
+
+    cursor make_cursor() const {
+        return cursor(matrix_.get_map());
+    }
+
+    /// Вычисление по операциям над матрицами (для неупорядоченных контейнеров)
+    Mat materialize() const {
+        return matrix_;
+    }
+
+private:
+    std::conditional_t<Owned, Mat, const Mat&> matrix_;
+};
+
+/// Сумма (Minus = false) или разность (Minus = true) двух выражений
+template <class L, class R, bool Minus>
+class Matrix_sum : public Matrix_expr<Matrix_sum<L, R, Minus>> {
+public:
+    using matrix_type = typename L::matrix_type;
+    using value_type = typename L::value_type;
+    static constexpr bool ordered = L::ordered && R::ordered;
+
+    /**
+        \brief Курсор: слияние курсоров операндов
+
+        Суммы меньше eps пропускаются, как при сложении матриц: такого
+        элемента нет и в промежуточном результате.
+    */
+    class cursor {
+    public:
+        cursor(typename L::cursor l, typename R::cursor r, double eps) :
+            l_(std::move(l)), r_(std::move(r)), eps_(eps)
+        {
+            settle();
+        }
+
+        void advance() {
+            step();
+            settle();
+        }
+
+        bool valid = false;
+        unsigned row = 0;
+        unsigned col = 0;
+        value_type value{};
+
+    private:
+        /// Сдвиг курсоров операндов, давших текущую позицию
+        void step() {
+            if (take_l_) {
+                l_.advance();
+            }
+            if (take_r_) {
+                r_.advance();
+            }
+        }
+
+        /// Выбор наименьшей позиции с суммой не меньше eps и подсчет значения в ней
+        void settle() {
+            using std::abs;
+            while (true) {
+                valid = l_.valid || r_.valid;
+                if (!valid) {
+                    return;
+                }
+                take_l_ = l_.valid && (!r_.valid || l_.row < r_.row || (l_.row == r_.row && l_.col <= r_.col));
+                take_r_ = r_.valid && (!l_.valid || r_.row < l_.row || (r_.row == l_.row && r_.col <= l_.col));
+                row = take_l_ ? l_.row : r_.row;
+                col = take_l_ ? l_.col : r_.col;
+                value = take_l_ ? value_type(l_.value) : value_type(0);
+                if (take_r_) {
+                    if (Minus) {
+                        value -= r_.value;
+                    } else {
+                        value += r_.value;
+                    }
+                }
+                if (!(abs(value) < eps_)) {
+                    return;
+                }
+                step();
+            }
+        }
+
+        typename L::cursor l_;
+        typename R::cursor r_;
+        double eps_;
+        bool take_l_ = false;
+        bool take_r_ = false;
+    };
+
+    Matrix_sum(L l, R r) : l_(std::move(l)), r_(std::move(r)) {}
+
+    unsigned rows_num() const { return l_.rows_num(); }
+    unsigned cols_num() const { return l_.cols_num(); }
+    double eps() const { return l_.eps(); }
+
+    value_type value(unsigned row_num, unsigned col_num) const {
+        using std::abs;
+        value_type res = l_.value(row_num, col_num);
+        if (Minus) {
+            res -= r_.value(row_num, col_num);
+        } else {
+            res += r_.value(row_num, col_num);
+        }
+        return abs(res) < eps() ? value_type(0) : res;
+    }
+
+    cursor make_cursor() const {
+        return cursor(l_.make_cursor(), r_.make_cursor(), eps());
+    }
+
+    matrix_type materialize() const {
+        auto res = l_.materialize();
+        if (Minus) {
+            res -= r_.materialize();
+        } else {
+            res += r_.materialize();
+        }
+        return res;
+    }
+
+private:
+    L l_;
+    R r_;
+};
+
+/// Выражение, умноженное на число
+template <class E>
+class Matrix_scaled : public Matrix_expr<Matrix_scaled<E>> {
+public:
+    using matrix_type = typename E::matrix_type;
+    using value_type = typename E::value_type;
+    static constexpr bool ordered = E::ordered;
+
+    /// Курсор: элементы операнда, умноженные на число (произведения меньше eps пропускаются)
+    class cursor {
+    public:
+        cursor(typename E::cursor e, double k, double eps) : e_(std::move(e)), k_(k), eps_(eps) {
+            settle();
+        }
+
+        void advance() {
+            e_.advance();
+            settle();
+        }
+
+        bool valid = false;
+        unsigned row = 0;
+        unsigned col = 0;
+        value_type value{};
+
+    private:
+        void settle() {
+            using std::abs;
+            for (; e_.valid; e_.advance()) {
+                value = e_.value;
+                value *= k_;
+                if (!(abs(value) < eps_)) {
+                    valid = true;
+                    row = e_.row;
+                    col = e_.col;
+                    return;
+                }
+            }
+            valid = false;
+        }
+
+        typename E::cursor e_;
+        double k_;
+        double eps_;
+    };
+
+    Matrix_scaled(E e, double k) : e_(std::move(e)), k_(k) {}
+
+    unsigned rows_num() const { return e_.rows_num(); }
+    unsigned cols_num() const { return e_.cols_num(); }
+    double eps() const { return e_.eps(); }
+
+    value_type value(unsigned row_num, unsigned col_num) const {
+        using std::abs;
+        value_type res = e_.value(row_num, col_num);
+        res *= k_;
+        return abs(res) < eps() ? value_type(0) : res;
+    }
+
+    cursor make_cursor() const {
+        return cursor(e_.make_cursor(), k_, eps());
+    }
+
+    matrix_type materialize() const {
+        auto res = e_.materialize();
+        res *= k_;
+        return res;
+    }
+
+private:
+    E e_;
+    double k_;
+};
+
+/// Проверка, что тип - матрица
+template <class X>
+struct is_matrix : std::false_type {};
+
+template <class T, template <class...> class M>
+struct is_matrix<Matrix<T, M>> : std::true_type {};
+
+/// Проверка, что тип - операнд выражения (матрица или выражение)
+template <class X, class D = std::decay_t<X>>
+inline constexpr bool is_matrix_operand_v = is_matrix<D>::value || std::is_base_of_v<Matrix_expr<D>, D>;
+
+/// Узел выражения для операнда: lvalue-матрица - по ссылке, временная - по значению
+template <class X>
+auto make_matrix_operand(X&& x) {
+    using D = std::decay_t<X>;
+    if constexpr (!is_matrix<D>::value) {
+        return D(std::forward<X>(x));
+    } else if constexpr (std::is_lvalue_reference_v<X>) {
+        return Matrix_leaf<D, false>(x);
+    } else {
+        return Matrix_leaf<D, true>(std::move(x));
+    }
+}
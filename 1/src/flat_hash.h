@@ -0,0 +1,492 @@
+#pragma once
+
+#include "storage.h"
+#include "csr.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+    \brief Исключение зарезервированного индекса
+
+    Данное исключение возникает при попытке добавить в хеш-контейнер
+    элемент (UINT_MAX, UINT_MAX): его упакованный ключ обозначает пустую
+    ячейку таблицы.
+*/
+class reserved_index_error : public std::runtime_error {
+public:
+    reserved_index_error(std::string what, unsigned row_num, unsigned col_num) :
+        std::runtime_error(what), row_num(row_num), col_num(col_num) {}
+    unsigned row_num;
+    unsigned col_num;
+};
+
+/**
+    \brief Строка хеш-контейнера при задании списком инициализации
+
+    Совпадает с плоским упорядоченным словарем csr_map.
+*/
+template <class K, class V>
+class flat_hash_map : public csr_map<K, V> {
+public:
+    using csr_map<K, V>::csr_map;
+};
+
+/**
+    \brief Хеш-контейнер элементов матрицы с открытой адресацией
+
+    Специализация для M<unsigned, M<unsigned, T>>: все элементы лежат в
+    одном массиве ячеек, ключ ячейки - упакованная пара (строка, столбец).
+    Коллизии разрешаются линейным пробированием, удаление сдвигает
+    следующие ячейки назад (без пометок удаления), так что доступ к
+    элементу по (строка, столбец) - одна серия соседних чтений.
+
+    Элементы одной строки связаны в двусвязный список через номера ячеек,
+    что дает обход строки без просмотра всей таблицы. Начала списков
+    хранятся в хеш-таблице непустых строк, поэтому память и обход строк
+    зависят от nnz, а не от наибольшего номера строки. Строки обходятся в
+    порядке хеш-таблицы, элементы строки - в порядке добавления, поэтому
+    контейнер считается неупорядоченным. Вставка может перестроить таблицу
+    и сделать недействительными ссылки на элементы.
+*/
+template <class T>
+class flat_hash_map<unsigned, flat_hash_map<unsigned, T>> {
+    /// Номер ячейки "нет ячейки"
+    static constexpr std::uint32_t npos = ~std::uint32_t(0);
+    /// Ключ пустой ячейки (совпадает с pack(UINT_MAX, UINT_MAX), такой элемент не добавляется)
+    static constexpr std::uint64_t empty_key = ~std::uint64_t(0);
+
+    struct slot {
+        std::uint64_t key = empty_key;
+        std::uint32_t prev = npos;
+        std::uint32_t next = npos;
+        T value{};
+    };
+
+    /// Список элементов строки
+    struct row_list {
+        std::uint32_t head = npos;
+        std::uint32_t tail = npos;
+        std::uint32_t size = 0;
+    };
+
+    /// Таблица списков непустых строк
+    using row_table = std::unordered_map<unsigned, row_list>;
+
+public:
+    using key_type = unsigned;
+    using mapped_type = flat_hash_map<unsigned, T>;
+
+    /// Итератор по элементам строки
+    template <bool Const>
+    class basic_elem_iterator {
+    public:
+        using parent_type = std::conditional_t<Const, const flat_hash_map, flat_hash_map>;
+        using value_ref = std::conditional_t<Const, const T, T>;
+        using value_type = storage_entry<unsigned, value_ref>;
+        using reference = value_type&;
+        using pointer = value_type*;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        basic_elem_iterator(parent_type* parent, std::uint32_t pos) :
+            parent_(parent), pos_(pos) {}
+
+        basic_elem_iterator(const basic_elem_iterator& other) :
+            parent_(other.parent_), pos_(other.pos_) {}
+
+        basic_elem_iterator& operator= (const basic_elem_iterator& other) {
+            parent_ = other.parent_;
+            pos_ = other.pos_;
+            current_.reset();
+            return *this;
+        }
+
+        reference operator* () const {
+            auto& cell = parent_->slots_[pos_];
+            current_.emplace(value_type{unsigned(cell.key), cell.value});
+            return *current_;
+        }
+
+        pointer operator-> () const {
+            return &operator*();
+        }
+
+        basic_elem_iterator& operator++ () {
+            pos_ = parent_->slots_[pos_].next;
+            return *this;
+        }
+
+        basic_elem_iterator operator++ (int) {
+            auto old = *this;
+            operator++();
+            return old;
+        }
+
+        bool operator== (const basic_elem_iterator& other) const { return pos_ == other.pos_; }
+        bool operator!= (const basic_elem_iterator& other) const { return pos_ != other.pos_; }
+
+    private:
+        parent_type* parent_;
+        std::uint32_t pos_;
+        mutable std::optional<value_type> current_;
+    };
+
+    /// Представление одной строки
+    template <bool Const>
+    class basic_row {
+    public:
+        using parent_type = std::conditional_t<Const, const flat_hash_map, flat_hash_map>;
+        using iterator = basic_elem_iterator<Const>;
+
+        basic_row(parent_type* parent, unsigned row_num) :
+            parent_(parent), row_num_(row_num) {}
+
+        iterator begin() const {
+            auto row = parent_->row_of(row_num_);
+            return iterator(parent_, row ? row->head : npos);
+        }
+
+        iterator end() const { return iterator(parent_, npos); }
+
+        /// Метод поиска элемента
+        iterator find(unsigned col_num) const {
+            return iterator(parent_, parent_->find_slot(pack(row_num_, col_num)));
+        }
+
+        /// Оператор доступа к элементу (с созданием при отсутствии)
+        template <bool C = Const, class = std::enable_if_t<!C>>
+        T& operator[] (unsigned col_num) const {
+            return parent_->slots_[parent_->insert(row_num_, col_num)].value;
+        }
+
+        /// Метод удаления элемента строки
+        template <bool C = Const, class = std::enable_if_t<!C>>
+        std::size_t erase(unsigned col_num) const {
+            auto pos = parent_->find_slot(pack(row_num_, col_num));
+            if (pos == npos) {
+                return 0;
+            }
+            parent_->erase_slot(pos);
+            return 1;
+        }
+
+        /// Замена содержимого строки
+        template <bool C = Const, class = std::enable_if_t<!C>>
+        basic_row& operator= (std::initializer_list<std::pair<const unsigned, T>> init) {
+            parent_->erase(row_num_);
+            for (const auto& [col_num, value] : init) {
+                operator[](col_num) = value;
+            }
+            return *this;
+        }
+
+        bool empty() const { return size() == 0; }
+
+        std::size_t size() const {
+            auto row = parent_->row_of(row_num_);
+            return row ? row->size : 0;
+        }
+
+    private:
+        parent_type* parent_;
+        unsigned row_num_;
+    };
+
+    using row_ref = basic_row<false>;
+    using const_row_ref = basic_row<true>;
+
+    /// Итератор по непустым строкам
+    template <bool Const>
+    class basic_iterator {
+    public:
+        using parent_type = std::conditional_t<Const, const flat_hash_map, flat_hash_map>;
+        using rows_iterator = std::conditional_t<Const,
+            typename row_table::const_iterator, typename row_table::iterator>;
+        using value_type = std::pair<unsigned, basic_row<Const>>;
+        using reference = value_type&;
+        using pointer = value_type*;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        basic_iterator(parent_type* parent, rows_iterator it) :
+            parent_(parent), it_(it), current_(0, basic_row<Const>(parent, 0)) {}
+
+        reference operator* () const {
+            current_ = value_type(it_->first, basic_row<Const>(parent_, it_->first));
+            return current_;
+        }
+
+        pointer operator-> () const {
+            return &operator*();
+        }
+
+        basic_iterator& operator++ () {
+            ++it_;
+            return *this;
+        }
+
+        basic_iterator operator++ (int) {
+            auto old = *this;
+            operator++();
+            return old;
+        }
+
+        bool operator== (const basic_iterator& other) const { return it_ == other.it_; }
+        bool operator!= (const basic_iterator& other) const { return it_ != other.it_; }
+
+    private:
+        parent_type* parent_;
+        rows_iterator it_;
+        mutable value_type current_;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    /// Конструктор по умолчанию
+    flat_hash_map() = default;
+
+    /// Конструктор по списку строк (при повторе строки остается первая)
+    flat_hash_map(std::initializer_list<std::pair<const unsigned, flat_hash_map<unsigned, T>>> init) {
+        for (const auto& [row_num, row] : init) {
+            if (find(row_num) != end()) {
+                continue;
+            }
+            for (const auto& [col_num, value] : row) {
+                slots_[insert(row_num, col_num)].value = value;
+            }
+        }
+    }
+
+    iterator begin() { return iterator(this, rows_.begin()); }
+    iterator end() { return iterator(this, rows_.end()); }
+    const_iterator begin() const { return const_iterator(this, rows_.begin()); }
+    const_iterator end() const { return const_iterator(this, rows_.end()); }
+
+    /// Метод поиска непустой строки
+    iterator find(unsigned row_num) {
+        return iterator(this, rows_.find(row_num));
+    }
+
+    /// Метод поиска непустой строки
+    const_iterator find(unsigned row_num) const {
+        return const_iterator(this, rows_.find(row_num));
+    }
+
+    /// Оператор доступа к строке
+    row_ref operator[] (unsigned row_num) {
+        return row_ref(this, row_num);
+    }
+
+    /// Метод удаления всех элементов строки
+    std::size_t erase(unsigned row_num) {
+        // последний удаленный элемент убирает строку из таблицы строк
+        std::size_t count = 0;
+        for (auto row = row_of(row_num); row; row = row_of(row_num)) {
+            erase_slot(row->head);
+            count = 1;
+        }
+        return count;
+    }
+
+    /// Метод удаления элементов по условию
+    template <class Pred>
+    void erase_if(Pred pred) {
+        // удаление сдвигает ячейки, поэтому сначала собираются ключи
+        std::vector<std::uint64_t> keys;
+        for (const auto& cell : slots_) {
+            if (cell.key != empty_key && pred(cell.value)) {
+                keys.push_back(cell.key);
+            }
+        }
+        for (auto key : keys) {
+            erase_slot(find_slot(key));
+        }
+    }
+
+    /// Метод резервирования места под nnz элементов без перестроения
+    void reserve(std::size_t nnz) {
+        std::size_t capacity = min_capacity;
+        while (nnz * 4 > capacity * 3) {
+            capacity *= 2;
+        }
+        if (capacity > slots_.size()) {
+            rehash(capacity);
+        }
+    }
+
+    bool empty() const { return size_ == 0; }
+    void clear() { slots_.clear(); rows_.clear(); size_ = 0; shift_ = 64; }
+
+    /// Метод получения количества хранимых элементов
+    std::size_t nnz() const { return size_; }
+
+    /// Метод получения количества ячеек таблицы
+    std::size_t capacity() const { return slots_.size(); }
+
+private:
+    /// Наименьший размер таблицы
+    static constexpr std::size_t min_capacity = 16;
+
+    static std::uint64_t pack(unsigned row_num, unsigned col_num) {
+        return (std::uint64_t(row_num) << 32) | col_num;
+    }
+
+    /// Начальная ячейка ключа (мультипликативное хеширование Фибоначчи)
+    std::size_t bucket(std::uint64_t key) const {
+        return (key * 0x9E3779B97F4A7C15ull) >> shift_;
+    }
+
+    /// Ячейка с ключом или первая пустая ячейка серии
+    std::size_t probe(std::uint64_t key) const {
+        auto mask = slots_.size() - 1;
+        auto pos = bucket(key);
+        while (slots_[pos].key != key && slots_[pos].key != empty_key) {
+            pos = (pos + 1) & mask;
+        }
+        return pos;
+    }
+
+    std::uint32_t find_slot(std::uint64_t key) const {
+        if (slots_.empty() || key == empty_key) {
+            return npos;
+        }
+        auto pos = probe(key);
+        return slots_[pos].key == key ? pos : npos;
+    }
+
+    /// Список элементов непустой строки (nullptr для пустой строки)
+    const row_list* row_of(unsigned row_num) const {
+        auto it = rows_.find(row_num);
+        return it != rows_.end() ? &it->second : nullptr;
+    }
+
+    /// Поиск или создание элемента, возвращает номер ячейки
+    std::uint32_t insert(unsigned row_num, unsigned col_num) {
+        auto key = pack(row_num, col_num);
+        if (key == empty_key) {
+            throw reserved_index_error("index is reserved for empty cells", row_num, col_num);
+        }
+        if ((size_ + 1) * 4 > slots_.size() * 3) {
+            if (auto pos = find_slot(key); pos != npos) {
+                return pos;
+            }
+            rehash(std::max(min_capacity, 2 * slots_.size()));
+        }
+        auto pos = probe(key);
+        if (slots_[pos].key == key) {
+            return pos;
+        }
+        slots_[pos].key = key;
+        slots_[pos].value = T{};
+        link_back(row_num, pos);
+        ++size_;
+        return pos;
+    }
+
+    /// Добавление ячейки в конец списка строки
+    void link_back(unsigned row_num, std::uint32_t pos) {
+        auto& row = rows_[row_num];
+        slots_[pos].prev = row.tail;
+        slots_[pos].next = npos;
+        if (row.tail != npos) {
+            slots_[row.tail].next = pos;
+        } else {
+            row.head = pos;
+        }
+        row.tail = pos;
+        ++row.size;
+    }
+
+    /// Исключение ячейки из списка строки (опустевшая строка удаляется из таблицы строк)
+    void unlink(std::uint32_t pos) {
+        auto& cell = slots_[pos];
+        auto row_it = rows_.find(unsigned(cell.key >> 32));
+        auto& row = row_it->second;
+        (cell.prev != npos ? slots_[cell.prev].next : row.head) = cell.next;
+        (cell.next != npos ? slots_[cell.next].prev : row.tail) = cell.prev;
+        if (--row.size == 0) {
+            rows_.erase(row_it);
+        }
+    }
+
+    /// Перенос элемента в другую ячейку с исправлением ссылок списка строки
+    void move_slot(std::uint32_t from, std::uint32_t to) {
+        auto& cell = slots_[to];
+        cell = std::move(slots_[from]);
+        auto& row = rows_.find(unsigned(cell.key >> 32))->second;
+        (cell.prev != npos ? slots_[cell.prev].next : row.head) = to;
+        (cell.next != npos ? slots_[cell.next].prev : row.tail) = to;
+    }
+
+    /**
+        \brief Удаление элемента из ячейки
+
+        Следующие ячейки серии сдвигаются на место дыры, если дыра лежит
+        между их начальной ячейкой и текущим положением.
+    */
+    void erase_slot(std::uint32_t pos) {
+        unlink(pos);
+        --size_;
+        auto mask = slots_.size() - 1;
+        std::size_t hole = pos;
+        for (auto next = (hole + 1) & mask; slots_[next].key != empty_key; next = (next + 1) & mask) {
+            auto home = bucket(slots_[next].key);
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                move_slot(next, hole);
+                hole = next;
+            }
+        }
+        slots_[hole] = slot{};
+    }
+
+    /// Перестроение таблицы заданного размера (степень двойки)
+    void rehash(std::size_t capacity) {
+        auto old = std::move(slots_);
+        slots_.assign(capacity, slot{});
+        shift_ = 64;
+        for (auto c = capacity; c > 1; c /= 2) {
+            --shift_;
+        }
+        // порядок элементов в строках сохраняется
+        for (auto& [row_num, row] : rows_) {
+            auto pos = row.head;
+            row = row_list{};
+            while (pos != npos) {
+                auto& cell = old[pos];
+                auto dst = probe(cell.key);
+                slots_[dst].key = cell.key;
+                slots_[dst].value = std::move(cell.value);
+                link_back(row_num, dst);
+                pos = cell.next;
+            }
+        }
+    }
+
+    /// Ячейки таблицы (размер - степень двойки или 0)
+    std::vector<slot> slots_;
+    /// Списки элементов непустых строк по номерам строк
+    row_table rows_;
+    /// Количество элементов
+    std::size_t size_ = 0;
+    /// Сдвиг хеша: 64 - log2(размер таблицы)
+    unsigned shift_ = 64;
+};
+
+/// Хеш-контейнер не упорядочен внутри строк
+template <class T>
+struct is_ordered_storage<flat_hash_map<unsigned, flat_hash_map<unsigned, T>>> : std::false_type {};
+
+/// Удаление элементов хеш-контейнера по условию
+template <class T, class Pred>
+void storage_erase_if(flat_hash_map<unsigned, flat_hash_map<unsigned, T>>& map, Pred pred) {
+    map.erase_if(pred);
+}
@@ -0,0 +1,595 @@
+#pragma once
+
+#include "storage.h"
+#include "csr.h"
+#include "dense.h"
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <optional>
+#include <variant>
+
+/**
+    \brief Пороги переключения гибридного хранения
+
+    При заполненности nnz / (rows * cols) больше to_dense разреженное
+    представление заменяется плотным, при заполненности меньше to_sparse -
+    обратно. Разница порогов не дает матрице переключаться туда и обратно
+    на каждой операции. Матрицы меньше min_cells ячеек не переключаются.
+*/
+struct hybrid_thresholds {
+    double to_dense = 0.3;
+    double to_sparse = 0.1;
+    std::size_t min_cells = 1024;
+};
+
+/// Статистика переключений гибридного хранения
+struct hybrid_stats {
+    /// Количество проверок заполненности
+    unsigned long long checks = 0;
+    /// Количество переходов в плотное представление
+    unsigned long long to_dense = 0;
+    /// Количество переходов в разреженное представление
+    unsigned long long to_sparse = 0;
+    /// Количество перенесенных при переходах ненулевых элементов
+    unsigned long long moved_elements = 0;
+};
+
+/**
+    \brief Пороги гибридного хранения по умолчанию
+
+    Новый гибридный контейнер берет пороги отсюда; дальше они задаются для
+    каждого контейнера отдельно (hybrid_map::set_thresholds). Пороги
+    хранятся в атомарных переменных, поэтому создание контейнера не
+    блокируется.
+*/
+class hybrid_config {
+public:
+    /// Метод получения порогов по умолчанию
+    static hybrid_thresholds default_thresholds() {
+        hybrid_thresholds th;
+        th.to_dense = defaults().to_dense.load(std::memory_order_relaxed);
+        th.to_sparse = defaults().to_sparse.load(std::memory_order_relaxed);
+        th.min_cells = defaults().min_cells.load(std::memory_order_relaxed);
+        return th;
+    }
+
+    /// Метод задания порогов по умолчанию (действует на контейнеры, созданные после вызова)
+    static void set_default_thresholds(const hybrid_thresholds& th) {
+        defaults().to_dense.store(th.to_dense, std::memory_order_relaxed);
+        defaults().to_sparse.store(th.to_sparse, std::memory_order_relaxed);
+        defaults().min_cells.store(th.min_cells, std::memory_order_relaxed);
+    }
+
+private:
+    struct atomic_thresholds {
+        std::atomic<double> to_dense{hybrid_thresholds().to_dense};
+        std::atomic<double> to_sparse{hybrid_thresholds().to_sparse};
+        std::atomic<std::size_t> min_cells{hybrid_thresholds().min_cells};
+    };
+
+    static atomic_thresholds& defaults() {
+        static atomic_thresholds th;
+        return th;
+    }
+};
+
+/**
+    \brief Строка гибридной матрицы при задании списком инициализации
+
+    Совпадает с плоским упорядоченным словарем csr_map.
+*/
+template <class K, class V>
+class hybrid_map : public csr_map<K, V> {
+public:
+    using csr_map<K, V>::csr_map;
+};
+
+/**
+    \brief Гибридный контейнер элементов матрицы
+
+    Хранит элементы либо в CSR (csr_map), либо плотно (dense_map) и после
+    массовых операций (storage_adapt) выбирает представление по
+    заполненности и порогам контейнера. Интерфейс вложенного словаря
+    передается текущему представлению.
+
+    Пороги и статистика переключений принадлежат контейнеру, а не
+    содержимому: при копировании и перемещении контейнера пороги
+    переносятся (статистика копии начинается с нуля), а присваивание
+    заменяет только содержимое. Поэтому матрица сохраняет свои настройки,
+    когда операции заменяют ее контейнер результатом.
+*/
+template <class T>
+class hybrid_map<unsigned, hybrid_map<unsigned, T>> {
+public:
+    using key_type = unsigned;
+    using mapped_type = hybrid_map<unsigned, T>;
+    using sparse_type = csr_map<unsigned, csr_map<unsigned, T>>;
+    using dense_type = dense_map<unsigned, dense_map<unsigned, T>>;
+
+    /// Итератор по элементам строки
+    template <bool Const>
+    class basic_elem_iterator {
+    public:
+        using sparse_iterator = typename sparse_type::template basic_elem_iterator<Const>;
+        using dense_iterator = typename dense_type::template basic_elem_iterator<Const>;
+        using value_type = typename sparse_iterator::value_type;
+        using reference = value_type&;
+        using pointer = value_type*;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        template <class It>
+        basic_elem_iterator(It it) : it_(it) {}
+
+        reference operator* () const {
+            return std::visit([](const auto& it) -> reference { return *it; }, it_);
+        }
+
+        pointer operator-> () const {
+            return &operator*();
+        }
+
+        basic_elem_iterator& operator++ () {
+            std::visit([](auto& it) { ++it; }, it_);
+            return *this;
+        }
+
+        basic_elem_iterator operator++ (int) {
+            auto old = *this;
+            operator++();
+            return old;
+        }
+
+        bool operator== (const basic_elem_iterator& other) const { return it_ == other.it_; }
+        bool operator!= (const basic_elem_iterator& other) const { return !(it_ == other.it_); }
+
+    private:
+        std::variant<sparse_iterator, dense_iterator> it_;
+    };
+
+    /// Представление одной строки
+    template <bool Const>
+    class basic_row {
+    public:
+        using sparse_row = typename sparse_type::template basic_row<Const>;
+        using dense_row = typename dense_type::template basic_row<Const>;
+        using iterator = basic_elem_iterator<Const>;
+
+        template <class Row>
+        basic_row(Row row) : row_(row) {}
+
+        iterator begin() const { return std::visit([](const auto& r) { return iterator(r.begin()); }, row_); }
+        iterator end() const { return std::visit([](const auto& r) { return iterator(r.end()); }, row_); }
+
+        /// Метод получения первого элемента со столбцом не меньше заданного
+        iterator lower_bound(unsigned col_num) const {
+            return std::visit([&](const auto& r) { return iterator(r.lower_bound(col_num)); }, row_);
+        }
+
+        /// Метод поиска элемента
+        iterator find(unsigned col_num) const {
+            return std::visit([&](const auto& r) { return iterator(r.find(col_num)); }, row_);
+        }
+
+        /// Оператор доступа к элементу (с созданием при отсутствии)
+        template <bool C = Const, class = std::enable_if_t<!C>>
+        T& operator[] (unsigned col_num) const {
+            return std::visit([&](const auto& r) -> T& { return r[col_num]; }, row_);
+        }
+
+        /// Метод удаления элемента строки
+        template <bool C = Const, class = std::enable_if_t<!C>>
+        std::size_t erase(unsigned col_num) const {
+            return std::visit([&](const auto& r) { return r.erase(col_num); }, row_);
+        }
+
+        /// Замена содержимого строки
+        template <bool C = Const, class = std::enable_if_t<!C>>
+        basic_row& operator= (std::initializer_list<std::pair<const unsigned, T>> init) {
+            std::visit([&](auto& r) { r = init; }, row_);
+            return *this;
+        }
+
+        bool empty() const { return std::visit([](const auto& r) { return r.empty(); }, row_); }
+
+    private:
+        std::variant<sparse_row, dense_row> row_;
+    };
+
+    using row_ref = basic_row<false>;
+    using const_row_ref = basic_row<true>;
+
+    /// Итератор по строкам
+    template <bool Const>
+    class basic_iterator {
+    public:
+        using sparse_iterator = typename sparse_type::template basic_iterator<Const>;
+        using dense_iterator = typename dense_type::template basic_iterator<Const>;
+        using value_type = std::pair<unsigned, basic_row<Const>>;
+        using reference = value_type&;
+        using pointer = value_type*;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        template <class It>
+        basic_iterator(It it) : it_(it) {}
+
+        reference operator* () const {
+            std::visit([&](const auto& it) {
+                const auto& [row_num, row] = *it;
+                current_.emplace(row_num, basic_row<Const>(row));
+            }, it_);
+            return *current_;
+        }
+
+        pointer operator-> () const {
+            return &operator*();
+        }
+
+        basic_iterator& operator++ () {
+            std::visit([](auto& it) { ++it; }, it_);
+            return *this;
+        }
+
+        basic_iterator operator++ (int) {
+            auto old = *this;
+            operator++();
+            return old;
+        }
+
+        bool operator== (const basic_iterator& other) const { return it_ == other.it_; }
+        bool operator!= (const basic_iterator& other) const { return !(it_ == other.it_); }
+
+    private:
+        std::variant<sparse_iterator, dense_iterator> it_;
+        mutable std::optional<value_type> current_;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    /// Конструктор по умолчанию (разреженное представление, пороги по умолчанию)
+    hybrid_map() = default;
+
+    /// Конструктор копирования (пороги копируются, статистика - нет)
+    hybrid_map(const hybrid_map& other) :
+        rows_(other.rows_), cols_(other.cols_), is_dense_(other.is_dense_), nnz_(other.nnz_),
+        sparse_(other.sparse_), dense_(other.dense_), thresholds_(other.thresholds_) {}
+
+    /// Конструктор перемещения (вместе с порогами и статистикой)
+    hybrid_map(hybrid_map&& other) noexcept :
+        rows_(other.rows_), cols_(other.cols_), is_dense_(other.is_dense_), nnz_(other.nnz_),
+        sparse_(std::move(other.sparse_)), dense_(std::move(other.dense_)),
+        thresholds_(other.thresholds_), stats_(other.stats_)
+    {
+        other.clear_content();
+    }
+
+    /// Оператор копирования содержимого (настройки контейнера не меняются)
+    hybrid_map& operator= (const hybrid_map& other) {
+        if (this != &other) {
+            rows_ = other.rows_;
+            cols_ = other.cols_;
+            is_dense_ = other.is_dense_;
+            nnz_ = other.nnz_;
+            sparse_ = other.sparse_;
+            dense_ = other.dense_;
+        }
+        return *this;
+    }
+
+    /// Оператор перемещения содержимого (настройки контейнера не меняются)
+    hybrid_map& operator= (hybrid_map&& other) noexcept {
+        if (this != &other) {
+            rows_ = other.rows_;
+            cols_ = other.cols_;
+            is_dense_ = other.is_dense_;
+            nnz_ = other.nnz_;
+            sparse_ = std::move(other.sparse_);
+            dense_ = std::move(other.dense_);
+            other.clear_content();
+        }
+        return *this;
+    }
+
+    /// Конструктор по списку строк (разреженное представление)
+    hybrid_map(std::initializer_list<std::pair<const unsigned, hybrid_map<unsigned, T>>> init) {
+        for (const auto& [row_num, row] : init) {
+            for (const auto& [col_num, value] : row) {
+                sparse_[row_num][col_num] = value;
+            }
+        }
+    }
+
+    iterator begin() {
+        nnz_.reset();
+        return visit([](auto& m) { return iterator(m.begin()); });
+    }
+    iterator end() { return visit([](auto& m) { return iterator(m.end()); }); }
+    const_iterator begin() const { return visit([](const auto& m) { return const_iterator(m.begin()); }); }
+    const_iterator end() const { return visit([](const auto& m) { return const_iterator(m.end()); }); }
+
+    /// Метод поиска строки
+    iterator find(unsigned row_num) {
+        nnz_.reset();
+        return visit([&](auto& m) { return iterator(m.find(row_num)); });
+    }
+
+    /// Метод поиска строки
+    const_iterator find(unsigned row_num) const {
+        return visit([&](const auto& m) { return const_iterator(m.find(row_num)); });
+    }
+
+    /// Оператор доступа к строке (запись через строку сбрасывает счетчик элементов плотного представления)
+    row_ref operator[] (unsigned row_num) {
+        nnz_.reset();
+        return visit([&](auto& m) { return row_ref(m[row_num]); });
+    }
+
+    /// Метод удаления строки
+    std::size_t erase(unsigned row_num) {
+        nnz_.reset();
+        return visit([&](auto& m) { return m.erase(row_num); });
+    }
+
+    /// Метод добавления элемента в конец
+    void push_back(unsigned row_num, unsigned col_num, const T& value) {
+        if (is_dense_) {
+            if (nnz_ && !dense_.stored(row_num, col_num)) {
+                ++*nnz_;
+            }
+            dense_.set(row_num, col_num, value);
+        } else {
+            sparse_.push_back(row_num, col_num, value);
+        }
+    }
+
+    /// Метод удаления элементов по условию (плотное представление при этом пересчитывает элементы)
+    template <class Pred>
+    void erase_if(Pred pred) {
+        if (is_dense_) {
+            nnz_ = dense_.erase_if(pred);
+        } else {
+            sparse_.erase_if(pred);
+        }
+    }
+
+    /// Метод задания размеров матрицы
+    void resize(unsigned rows_num, unsigned cols_num) {
+        rows_ = rows_num;
+        cols_ = cols_num;
+        if (is_dense_) {
+            dense_.resize(rows_num, cols_num);
+        }
+    }
+
+    /**
+        \brief Метод подсчета хранимых элементов
+
+        Для плотного представления используется счетчик, который ведут
+        push_back и erase_if; полный проход нужен, только если после
+        записи через строку (operator[]) счетчик сброшен.
+    */
+    std::size_t nnz() const {
+        if (!is_dense_) {
+            return sparse_.nnz();
+        }
+        if (!nnz_) {
+            std::size_t res = 0;
+            for (const auto& [row_num, row] : dense_) {
+                for (const auto& elem : row) {
+                    (void)elem;
+                    ++res;
+                }
+            }
+            nnz_ = res;
+        }
+        return *nnz_;
+    }
+
+    /// Метод получения заполненности nnz / (rows * cols)
+    double fill_ratio() const {
+        double cells = double(rows_) * cols_;
+        return cells == 0 ? 0 : nnz() / cells;
+    }
+
+    /// Метод выбора представления по заполненности
+    void adapt() {
+        ++stats_.checks;
+        if (std::size_t(rows_) * cols_ < thresholds_.min_cells) {
+            return;
+        }
+        double fill = fill_ratio();
+        if (!is_dense_ && fill > thresholds_.to_dense) {
+            ++stats_.to_dense;
+            stats_.moved_elements += sparse_.nnz();
+            make_dense();
+        } else if (is_dense_ && fill < thresholds_.to_sparse) {
+            ++stats_.to_sparse;
+            stats_.moved_elements += nnz();
+            make_sparse();
+        }
+    }
+
+    /// Пороги переключения контейнера
+    const hybrid_thresholds& thresholds() const { return thresholds_; }
+
+    /// Метод задания порогов контейнера (действуют со следующей проверки)
+    void set_thresholds(const hybrid_thresholds& th) { thresholds_ = th; }
+
+    /// Статистика переключений контейнера
+    const hybrid_stats& stats() const { return stats_; }
+
+    /// Метод сброса статистики
+    void reset_stats() { stats_ = hybrid_stats(); }
+
+    /// Метод перехода в плотное представление
+    void make_dense() {
+        if (is_dense_) {
+            return;
+        }
+        dense_ = dense_type();
+        dense_.resize(rows_, cols_);
+        for (const auto& [row_num, row] : sparse_) {
+            for (const auto& [col_num, elem] : row) {
+                dense_.set(row_num, col_num, elem);
+            }
+        }
+        nnz_ = sparse_.nnz();
+        sparse_ = sparse_type();
+        is_dense_ = true;
+    }
+
+    /// Метод перехода в разреженное представление
+    void make_sparse() {
+        if (!is_dense_) {
+            return;
+        }
+        sparse_ = sparse_type();
+        for (const auto& [row_num, row] : dense_) {
+            for (const auto& [col_num, elem] : row) {
+                sparse_.push_back(row_num, col_num, elem);
+            }
+        }
+        dense_ = dense_type();
+        nnz_.reset();
+        is_dense_ = false;
+    }
+
+    /// Метод замены содержимого плотным представлением
+    void assign_dense(dense_type&& dense) {
+        rows_ = dense.rows();
+        cols_ = dense.cols();
+        dense_ = std::move(dense);
+        sparse_ = sparse_type();
+        nnz_.reset();
+        is_dense_ = true;
+    }
+
+    /// Метод транспонирования
+    hybrid_map transposed() const {
+        hybrid_map res;
+        res.rows_ = cols_;
+        res.cols_ = rows_;
+        if (is_dense_) {
+            res.is_dense_ = true;
+            res.nnz_ = nnz_;
+            storage_transpose(dense_, res.dense_);
+        } else {
+            res.sparse_ = sparse_.transposed();
+        }
+        return res;
+    }
+
+    bool empty() const { return visit([](const auto& m) { return m.empty(); }); }
+
+    /// Метод проверки плотного представления
+    bool is_dense() const { return is_dense_; }
+    /// Разреженное представление
+    const sparse_type& sparse() const { return sparse_; }
+    /// Плотное представление
+    dense_type& dense() { return dense_; }
+    /// Плотное представление
+    const dense_type& dense() const { return dense_; }
+
+private:
+    /// Приведение к пустому разреженному содержимому (после перемещения)
+    void clear_content() {
+        rows_ = 0;
+        cols_ = 0;
+        is_dense_ = false;
+        nnz_.reset();
+        sparse_ = sparse_type();
+        dense_ = dense_type();
+    }
+
+    template <class F>
+    decltype(auto) visit(F f) {
+        if (is_dense_) {
+            return f(dense_);
+        }
+        return f(sparse_);
+    }
+
+    template <class F>
+    decltype(auto) visit(F f) const {
+        if (is_dense_) {
+            return f(dense_);
+        }
+        return f(sparse_);
+    }
+
+    unsigned rows_ = 0;
+    unsigned cols_ = 0;
+    /// Признак плотного представления
+    bool is_dense_ = false;
+    /// Количество хранимых элементов плотного представления (пусто - неизвестно)
+    mutable std::optional<std::size_t> nnz_;
+    sparse_type sparse_;
+    dense_type dense_;
+    /// Пороги переключения
+    hybrid_thresholds thresholds_ = hybrid_config::default_thresholds();
+    /// Статистика переключений
+    hybrid_stats stats_;
+};
+
+/// Задание размеров гибридного контейнера
+template <class T>
+void storage_resize(hybrid_map<unsigned, hybrid_map<unsigned, T>>& map, unsigned rows_num, unsigned cols_num) {
+    map.resize(rows_num, cols_num);
+}
+
+/// Добавление элемента в конец гибридного контейнера
+template <class T>
+void storage_append(hybrid_map<unsigned, hybrid_map<unsigned, T>>& map,
+    unsigned row_num, unsigned col_num, const T& value)
+{
+    map.push_back(row_num, col_num, value);
+}
+
+/// Вставка в середину гибридного контейнера сдвигает массивы, пока он разреженный
+template <class T>
+bool storage_shifting(const hybrid_map<unsigned, hybrid_map<unsigned, T>>& map) {
+    return !map.is_dense();
+}
+
+/// Удаление элементов гибридного контейнера по условию
+template <class T, class Pred>
+void storage_erase_if(hybrid_map<unsigned, hybrid_map<unsigned, T>>& map, Pred pred) {
+    map.erase_if(pred);
+}
+
+/// Транспонирование гибридного контейнера в текущем представлении
+template <class T>
+void storage_transpose(const hybrid_map<unsigned, hybrid_map<unsigned, T>>& src,
+    hybrid_map<unsigned, hybrid_map<unsigned, T>>& dst)
+{
+    dst = src.transposed();
+}
+
+/// Выбор представления гибридного контейнера по заполненности
+template <class T>
+void storage_adapt(hybrid_map<unsigned, hybrid_map<unsigned, T>>& map, unsigned, unsigned) {
+    map.adapt();
+}
+
+/// Доступ к плотному представлению гибридного контейнера
+template <class T>
+dense_map<unsigned, dense_map<unsigned, T>>* storage_dense(hybrid_map<unsigned, hybrid_map<unsigned, T>>& map) {
+    return map.is_dense() ? &map.dense() : nullptr;
+}
+
+/// Доступ к плотному представлению константного гибридного контейнера
+template <class T>
+const dense_map<unsigned, dense_map<unsigned, T>>* storage_dense(const hybrid_map<unsigned, hybrid_map<unsigned, T>>& map) {
+    return map.is_dense() ? &map.dense() : nullptr;
+}
+
+/// Замена содержимого гибридного контейнера плотным представлением
+template <class T>
+void storage_assign_dense(hybrid_map<unsigned, hybrid_map<unsigned, T>>& map,
+    dense_map<unsigned, dense_map<unsigned, T>>&& dense)
+{
+    map.assign_dense(std::move(dense));
+}
@@ -1,12 +1,33 @@
 #include "rational.h"
+#include "bigint.h"
+#include "adaptive.h"
 #include "matrix.h"
+#include "solver.h"
+#include "exact.h"
 #include <iostream>
 
 #include <unordered_map>
 
 int main() {
     RationalNumberTest{}();
+    BigIntTest{}();
+    AdaptiveRationalTest{}();
     MatrixTest{}();
+    CsrTest{}();
+    ParallelTest{}();
+    DenseTest{}();
+    HybridTest{}();
+    ExpressionTest{}();
+    MoveTest{}();
+    PoolTest{}();
+    FlatHashTest{}();
+    SolverTest{}();
+    ExactTest{}();
     ProxyTest{}();
+    ViewTest{}();
+    IteratorTest{}();
+    ContentHashTest{}();
+    TransposeTest{}();
+    ChainTest{}();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+    \brief Файл, отображенный в память только для чтения
+
+    Владеет отображением: освобождает его в деструкторе, перемещается, но
+    не копируется. Пустой файл отображается в пустой диапазон. Ошибки
+    открытия и отображения сообщаются через std::system_error.
+*/
+class Mapped_file {
+public:
+    /// Конструктор по пути к файлу
+    explicit Mapped_file(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::generic_category(), "cannot stat " + path);
+        }
+        size_ = st.st_size;
+        if (size_ > 0) {
+            void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::generic_category(), "cannot map " + path);
+            }
+            data_ = static_cast<const char*>(addr);
+            // файл читается один раз от начала до конца
+            ::madvise(addr, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+    }
+
+    Mapped_file(const Mapped_file&) = delete;
+    Mapped_file& operator= (const Mapped_file&) = delete;
+
+    /// Конструктор перемещения
+    Mapped_file(Mapped_file&& other) noexcept :
+        data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+    /// Присваивание перемещением
+    Mapped_file& operator= (Mapped_file&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    ~Mapped_file() {
+        unmap();
+    }
+
+    /// Начало содержимого
+    const char* data() const { return data_; }
+    /// Размер содержимого в байтах
+    std::size_t size() const { return size_; }
+    /// Содержимое целиком
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+private:
+    void unmap() {
+        if (data_) {
+            ::munmap(const_cast<char*>(data_), size_);
+            data_ = nullptr;
+        }
+    }
+
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+};
@@ -2,12 +2,34 @@
 
 #include "rational.h"
 #include "coords.h"
+#include "storage.h"
+#include "csr.h"
+#include "dense.h"
+#include "parallel.h"
+#include "hybrid.h"
+#include "mapped_file.h"
+#include "text_parser.h"
+#include "binary_format.h"
+#include "text_writer.h"
+#include "expression.h"
+#include "pool.h"
+#include "flat_hash.h"
+#include "triplets.h"
+#include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include <exception>
+#include <functional>
 #include <vector>
 #include <set>
+#include <unordered_set>
 #include <map>
 #include <fstream>
+#include <sstream>
+#include <tuple>
+#include <optional>
+#include <cmath>
+#include <limits>
 
 /// Функция равенства нулю
 inline bool is_zero(double eps) {
@@ -42,12 +64,29 @@ inline std::vector<std::string> split(const std::string& s) {
     return res;
 }
 
+/// Наименьший размер куска файла (в байтах) при параллельном считывании
+inline constexpr std::size_t file_chunk_min_size = 1 << 16;
+
 template <typename T, template <class...> class M = std::map>
 class Matrix;
 
 template <class T, template <class...> class M>
 class Matrix_proxy;
 
+template <class T, template <class...> class M, bool Const>
+class basic_matrix_view;
+
+template <class T, template <class...> class M>
+class Matrix_element_ref;
+
+/// Срез-представление с записью в матрицу
+template <class T, template <class...> class M = std::map>
+using Matrix_view = basic_matrix_view<T, M, false>;
+
+/// Срез-представление только для чтения
+template <class T, template <class...> class M = std::map>
+using Matrix_const_view = basic_matrix_view<T, M, true>;
+
 /**
     \brief Исключение неверного индекса
 
@@ -161,6 +200,209 @@ public:
     parent_deleted_error(std::string what) : std::runtime_error(what) {}
 };
 
+/**
+    \brief Исключение пустой цепочки матриц
+
+    Данный класс является исключением для ситуации, когда вычисляется
+    произведение цепочки, в которую не добавлено ни одной матрицы.
+*/
+class empty_chain_error : public std::runtime_error {
+public:
+    empty_chain_error(std::string what) : std::runtime_error(what) {}
+};
+
+/**
+    \brief Аккумулятор строки произведения
+
+    Плотный массив сумм по столбцам и список затронутых столбцов. Сумма в
+    каждом столбце накапливается в том же порядке, что и при прямом
+    вычислении скалярного произведения, начиная с нуля.
+*/
+template <class T>
+class Matrix_accumulator {
+public:
+    /// Конструктор по количеству столбцов результата
+    explicit Matrix_accumulator(unsigned cols_num) :
+        values_(cols_num + 1), used_(cols_num + 1, false) {}
+
+    /// Метод добавления слагаемого в столбец
+    template <class V>
+    void add(unsigned col_num, const V& value) {
+        if (!used_[col_num]) {
+            used_[col_num] = true;
+            values_[col_num] = 0;
+            cols_.push_back(col_num);
+        }
+        values_[col_num] += value;
+    }
+
+    /**
+        \brief Метод выдачи строки по возрастанию столбцов (без элементов меньше eps) и очистки
+
+        При eps = 0 нули не отбрасываются, поэтому выдаются все столбцы,
+        незатронутые - нулями.
+    */
+    template <class F>
+    void flush(double eps, F out) {
+        using std::abs;
+        if (!(0 < eps)) {
+            for (unsigned col_num = 1; col_num < values_.size(); ++col_num) {
+                out(col_num, used_[col_num] ? values_[col_num] : T(0));
+                used_[col_num] = false;
+            }
+            cols_.clear();
+            return;
+        }
+        std::sort(cols_.begin(), cols_.end());
+        for (auto col_num : cols_) {
+            if (!(abs(values_[col_num]) < eps)) {
+                out(col_num, values_[col_num]);
+            }
+            used_[col_num] = false;
+        }
+        cols_.clear();
+    }
+
+private:
+    /// Суммы по столбцам
+    std::vector<T> values_;
+    /// Признаки затронутых столбцов
+    std::vector<bool> used_;
+    /// Затронутые столбцы
+    std::vector<unsigned> cols_;
+};
+
+/// Перемешивание битов 64-битного значения (финализатор splitmix64)
+inline std::uint64_t matrix_hash_mix(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+/// Признак наличия std::hash у типа элементов (нужен для хэша содержимого матрицы)
+template <class T>
+struct is_matrix_hashable : std::is_default_constructible<std::hash<T>> {};
+
+/**
+    \brief Хранимый элемент матрицы, выдаваемый итератором
+
+    Номер строки, номер столбца и ссылка на значение в контейнере.
+    Поддерживает структурное связывание: for (auto [i, j, v] : m.nonzeros()).
+*/
+template <class V>
+struct matrix_entry {
+    unsigned row;
+    unsigned col;
+    V& value;
+};
+
+/**
+    \brief Итератор по хранимым элементам контейнера матрицы
+
+    Обходит строки внешнего контейнера в диапазоне [row, row_end) и
+    элементы каждой строки, пропуская пустые строки. Порядок обхода - порядок
+    контейнера (для упорядоченных контейнеров - по строкам и столбцам).
+    Работает с любым контейнером: используются только begin/end, -> и ++.
+*/
+template <class C, bool Const>
+class basic_nonzero_iterator {
+public:
+    using storage_type = std::conditional_t<Const, const C, C>;
+    using row_iterator = decltype(std::declval<storage_type&>().begin());
+    using elem_iterator = decltype(std::declval<row_iterator&>()->second.begin());
+    using value_ref = std::remove_reference_t<decltype((std::declval<elem_iterator&>()->second))>;
+    using value_type = matrix_entry<value_ref>;
+    using reference = value_type&;
+    using pointer = value_type*;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::forward_iterator_tag;
+
+    basic_nonzero_iterator(row_iterator row, row_iterator row_end) : row_(row), row_end_(row_end) {
+        enter_row();
+    }
+
+    basic_nonzero_iterator(const basic_nonzero_iterator& other) :
+        row_(other.row_), row_end_(other.row_end_), elem_(other.elem_), elem_end_(other.elem_end_) {}
+
+    basic_nonzero_iterator& operator= (const basic_nonzero_iterator& other) {
+        row_ = other.row_;
+        row_end_ = other.row_end_;
+        elem_ = other.elem_;
+        elem_end_ = other.elem_end_;
+        current_.reset();
+        return *this;
+    }
+
+    reference operator* () const {
+        current_.emplace(value_type{row_->first, (*elem_)->first, (*elem_)->second});
+        return *current_;
+    }
+
+    pointer operator-> () const {
+        return &operator*();
+    }
+
+    basic_nonzero_iterator& operator++ () {
+        if (++*elem_ == *elem_end_) {
+            ++row_;
+            enter_row();
+        }
+        return *this;
+    }
+
+    basic_nonzero_iterator operator++ (int) {
+        auto old = *this;
+        ++*this;
+        return old;
+    }
+
+    bool operator== (const basic_nonzero_iterator& other) const {
+        return row_ == other.row_ && (row_ == row_end_ || *elem_ == *other.elem_);
+    }
+
+    bool operator!= (const basic_nonzero_iterator& other) const {
+        return !(*this == other);
+    }
+
+private:
+    /// Переход к первому элементу первой непустой строки начиная с row_
+    void enter_row() {
+        for (; row_ != row_end_; ++row_) {
+            auto&& row = row_->second;
+            elem_.emplace(row.begin());
+            elem_end_.emplace(row.end());
+            if (*elem_ != *elem_end_) {
+                return;
+            }
+        }
+        elem_.reset();
+        elem_end_.reset();
+    }
+
+    row_iterator row_, row_end_;
+    /// Текущий элемент и конец текущей строки (пусты в конце обхода)
+    std::optional<elem_iterator> elem_, elem_end_;
+    mutable std::optional<value_type> current_;
+};
+
+/// Диапазон итераторов (для range-based for)
+template <class It>
+class Matrix_range {
+public:
+    Matrix_range(It begin, It end) : begin_(begin), end_(end) {}
+
+    It begin() const { return begin_; }
+    It end() const { return end_; }
+
+    bool empty() const { return begin_ == end_; }
+
+private:
+    It begin_, end_;
+};
+
 /**
     \brief Класс матриц
 
@@ -169,86 +411,160 @@ public:
 template <typename T, template <class...> class M>
 class Matrix {
 
+public:
+    /// Тип контейнера элементов
+    using storage_type = M<unsigned, M<unsigned, T>>;
+    /// Тип элементов
+    using value_type = T;
+    /// Итератор по хранимым элементам
+    using nonzero_iterator = basic_nonzero_iterator<storage_type, false>;
+    /// Константный итератор по хранимым элементам
+    using const_nonzero_iterator = basic_nonzero_iterator<storage_type, true>;
+
+private:
+    /// Перемещение не выбрасывает исключений, если их не выбрасывает контейнер
+    static constexpr bool nothrow_move = std::is_nothrow_move_constructible_v<storage_type> &&
+        std::is_nothrow_move_assignable_v<storage_type> &&
+        std::is_nothrow_default_constructible_v<storage_type>;
+
 public:
 
     /// Конструктор по размерам матрицы
     Matrix(unsigned rows_num, unsigned cols_num, double eps) :
-        rows_num_(rows_num), cols_num_(cols_num), eps_(eps) {}
+        rows_num_(rows_num), cols_num_(cols_num), eps_(eps)
+    {
+        storage_resize(map_, rows_num_, cols_num_);
+    }
 
     /// Конструктор по элементам
     Matrix(const M<unsigned, M<unsigned, T>>& map, unsigned rows_num, unsigned cols_num, double eps) :
         rows_num_(rows_num), cols_num_(cols_num), eps_(eps) 
     {
+        Triplet_builder<T> triplets(rows_num_);
         for (auto& [row_num, row] : map) {
             for (auto& [col_num, elem] : row) {
-                if (row_num < 1 || row_num > rows_num) {
-                    throw invalid_index_error("row num out of range", *this, {row_num, col_num});
-                }
-                if (col_num < 1 || col_num > cols_num) {
-                    throw invalid_index_error("col num out of range", *this, {row_num, col_num});
-                }
+                check_triplet(row_num, col_num);
+                triplets.add(row_num, col_num, elem);
             }
         }
-        map_ = map;
-        delete_zeros();
+        build(triplets, triplet_duplicates::overwrite);
+    }
+
+    /**
+        \brief Создание матрицы по тройкам (строка, столбец, значение)
+
+        Тройки могут идти в любом порядке; повторы складываются или
+        перезаписываются в зависимости от mode, элементы меньше eps
+        отбрасываются. Контейнер строится одним проходом (Triplet_builder).
+    */
+    template <class Range>
+    static Matrix from_triplets(const Range& triplets, unsigned rows_num, unsigned cols_num, double eps,
+        triplet_duplicates mode = triplet_duplicates::sum)
+    {
+        Matrix res(rows_num, cols_num, eps);
+        Triplet_builder<T> builder(rows_num);
+        for (const auto& [row_num, col_num, value] : triplets) {
+            res.check_triplet(row_num, col_num);
+            builder.add(row_num, col_num, value);
+        }
+        res.build(builder, mode);
+        return res;
     }
 
     /// Конструктор по срезу
     template <template <class...> class M2>
     Matrix(const Matrix_proxy<T, M2>& pr, double eps) : eps_(eps) {
-        auto par = pr.get_parent();
         auto r = pr.get_row_index();
         auto c = pr.get_col_index();
-        rows_num_ = r.second - r.first + 1;
-        cols_num_ = c.second - c.first + 1;
-        for (const auto& [row_num, row] : par->get_map()) {
-            if (row_num >= r.first && row_num <= r.second) {
-                for (const auto& [col_num, elem] : row) {
-                    if (col_num >= c.first && col_num <= c.second) {
-                        operator[](std::make_pair(row_num - r.first + 1, col_num - c.first + 1)) = elem;
-                    }
-                }
-            }
-        }
+        assign_block(pr.get_parent()->get_map(), r.first, r.second, c.first, c.second);
+    }
+
+    /// Конструктор по срезу-представлению
+    template <template <class...> class M2, bool Const>
+    Matrix(const basic_matrix_view<T, M2, Const>& view, double eps) : eps_(eps) {
+        auto r = view.get_row_index();
+        auto c = view.get_col_index();
+        assign_block(view.get_parent()->get_map(), r.first, r.second, c.first, c.second);
     }
 
     /// Деструктор
     ~Matrix() {
-        for (const auto& pr : proxy_) {
-            pr->parent_deleted();
-        }
+        detach_proxies();
     }
 
-    /// Конструктор копирования
+    /// Конструктор копирования (срезы исходной матрицы не копируются)
     Matrix(const Matrix& other) : rows_num_(other.rows_num_), cols_num_(other.cols_num_), 
-        eps_(other.eps_), map_(other.map_) {}
+        eps_(other.eps_), map_(other.map_), dirty_(other.dirty_),
+        hash_(other.hash_), hash_valid_(other.hash_valid_) {}
 
-    /// Конструктор копирования по rvalue-ссылке
-    Matrix(Matrix&& other) : rows_num_(other.rows_num_), cols_num_(other.cols_num_), 
-        eps_(other.eps_), map_(other.map_) {}
+    /**
+        \brief Конструктор перемещения
 
-    /// Оператор копирования
-    Matrix& operator= (const Matrix& other) {
+        Забирает контейнер и срезы other (срезы переходят к новой матрице).
+        other остается пустой матрицей 0 x 0.
+    */
+    Matrix(Matrix&& other) noexcept(nothrow_move) : rows_num_(other.rows_num_), cols_num_(other.cols_num_), 
+        eps_(other.eps_), map_(std::move(other.map_)), dirty_(other.dirty_),
+        hash_(other.hash_), hash_valid_(other.hash_valid_),
+        proxy_(std::move(other.proxy_))
+    {
         for (const auto& pr : proxy_) {
-            pr->parent_deleted();
+            pr->parent_moved(this);
         }
-        proxy_.clear();
+        other.reset_moved();
+    }
+
+    /// Оператор копирования (срезы этой матрицы отсоединяются)
+    Matrix& operator= (const Matrix& other) {
+        if (this == &other) {
+            return *this;
+        }
+        detach_proxies();
         rows_num_ = other.rows_num_;
         cols_num_ = other.cols_num_;
-        eps_ = other.eps;
+        eps_ = other.eps_;
         map_ = other.map_;
+        dirty_ = other.dirty_;
+        hash_ = other.hash_;
+        hash_valid_ = other.hash_valid_;
+        return *this;
     }
 
-    /// Оператор копирования по rvalue-ссылке
-    Matrix& operator= (Matrix&& other) {
-        for (const auto& pr : proxy_) {
-            pr->parent_deleted();
+    /// Оператор перемещения (срезы этой матрицы отсоединяются, срезы other переходят к ней)
+    Matrix& operator= (Matrix&& other) noexcept(nothrow_move) {
+        if (this == &other) {
+            return *this;
         }
-        proxy_.clear();
+        detach_proxies();
         rows_num_ = other.rows_num_;
         cols_num_ = other.cols_num_;
-        eps_ = other.eps;
-        map_ = other.map_;
+        eps_ = other.eps_;
+        map_ = std::move(other.map_);
+        dirty_ = other.dirty_;
+        hash_ = other.hash_;
+        hash_valid_ = other.hash_valid_;
+        proxy_ = std::move(other.proxy_);
+        for (const auto& pr : proxy_) {
+            pr->parent_moved(this);
+        }
+        other.reset_moved();
+        return *this;
+    }
+
+    /// Конструктор по выражению (вычисление за один проход)
+    template <class E, class = std::enable_if_t<std::is_same_v<typename E::matrix_type, Matrix>>>
+    Matrix(const Matrix_expr<E>& expr) :
+        rows_num_(expr.get_rows_num()), cols_num_(expr.get_cols_num()), eps_(expr.get_eps())
+    {
+        assign_expr(expr.self());
+    }
+
+    /// Оператор присваивания выражения
+    template <class E, class = std::enable_if_t<std::is_same_v<typename E::matrix_type, Matrix>>>
+    Matrix& operator= (const Matrix_expr<E>& expr) {
+        detach_proxies();
+        assign_expr(expr.self());
+        return *this;
     }
 
     /// Создание единичной матрицы заданного размера
@@ -274,6 +590,7 @@ public:
             }
         }
         res.eps_ = eps;
+        res.dirty_ = true;
         return res;
     }
 
@@ -289,6 +606,7 @@ public:
             }
         }
         res.eps_ = eps;
+        res.dirty_ = true;
         return res;
     }
 
@@ -304,21 +622,50 @@ public:
             }
         }
         res.eps_ = eps;
+        res.dirty_ = true;
         return res;
     }
 
     /// Оператор считывания матрицы из файла
     static Matrix from_file(std::string file_path, double eps) {
-        std::ifstream in;
-        in.open(file_path);
-        std::string s;
-        std::getline(in, s);
-        auto w = split(s);
-        while (w.empty() || w[0][0] == '#') {
-            std::getline(in, s);
-            w = split(s);
-        }
-        if (w.size() < 4) {
+        return from_file(file_path, eps, Matrix_execution::sequential());
+    }
+
+    /**
+        \brief Считывание матрицы из файла с выбором политики выполнения
+
+        Файл отображается в память и разбирается на месте: строки и слова -
+        string_view внутрь файла, числа читаются через from_chars. Элементы,
+        идущие по возрастанию (строка, столбец), добавляются в конец
+        контейнера, остальные - обычной вставкой.
+
+        При параллельном выполнении тело файла делится на куски по границам
+        строк, каждый кусок разбирается в свой буфер, затем буферы
+        добавляются в контейнер в порядке файла. Сообщение об ошибке то же,
+        что и при последовательном разборе: о первой ошибочной строке.
+
+        Хранятся только элементы, записанные в файле (при eps = 0 - в том
+        числе записанные нули), так что память зависит от их числа, а не от
+        размеров матрицы.
+    */
+    static Matrix from_file(std::string file_path, double eps, const Matrix_execution& policy) {
+        std::optional<Mapped_file> file;
+        try {
+            file.emplace(file_path);
+        } catch (std::system_error& ex) {
+            throw file_invalid_error("cannot open file", file_path);
+        }
+        Text_lines lines(file->view());
+        std::string_view s;
+        std::string_view w[4];
+        std::size_t count = 0;
+        while (count == 0 || w[0][0] == '#') {
+            if (!lines.next(s)) {
+                throw file_invalid_error("file header broken", file_path);
+            }
+            count = Text_tokens(s).read(w, 4);
+        }
+        if (count < 4) {
             throw file_invalid_error("file header broken", file_path);
         }
         if (w[0] != "matrix") {
@@ -339,117 +686,354 @@ public:
         } else {
             throw file_invalid_error("unknown type", file_path);
         }
-        int rows_num, cols_num;
-        try {
-            rows_num = stoui(w[2]);
-            cols_num = stoui(w[3]);
-        } catch (std::exception& ex) {
+        unsigned rows_num, cols_num;
+        if (!parse_value(w[2], rows_num) || !parse_value(w[3], cols_num)) {
             throw file_invalid_error("invalid matrix size", file_path);
         }
         Matrix res(rows_num, cols_num, eps);
-        while (std::getline(in, s)) {
-            w = split(s);
-            if (w.empty() || w[0][0] == '#') {
-                continue;
-            }
-            if (w.size() < 3) {
-                throw file_invalid_error("invalid line: " + s, file_path);
-            }
-            int row_num, col_num;
-            try {
-                row_num = stoui(w[0]);
-                col_num = stoui(w[1]);
-            } catch (std::exception& ex) {
-                throw file_invalid_error("invalid index: " + s, file_path);
-            }
-            if (row_num < 1 || row_num > rows_num) {
-                throw file_invalid_error("invalid row index: " + s, file_path);
-            }
-            if (col_num < 1 || col_num > cols_num) {
-                throw file_invalid_error("invalid col index: " + s, file_path);
-            }
-            if (std::is_same_v<T, RationalNumber<int>>) {
-                if (w[2][0] != '<' || w[2][w[2].size() - 1] != '>') {
-                    throw file_invalid_error("invalid rational: " + s, file_path);
-                }
-                try {
-                    res[std::make_pair(row_num, col_num)] = T(RationalNumber(w[2].substr(1, w[2].size() - 2).c_str()));
-                } catch (std::exception& ex) {
-                    throw file_invalid_error("invalid rational: " + s, file_path);
+        // повторная позиция в файле перезаписывает значение
+        Triplet_builder<T> triplets(rows_num);
+        auto body = file->view().substr(std::min(lines.position(), file->size()));
+        unsigned parts_num = policy.is_parallel() ? policy.parts(body.size() / file_chunk_min_size + 1) : 1;
+        if (parts_num == 1) {
+            unsigned row_num, col_num;
+            T value;
+            while (lines.next(s)) {
+                auto status = parse_element_line(s, rows_num, cols_num, row_num, col_num, value);
+                if (status == text_line_status::skip) {
+                    continue;
                 }
-            } else if (std::is_same_v<T, int>) {
-                try {
-                    res[std::make_pair(row_num, col_num)] = std::stoi(w[2]);
-                } catch (std::exception& ex) {
-                    throw file_invalid_error("invalid integer: " + s, file_path);
+                if (status != text_line_status::element) {
+                    throw file_invalid_error(text_line_error<T>(status) + std::string(s), file_path);
                 }
-            } else if (std::is_same_v<T, double>) {
-                try {
-                    res[std::make_pair(row_num, col_num)] = std::stod(w[2]);
-                } catch (std::exception& ex) {
-                    throw file_invalid_error("invalid float: " + s, file_path);
+                triplets.add(row_num, col_num, value);
+            }
+        } else {
+            // границы кусков сдвигаются на начало следующей строки
+            std::vector<std::size_t> bounds(parts_num + 1, body.size());
+            bounds[0] = 0;
+            for (unsigned part = 1; part < parts_num; ++part) {
+                auto pos = std::max(bounds[part - 1], body.size() * part / parts_num);
+                if (pos > 0 && pos < body.size() && body[pos - 1] != '\n') {
+                    pos = body.find('\n', pos);
+                    pos = pos == std::string_view::npos ? body.size() : pos + 1;
                 }
+                bounds[part] = pos;
             }
-        }
-        if (is_zero(eps)) {
-            for (unsigned i = 1; i <= rows_num; ++i) {
-                for (unsigned j = 1; j <= cols_num; ++j) {
-                    // при обращении создается нулевой элемент, но потом он не удалится,
-                    // и матрица будет полной
-                    res[std::make_pair(i, j)];
+            struct chunk {
+                std::vector<std::tuple<unsigned, unsigned, T>> elems;
+                text_line_status error = text_line_status::skip;
+                std::string_view error_line;
+            };
+            std::vector<chunk> chunks(parts_num);
+            policy.for_parts(parts_num, [&](unsigned, std::size_t begin, std::size_t end) {
+                for (auto part = begin; part < end; ++part) {
+                    auto& ch = chunks[part];
+                    Text_lines chunk_lines(body.substr(bounds[part], bounds[part + 1] - bounds[part]));
+                    std::string_view line;
+                    unsigned row_num, col_num;
+                    T value;
+                    while (chunk_lines.next(line)) {
+                        auto status = parse_element_line(line, rows_num, cols_num, row_num, col_num, value);
+                        if (status == text_line_status::element) {
+                            ch.elems.emplace_back(row_num, col_num, value);
+                        } else if (status != text_line_status::skip) {
+                            ch.error = status;
+                            ch.error_line = line;
+                            break;
+                        }
+                    }
                 }
+            });
+            for (const auto& ch : chunks) {
+                if (ch.error != text_line_status::skip) {
+                    throw file_invalid_error(text_line_error<T>(ch.error) + std::string(ch.error_line), file_path);
+                }
+            }
+            std::size_t count = 0;
+            for (const auto& ch : chunks) {
+                count += ch.elems.size();
+            }
+            triplets.reserve(count);
+            for (const auto& ch : chunks) {
+                triplets.append(ch.elems);
             }
         }
+        res.build(triplets, triplet_duplicates::overwrite);
+        res.delete_zeros();
+        storage_adapt(res.map_, res.rows_num_, res.cols_num_);
         return res;
     }
 
     /// Оператор превращения матрицы в строку
     std::string to_file_string () const {
-        using std::to_string;
-        std::string res = "matrix ";
+        std::ostringstream out;
+        write_to(out);
+        return out.str();
+    }
+
+    /**
+        \brief Запись матрицы в поток в текстовом формате
+
+        Вывод совпадает с to_file_string, но числа форматируются в буфер
+        фиксированного размера (Text_writer), который сбрасывается в поток
+        по заполнении.
+    */
+    void write_to(std::ostream& out) const {
+        const char* type_name;
         if (std::is_same_v<T, RationalNumber<int>>) {
-            res += "rational ";
+            type_name = "rational";
         } else if (std::is_same_v<T, int>) {
-            res += "integer ";
+            type_name = "integer";
         } else if (std::is_same_v<T, double>) {
-            res += "float ";
+            type_name = "float";
         } else {
             throw invalid_matrix_type_error("unknown type name", *this);
         }
-        res += std::to_string(rows_num_) + " " + std::to_string(cols_num_) + "\n";
-        for (auto& [row_num, row] : map_) {
-            for (auto& [col_num, elem_t] : row) {
-                T elem = elem_t;
-                res += std::to_string(row_num) + " " + std::to_string(col_num) + " ";
-                std::string to_add;
-                if (std::is_same_v<T, RationalNumber<int>>) {
-                    to_add = "<" + to_string(elem) + ">";
-                } else {
-                    to_add = to_string(elem);
+        Text_writer writer(out);
+        writer.put("matrix ");
+        writer.put(type_name);
+        writer.put(' ');
+        writer.put_value(rows_num_);
+        writer.put(' ');
+        writer.put_value(cols_num_);
+        writer.put('\n');
+        delete_zeros();
+        for (const auto& [row_num, row] : map_) {
+            for (const auto& [col_num, elem] : row) {
+                writer.put_value(row_num);
+                writer.put(' ');
+                writer.put_value(col_num);
+                writer.put(' ');
+                writer.put_value(static_cast<const T&>(elem));
+                writer.put('\n');
+            }
+        }
+    }
+
+    /**
+        \brief Запись матрицы в двоичный файл
+
+        Формат описан в binary_format.h. Элементы записываются тремя
+        проходами по контейнеру (начала строк, столбцы, значения), так что
+        дополнительная память - только на массив начал строк. Элементы
+        неупорядоченного контейнера сначала собираются в массив троек и
+        сортируются по (строка, столбец): формат требует строк по порядку
+        и возрастающих столбцов.
+    */
+    void to_binary_file(const std::string& file_path) const {
+        using traits = matrix_binary_type<T>;
+        using stored_type = typename traits::stored_type;
+        delete_zeros();
+        std::vector<matrix_triplet<stored_type>> sorted;
+        if constexpr (!is_ordered_storage<storage_type>::value) {
+            for (const auto& [row_num, row] : map_) {
+                for (const auto& [col_num, elem] : row) {
+                    sorted.push_back({row_num, col_num, traits::store(elem)});
+                }
+            }
+            std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+                return a.row < b.row || (a.row == b.row && a.col < b.col);
+            });
+        }
+        // f(row_num, col_num, value) в порядке (строка, столбец)
+        auto for_each_elem = [&](auto f) {
+            if constexpr (is_ordered_storage<storage_type>::value) {
+                for (const auto& [row_num, row] : map_) {
+                    for (const auto& [col_num, elem] : row) {
+                        f(row_num, col_num, elem);
+                    }
+                }
+            } else {
+                for (const auto& t : sorted) {
+                    f(t.row, t.col, t.value);
                 }
-                res += to_add + "\n";
             }
+        };
+        std::vector<std::uint64_t> row_ptr(rows_num_ + 1, 0);
+        for_each_elem([&](unsigned row_num, unsigned, const auto&) {
+            ++row_ptr[row_num];
+        });
+        for (unsigned i = 0; i < rows_num_; ++i) {
+            row_ptr[i + 1] += row_ptr[i];
+        }
+        matrix_binary_header header = {};
+        std::copy(std::begin(matrix_binary_magic), std::end(matrix_binary_magic), header.magic);
+        header.version = matrix_binary_version;
+        header.type_tag = traits::tag;
+        header.rows = rows_num_;
+        header.cols = cols_num_;
+        header.nnz = row_ptr[rows_num_];
+        header.value_size = sizeof(stored_type);
+        matrix_binary_layout layout(header.rows, header.nnz, header.value_size);
+        std::ofstream out(file_path, std::ios::binary);
+        auto pad = [&](std::uint64_t offset) {
+            static const char zeros[8] = {};
+            out.write(zeros, offset - out.tellp());
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        pad(layout.row_ptr);
+        out.write(reinterpret_cast<const char*>(row_ptr.data()), row_ptr.size() * sizeof(std::uint64_t));
+        for_each_elem([&](unsigned, unsigned col_num, const auto&) {
+            std::uint32_t col = col_num;
+            out.write(reinterpret_cast<const char*>(&col), sizeof(col));
+        });
+        pad(layout.values);
+        for_each_elem([&](unsigned, unsigned, const auto& elem) {
+            stored_type value;
+            if constexpr (is_ordered_storage<storage_type>::value) {
+                value = traits::store(elem);
+            } else {
+                value = elem;
+            }
+            out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        });
+        if (!out) {
+            throw file_invalid_error("cannot write file", file_path);
+        }
+    }
+
+    /// Открытие двоичного файла матрицы без копирования (только чтение)
+    static Matrix_binary_view<T> open_binary_file(const std::string& file_path) {
+        std::optional<Mapped_file> file;
+        try {
+            file.emplace(file_path);
+        } catch (std::system_error& ex) {
+            throw file_invalid_error("cannot open file", file_path);
         }
+        if (auto error = matrix_binary_check<T>(file->view())) {
+            throw file_invalid_error(error, file_path);
+        }
+        return Matrix_binary_view<T>(std::move(*file));
+    }
+
+    /// Считывание матрицы из двоичного файла
+    static Matrix from_binary_file(const std::string& file_path, double eps) {
+        auto view = open_binary_file(file_path);
+        Matrix res(view.get_rows_num(), view.get_cols_num(), eps);
+        unsigned last_col = 0;
+        unsigned last_row = 0;
+        try {
+            view.for_each([&](unsigned row_num, unsigned col_num, const T& value) {
+                if (col_num < 1 || col_num > res.cols_num_ || (row_num == last_row && col_num <= last_col)) {
+                    throw file_invalid_error("invalid col index", file_path);
+                }
+                storage_append(res.map_, row_num, col_num, value);
+                last_row = row_num;
+                last_col = col_num;
+            });
+        } catch (std::runtime_error& ex) {
+            // недопустимое значение (например, нулевой знаменатель)
+            throw file_invalid_error("invalid value", file_path);
+        }
+        res.dirty_ = true;
+        res.delete_zeros();
+        storage_adapt(res.map_, res.rows_num_, res.cols_num_);
         return res;
     }
 
     /// Оператор транспонирования
     Matrix operator~ () const {
         Matrix res(cols_num_, rows_num_, eps_);
-        for (const auto& [row_num, row] : map_) {
-            for (const auto& [col_num, num] : row) {
-                res[std::make_pair(col_num, row_num)] = num;
+        delete_zeros();
+        if constexpr (has_storage_transpose<storage_type>::value) {
+            storage_transpose(map_, res.map_);
+            storage_adapt(res.map_, res.rows_num_, res.cols_num_);
+        } else {
+            res.map_ = transposed_storage();
+            storage_adapt(res.map_, res.rows_num_, res.cols_num_);
+        }
+        return res;
+    }
+
+    /**
+        \brief Транспонирование на месте
+
+        Квадратная матрица в плотном представлении транспонируется
+        кэш-независимым обменом симметричных блоков без дополнительной
+        памяти. Иначе транспонированный контейнер строится как в operator~ и
+        заменяет текущий.
+    */
+    Matrix& transpose_in_place() {
+        delete_zeros();
+        hash_valid_ = false;
+        if (rows_num_ == cols_num_) {
+            if (auto* dense = storage_dense(map_)) {
+                dense_transpose_in_place(*dense);
+                return *this;
+            }
+        }
+        if constexpr (has_storage_transpose<storage_type>::value) {
+            storage_type res;
+            storage_transpose(map_, res);
+            map_ = std::move(res);
+        } else {
+            map_ = transposed_storage();
+        }
+        std::swap(rows_num_, cols_num_);
+        storage_adapt(map_, rows_num_, cols_num_);
+        return *this;
+    }
+
+    /**
+        \brief Транспонирование с выбором политики выполнения
+
+        При параллельном выполнении каждая часть строк раскладывает свои
+        элементы по столбцам (подсчет и префиксные суммы по частям), после
+        чего результат добавляется в контейнер по порядку.
+    */
+    Matrix transpose(const Matrix_execution& policy) const {
+        if (!policy.is_parallel()) {
+            return operator~();
+        }
+        Matrix res(cols_num_, rows_num_, eps_);
+        delete_zeros();
+        auto rows = row_iterators();
+        unsigned parts_num = policy.parts(rows.size());
+        std::vector<std::vector<std::size_t>> counts(parts_num);
+        policy.for_parts(rows.size(), [&](unsigned part, std::size_t begin, std::size_t end) {
+            auto& cnt = counts[part];
+            cnt.assign(cols_num_ + 2, 0);
+            for (auto k = begin; k < end; ++k) {
+                for (const auto& [col_num, elem] : rows[k]->second) {
+                    ++cnt[col_num + 1];
+                }
+            }
+        });
+        // смещение части p в столбце c: все элементы меньших столбцов и
+        // элементы столбца c из частей с меньшими номерами
+        std::size_t total = 0;
+        for (unsigned c = 0; c <= cols_num_ + 1; ++c) {
+            for (unsigned part = 0; part < parts_num; ++part) {
+                auto cnt = counts[part][c];
+                counts[part][c] = total;
+                total += cnt;
+            }
+        }
+        std::vector<std::tuple<unsigned, unsigned, T>> elems(total);
+        policy.for_parts(rows.size(), [&](unsigned part, std::size_t begin, std::size_t end) {
+            auto& next = counts[part];
+            for (auto k = begin; k < end; ++k) {
+                auto& [row_num, row] = *rows[k];
+                for (const auto& [col_num, elem] : row) {
+                    elems[next[col_num + 1]++] = {col_num, row_num, elem};
+                }
             }
+        });
+        for (const auto& [row_num, col_num, elem] : elems) {
+            storage_append(res.map_, row_num, col_num, elem);
         }
+        storage_adapt(res.map_, res.rows_num_, res.cols_num_);
         return res;
     }
 
     /// Унарный минус
     Matrix operator- () const {
         Matrix res = *this;
-        for (const auto& [row_num, row] : res.map_) {
-            for (const auto& [col_num, num] : row) {
-                res.map_[row_num][col_num] = -res.map_[row_num][col_num];
+        res.hash_valid_ = false;
+        for (auto& [row_num, row] : res.map_) {
+            for (auto& [col_num, num] : row) {
+                num = -num;
             }
         }
         return res;
@@ -457,84 +1041,332 @@ public:
 
     /// Оператор сложения
     template<class T2, template <class...> class M2>
-    Matrix operator+= (const Matrix<T2, M2>& other) {
+    Matrix& operator+= (const Matrix<T2, M2>& other) {
+        return add(other, Matrix_execution::sequential());
+    }
+
+    /**
+        \brief Сложение с выбором политики выполнения
+
+        Строки обоих слагаемых сливаются в новый контейнер. При параллельном
+        выполнении строки делятся на части, каждая часть сливает свои строки
+        в отдельный буфер, затем буферы добавляются в контейнер по порядку.
+    */
+    template<class T2, template <class...> class M2>
+    Matrix& add(const Matrix<T2, M2>& other, const Matrix_execution& policy) {
         if (rows_num_ != other.get_rows_num() || cols_num_ != other.get_cols_num()) {
             throw size_differentiation_error("size differs", *this, other);
         }
-        for (const auto& [row_num, row] : other.get_map()) {
-            for (const auto& [col_num, num] : row) {
-                operator[](std::make_pair(row_num, col_num)) += num;
+        const auto& other_map = other.get_map();
+        delete_zeros();
+        hash_valid_ = false;
+        if constexpr (is_ordered_storage<storage_type>::value &&
+            is_ordered_storage<typename Matrix<T2, M2>::storage_type>::value)
+        {
+            storage_type res;
+            storage_resize(res, rows_num_, cols_num_);
+            if (!policy.is_parallel()) {
+                auto lit = map_.begin();
+                auto rit = other_map.begin();
+                auto out = [&](unsigned row_num, unsigned col_num, const T& value) {
+                    storage_append(res, row_num, col_num, value);
+                };
+                while (lit != map_.end() || rit != other_map.end()) {
+                    if (rit == other_map.end() || (lit != map_.end() && lit->first < rit->first)) {
+                        merge_rows(lit->first, &lit->second, decltype(&rit->second)(nullptr), out);
+                        ++lit;
+                    } else if (lit == map_.end() || rit->first < lit->first) {
+                        merge_rows(rit->first, decltype(&lit->second)(nullptr), &rit->second, out);
+                        ++rit;
+                    } else {
+                        merge_rows(lit->first, &lit->second, &rit->second, out);
+                        ++lit;
+                        ++rit;
+                    }
+                }
+            } else {
+                // объединение номеров строк: (строка, итератор слева, итератор справа)
+                using lit_type = decltype(map_.begin());
+                using rit_type = decltype(other_map.begin());
+                std::vector<std::tuple<unsigned, lit_type, rit_type>> rows;
+                auto lit = map_.begin();
+                auto rit = other_map.begin();
+                while (lit != map_.end() || rit != other_map.end()) {
+                    if (rit == other_map.end() || (lit != map_.end() && lit->first < rit->first)) {
+                        rows.emplace_back(lit->first, lit, other_map.end());
+                        ++lit;
+                    } else if (lit == map_.end() || rit->first < lit->first) {
+                        rows.emplace_back(rit->first, map_.end(), rit);
+                        ++rit;
+                    } else {
+                        rows.emplace_back(lit->first, lit, rit);
+                        ++lit;
+                        ++rit;
+                    }
+                }
+                std::vector<std::vector<std::tuple<unsigned, unsigned, T>>> parts(policy.parts(rows.size()));
+                policy.for_parts(rows.size(), [&](unsigned part, std::size_t begin, std::size_t end) {
+                    auto out = [&](unsigned row_num, unsigned col_num, const T& value) {
+                        parts[part].emplace_back(row_num, col_num, value);
+                    };
+                    for (auto k = begin; k < end; ++k) {
+                        auto& [row_num, l, r] = rows[k];
+                        merge_rows(row_num,
+                            l == map_.end() ? nullptr : &l->second,
+                            r == other_map.end() ? nullptr : &r->second, out);
+                    }
+                });
+                for (const auto& part : parts) {
+                    for (const auto& [row_num, col_num, value] : part) {
+                        storage_append(res, row_num, col_num, value);
+                    }
+                }
+            }
+            map_ = std::move(res);
+            storage_adapt(map_, rows_num_, cols_num_);
+        } else {
+            for (const auto& [row_num, row] : other_map) {
+                for (const auto& [col_num, num] : row) {
+                    map_[row_num][col_num] += num;
+                }
             }
+            dirty_ = true;
+            delete_zeros();
         }
-        delete_zeros();
         return *this;
     }
 
     /// Оператор вычитания
     template<class T2, template <class...> class M2>
-    Matrix operator-= (const Matrix<T2, M2>& other) {
-        return operator+=(-other);
+    Matrix& operator-= (const Matrix<T2, M2>& other) {
+        if constexpr (is_ordered_storage<storage_type>::value &&
+            is_ordered_storage<typename Matrix<T2, M2>::storage_type>::value)
+        {
+            // слияние без построения -other
+            if (rows_num_ != other.get_rows_num() || cols_num_ != other.get_cols_num()) {
+                throw size_differentiation_error("size differs", *this, other);
+            }
+            assign_expr(Matrix_sum<Matrix_leaf<Matrix, false>, Matrix_leaf<Matrix<T2, M2>, false>, true>(
+                Matrix_leaf<Matrix, false>(*this), Matrix_leaf<Matrix<T2, M2>, false>(other)));
+            return *this;
+        } else {
+            return operator+=(-other);
+        }
+    }
+
+    /// Оператор сложения с выражением
+    template <class E>
+    Matrix& operator+= (const Matrix_expr<E>& expr) {
+        return update_by_expr<false>(expr.self());
+    }
+
+    /// Оператор вычитания выражения
+    template <class E>
+    Matrix& operator-= (const Matrix_expr<E>& expr) {
+        return update_by_expr<true>(expr.self());
     }
 
     /// Оператор умножения
     template<class T2, template <class...> class M2>
-    Matrix operator*= (const Matrix<T2, M2>& other) {
+    Matrix& operator*= (const Matrix<T2, M2>& other) {
+        return multiply(other, Matrix_execution::sequential());
+    }
+
+    /**
+        \brief Умножение с выбором политики выполнения
+
+        Строки результата считаются по Густавсону: проход только по
+        ненулевым элементам A(i, s) и строкам B(s, *). При параллельном
+        выполнении строки делятся на части, у каждой части свой аккумулятор
+        и буфер результата. При eps = 0 результат полный, как при прямом
+        вычислении: считаются все строки, а незатронутые ячейки хранятся
+        нулями.
+    */
+    template<class T2, template <class...> class M2>
+    Matrix& multiply(const Matrix<T2, M2>& other, const Matrix_execution& policy) {
         if (cols_num_ != other.get_rows_num()) {
             throw multiplication_error("multiplication failed", *this, other);
         }
-        Matrix res(rows_num_, other.get_cols_num(), eps_);
-        for (int i = 1; i <= rows_num_; ++i) {
-            for (int j = 1; j <= other.get_cols_num(); ++j) {
-                T cur_res = 0;
-                for (int s = 1; s <= cols_num_; ++s) {
-                    cur_res += (operator()(i, s) * other(s, j));
+        const auto& other_map = other.get_map();
+        delete_zeros();
+        hash_valid_ = false;
+        if constexpr (std::is_same_v<T, double> && std::is_same_v<T2, double>) {
+            // оба множителя сейчас плотные: блочное умножение, части - полосы строк
+            const auto* ld = storage_dense(static_cast<const storage_type&>(map_));
+            const auto* rd = storage_dense(other_map);
+            if (ld && rd) {
+                dense_map<unsigned, dense_map<unsigned, double>> prod;
+                prod.resize(rows_num_, other.get_cols_num());
+                policy.for_parts(rows_num_, [&](unsigned, std::size_t begin, std::size_t end) {
+                    dense_gemm(ld->data() + begin * ld->stride(), ld->stride(),
+                        rd->data(), rd->stride(),
+                        prod.data() + begin * prod.stride(), prod.stride(),
+                        end - begin, other.get_cols_num(), cols_num_);
+                });
+                if (!(0 < eps_)) {
+                    // при eps = 0 результат полный, как у разреженного пути
+                    prod.mark_all();
+                }
+                storage_assign_dense(map_, std::move(prod));
+                cols_num_ = other.get_cols_num();
+                dirty_ = true;
+                delete_zeros();
+                storage_adapt(map_, rows_num_, cols_num_);
+                return *this;
+            }
+        }
+        storage_type res;
+        storage_resize(res, rows_num_, other.get_cols_num());
+        auto multiply_row = [&](Matrix_accumulator<T>& acc, const auto& row) {
+            for (const auto& [s, elem] : row) {
+                auto other_row = other_map.find(s);
+                if (other_row == other_map.end()) {
+                    continue;
+                }
+                for (const auto& [j, other_elem] : other_row->second) {
+                    acc.add(j, elem * other_elem);
+                }
+            }
+        };
+        const bool full = !(0 < eps_);
+        // строка i по номеру (для полного результата, включая строки без элементов)
+        auto multiply_row_num = [&](Matrix_accumulator<T>& acc, unsigned i) {
+            const auto& map = map_;
+            if (auto row = map.find(i); row != map.end()) {
+                multiply_row(acc, row->second);
+            }
+        };
+        if (!policy.is_parallel()) {
+            Matrix_accumulator<T> acc(other.get_cols_num());
+            auto append = [&](unsigned i) {
+                acc.flush(eps_, [&](unsigned j, const T& value) {
+                    storage_append(res, i, j, value);
+                });
+            };
+            if (full) {
+                for (unsigned i = 1; i <= rows_num_; ++i) {
+                    multiply_row_num(acc, i);
+                    append(i);
+                }
+            } else {
+                for (const auto& [i, row] : map_) {
+                    multiply_row(acc, row);
+                    append(i);
+                }
+            }
+        } else {
+            auto rows = row_iterators();
+            std::size_t count = full ? rows_num_ : rows.size();
+            std::vector<std::vector<std::tuple<unsigned, unsigned, T>>> parts(policy.parts(count));
+            policy.for_parts(count, [&](unsigned part, std::size_t begin, std::size_t end) {
+                Matrix_accumulator<T> acc(other.get_cols_num());
+                for (auto k = begin; k < end; ++k) {
+                    unsigned i;
+                    if (full) {
+                        i = k + 1;
+                        multiply_row_num(acc, i);
+                    } else {
+                        auto& [row_num, row] = *rows[k];
+                        i = row_num;
+                        multiply_row(acc, row);
+                    }
+                    acc.flush(eps_, [&](unsigned j, const T& value) {
+                        parts[part].emplace_back(i, j, value);
+                    });
+                }
+            });
+            for (const auto& part : parts) {
+                for (const auto& [i, j, value] : part) {
+                    storage_append(res, i, j, value);
                 }
-                res[std::make_pair(i, j)] = cur_res;
             }
         }
-        map_ = res.map_;
-        rows_num_ = res.rows_num_;
-        cols_num_ = res.cols_num_;
+        map_ = std::move(res);
+        cols_num_ = other.get_cols_num();
+        storage_adapt(map_, rows_num_, cols_num_);
         return *this;
     }
 
     /// Оператор умножения на число
-    Matrix operator*= (double k) {
-        for (auto& [row_num, row] : map_) {
-            for (auto& [col_num, elem] : row) {
-                operator[](std::make_pair(row_num, col_num)) *= k;
-            }
+    Matrix& operator*= (double k) {
+        for (auto&& elem : nonzeros()) {
+            elem.value *= k;
         }
+        delete_zeros();
+        storage_adapt(map_, rows_num_, cols_num_);
         return *this;
     }
 
-    /// Оператор сложения
+    /// Оператор умножения
     template<class T2, template <class...> class M2>
-    friend Matrix operator+ (Matrix lhs, const Matrix<T2, M2>& rhs) {
-        return lhs += rhs;
+    friend Matrix operator* (Matrix lhs, const Matrix<T2, M2>& rhs) {
+        lhs *= rhs;
+        return lhs;
     }
 
-    /// Оператор вычитания
-    template<class T2, template <class...> class M2>
-    friend Matrix operator- (Matrix lhs, const Matrix<T2, M2>& rhs) {
-        return lhs -= rhs;
+    /// Оператор получения контейнера элементов
+    const auto& get_map () const {
+        delete_zeros();
+        return map_;
     }
 
-    /// Оператор умножения
-    template<class T2, template <class...> class M2>
-    friend Matrix operator* (Matrix lhs, const Matrix<T2, M2>& rhs) {
-        return lhs *= rhs;
+    /**
+        \brief Метод настройки контейнера элементов
+
+        Функция получает контейнер по ссылке и может менять его настройки
+        (например, пороги hybrid_map), но не содержимое: кэш хэша и признак
+        нулей матрицы при этом не обновляются.
+    */
+    template <class F>
+    void configure_storage(F f) {
+        f(map_);
     }
 
-    /// Оператор умножения на число
-    friend Matrix operator* (Matrix lhs, double rhs) {
-        return lhs *= rhs;
+    /// Хранимые элементы (строка, столбец, значение) в порядке контейнера
+    Matrix_range<const_nonzero_iterator> nonzeros() const {
+        delete_zeros();
+        const auto& map = map_;
+        return {const_nonzero_iterator(map.begin(), map.end()), const_nonzero_iterator(map.end(), map.end())};
     }
 
-    /// Оператор получения контейнера элементов
-    const auto& get_map () const {
+    /**
+        \brief Хранимые элементы с изменением значений
+
+        Записанные через итератор нули удаляются при следующем обращении к
+        матрице. Ссылки на значения действительны до следующего обращения
+        к матрице: после него нули уже удалены, а хэш содержимого может
+        быть посчитан заново без учета записей через старые ссылки.
+    */
+    Matrix_range<nonzero_iterator> nonzeros() {
         delete_zeros();
-        return map_;
+        dirty_ = true;
+        hash_valid_ = false;
+        return {nonzero_iterator(map_.begin(), map_.end()), nonzero_iterator(map_.end(), map_.end())};
+    }
+
+    /// Хранимые элементы строки row_num
+    Matrix_range<const_nonzero_iterator> row_nonzeros(unsigned row_num) const {
+        if (row_num < 1 || row_num > rows_num_) {
+            throw invalid_index_error("invalid index", *this, {row_num, 1});
+        }
+        delete_zeros();
+        const auto& map = map_;
+        auto row = map.find(row_num);
+        auto next = row == map.end() ? row : std::next(row);
+        return {const_nonzero_iterator(row, next), const_nonzero_iterator(next, next)};
+    }
+
+    /// Хранимые элементы строки row_num с изменением значений (ссылки действительны, как для nonzeros())
+    Matrix_range<nonzero_iterator> row_nonzeros(unsigned row_num) {
+        if (row_num < 1 || row_num > rows_num_) {
+            throw invalid_index_error("invalid index", *this, {row_num, 1});
+        }
+        delete_zeros();
+        dirty_ = true;
+        hash_valid_ = false;
+        auto row = map_.find(row_num);
+        auto next = row == map_.end() ? row : std::next(row);
+        return {nonzero_iterator(row, next), nonzero_iterator(next, next)};
     }
 
     /// Оператор получения минимального модуля элемента
@@ -552,36 +1384,30 @@ public:
         return cols_num_;
     }
 
-    /// Оператор доступа к элементу
-    T& operator[] (std::pair<unsigned, unsigned> coord) {
-        if (coord.first < 1 || coord.first > rows_num_) {
-            throw invalid_index_error("invalid index", *this, coord);
-        }
-        if (coord.second < 1 || coord.second > cols_num_) {
-            throw invalid_index_error("invalid index", *this, coord);
-        }
-        delete_zeros();
-        if (map_.find(coord.first) == map_.end()) {
-            map_[coord.first] = {};
-        }
-        if (map_[coord.first].find(coord.second) == map_[coord.first].end()) {
-            map_[coord.first][coord.second] = 0;
-        }
-        return map_[coord.first][coord.second];
+    /**
+        \brief Оператор доступа к элементу
+
+        Возвращает не T&, а ссылку Matrix_element_ref: запись через нее сразу
+        удаляет ставшую нулем ячейку. Поэтому auto x = m[c] - это ссылка на
+        элемент, а не копия значения; копию дают T x = m[c] и m(i, j).
+        Запись в существующую ячейку csr_map - поиск по строке, а создание
+        и удаление ячейки сдвигают массивы (O(nnz)); для массовой записи
+        есть from_triplets.
+    */
+    Matrix_element_ref<T, M> operator[] (std::pair<unsigned, unsigned> coord) {
+        check_index(coord);
+        return Matrix_element_ref<T, M>(this, coord.first, coord.second);
+    }
+
+    /// Оператор чтения элемента константной матрицы (возвращает значение)
+    T operator[] (std::pair<unsigned, unsigned> coord) const {
+        check_index(coord);
+        return operator()(coord.first, coord.second);
     }
 
     /// Создание среза по Matrix_coords
     Matrix_proxy<T, M>* operator[] (const Matrix_coords& c) {
-        unsigned start_row = (c.is_all[0] ? 1 : c.index[0]);
-        unsigned end_row = (c.is_all[2] ? rows_num_ : c.index[2]);
-        unsigned start_col = (c.is_all[1] ? 1 : c.index[1]);
-        unsigned end_col = (c.is_all[3] ? cols_num_ : c.index[3]);
-        if (start_row > end_row || start_col > end_col) {
-            throw invalid_matrix_coords_error("start row or col are greater than end", *this, c);
-        }
-        if (start_row < 1 || end_row > rows_num_ || start_col < 1 || end_col > cols_num_) {
-            throw invalid_matrix_coords_error("index out of range", *this, c);
-        }
+        auto [start_row, end_row, start_col, end_col] = slice_bounds(c);
         auto res = new Matrix_proxy(this, start_row, end_row, start_col, end_col);
         proxy_.insert(res);
         return res;
@@ -597,6 +1423,38 @@ public:
         return operator[](Matrix_coords(-1, c.col_num, -1, c.col_num));
     }
 
+    /// Создание среза-представления по Matrix_coords
+    Matrix_view<T, M> view(const Matrix_coords& c) {
+        auto [start_row, end_row, start_col, end_col] = slice_bounds(c);
+        return Matrix_view<T, M>(this, start_row, end_row, start_col, end_col);
+    }
+
+    /// Создание среза-представления только для чтения по Matrix_coords
+    Matrix_const_view<T, M> view(const Matrix_coords& c) const {
+        auto [start_row, end_row, start_col, end_col] = slice_bounds(c);
+        return Matrix_const_view<T, M>(this, start_row, end_row, start_col, end_col);
+    }
+
+    /// Создание среза-представления строки
+    Matrix_view<T, M> view(const Matrix_row_coord& c) {
+        return view(Matrix_coords(c.row_num, -1, c.row_num, -1));
+    }
+
+    /// Создание среза-представления строки только для чтения
+    Matrix_const_view<T, M> view(const Matrix_row_coord& c) const {
+        return view(Matrix_coords(c.row_num, -1, c.row_num, -1));
+    }
+
+    /// Создание среза-представления столбца
+    Matrix_view<T, M> view(const Matrix_col_coord& c) {
+        return view(Matrix_coords(-1, c.col_num, -1, c.col_num));
+    }
+
+    /// Создание среза-представления столбца только для чтения
+    Matrix_const_view<T, M> view(const Matrix_col_coord& c) const {
+        return view(Matrix_coords(-1, c.col_num, -1, c.col_num));
+    }
+
     /// Оператор удаления среза
     void detach_proxy(const Matrix_proxy<T, M>* pr) const {
         proxy_.erase(pr);
@@ -611,61 +1469,102 @@ public:
             throw invalid_index_error("invalid index", *this, {row_num, col_num});
         }
         delete_zeros();
-        if (map_.find(row_num) == map_.end()) {
+        auto row = map_.find(row_num);
+        if (row == map_.end()) {
             return 0;
         }
-        if (map_[row_num].find(col_num) == map_[row_num].end()) {
+        auto elem = row->second.find(col_num);
+        if (elem == row->second.end()) {
             return 0;
         }
-        return map_[row_num][col_num];
+        return elem->second;
     }
 
-    /// Оператор удаления нулевых элементов
+    /**
+        \brief Оператор удаления нулевых элементов
+
+        Запись отдельных элементов (operator[], срезы-представления) сразу
+        удаляет ставшую нулем ячейку, поэтому элементы меньше eps могут
+        появиться только после массового изменения контейнера (тогда
+        выставлен dirty_). Полный проход выполняется только при dirty_.
+    */
     void delete_zeros() const {
-        using std::abs;
-        std::vector<std::pair<unsigned, unsigned>> to_delete;
-        for (auto& [row_num, row] : map_) {
-            for (auto& [col_num, elem] : row) {
-                if (abs(elem) < eps_) {
-                    to_delete.push_back({row_num, col_num});
-                }
-            }
+        if (!dirty_) {
+            return;
         }
-        for (const auto& [row_num, col_num] : to_delete) {
-            map_[row_num].erase(col_num);
-            if (map_[row_num].empty()) {
-                map_.erase(row_num);
+        storage_erase_if(map_, [this](const T& elem) {
+            using std::abs;
+            return abs(elem) < eps_;
+        });
+        dirty_ = false;
+        hash_valid_ = false;
+    }
+
+    /**
+        \brief Хэш содержимого
+
+        Сумма хэшей хранимых элементов (строка, столбец, значение), поэтому
+        не зависит от порядка обхода контейнера и размеров матрицы (как и
+        operator==). Считается при первом вызове за O(nnz), затем
+        поддерживается при записи отдельных элементов (operator[], срезы-представления);
+        массовые операции сбрасывают его до следующего вызова.
+    */
+    std::size_t content_hash() const {
+        static_assert(is_matrix_hashable<T>::value, "std::hash is not defined for matrix elements");
+        delete_zeros();
+        if (!hash_valid_) {
+            hash_ = 0;
+            for (const auto& elem : nonzeros()) {
+                hash_ += entry_hash(elem.row, elem.col, elem.value);
             }
+            hash_valid_ = true;
         }
+        return std::size_t(matrix_hash_mix(hash_));
     }
 
-    /// Оператор равенства
+    /**
+        \brief Оператор равенства
+
+        Если у обеих матриц посчитан хэш содержимого, разные хэши дают
+        ответ за O(1). Иначе упорядоченные контейнеры сравниваются одним
+        совместным проходом по хранимым элементам, остальные - поиском
+        каждого элемента lhs в контейнере rhs после сравнения количества
+        элементов.
+    */
     friend bool operator== (const Matrix& lhs, const Matrix& rhs) {
-        lhs.delete_zeros();
-        long long l_size = 0;
-        for (const auto& [_, row] : lhs.map_) {
-            for (const auto& [_, elem] : row) {
-                l_size += 1;
-            }
-        }
-        rhs.delete_zeros();
-        long long r_size = 0;
-        for (const auto& [_, row] : rhs.map_) {
-            for (const auto& [_, elem] : row) {
-                r_size += 1;
-            }
+        if (&lhs == &rhs) {
+            return true;
         }
-        if (l_size != r_size) {
+        auto l = lhs.nonzeros();
+        auto r = rhs.nonzeros();
+        if (lhs.hash_valid_ && rhs.hash_valid_ && lhs.hash_ != rhs.hash_) {
             return false;
         }
-        for (auto& [row_num, row] : lhs.map_) {
-            for (auto& [col_num, elem] : row) {
-                if (rhs(row_num, col_num) != elem) {
+        if constexpr (is_ordered_storage<storage_type>::value) {
+            auto r_it = r.begin();
+            for (const auto& elem : l) {
+                if (r_it == r.end() || r_it->row != elem.row || r_it->col != elem.col || r_it->value != elem.value) {
+                    return false;
+                }
+                ++r_it;
+            }
+            return r_it == r.end();
+        } else {
+            if (std::distance(l.begin(), l.end()) != std::distance(r.begin(), r.end())) {
+                return false;
+            }
+            for (const auto& elem : l) {
+                auto row = rhs.map_.find(elem.row);
+                if (row == rhs.map_.end()) {
+                    return false;
+                }
+                auto other = row->second.find(elem.col);
+                if (other == row->second.end() || other->second != elem.value) {
                     return false;
                 }
             }
+            return true;
         }
-        return true;
     }
 
     /// Оператор неравенства
@@ -674,139 +1573,1517 @@ public:
     }
 
 protected:
-    /// Контейнер элементов
-    mutable M<unsigned, M<unsigned, T>> map_;
+    template <class T2, template <class...> class M2, bool Const>
+    friend class basic_matrix_view;
 
-    /// Минимальный модуль элемента
-    double eps_;
+    friend class Matrix_element_ref<T, M>;
 
-    /// Количество строк
-    unsigned rows_num_;
+    /// Проверка координат элемента
+    void check_index(std::pair<unsigned, unsigned> coord) const {
+        if (coord.first < 1 || coord.first > rows_num_) {
+            throw invalid_index_error("invalid index", *this, coord);
+        }
+        if (coord.second < 1 || coord.second > cols_num_) {
+            throw invalid_index_error("invalid index", *this, coord);
+        }
+    }
 
-    /// Количество столбцов
-    unsigned cols_num_;
+    /// Границы среза (начальная строка, конечная строка, начальный столбец, конечный столбец)
+    std::tuple<unsigned, unsigned, unsigned, unsigned> slice_bounds(const Matrix_coords& c) const {
+        unsigned start_row = (c.is_all[0] ? 1 : c.index[0]);
+        unsigned end_row = (c.is_all[2] ? rows_num_ : c.index[2]);
+        unsigned start_col = (c.is_all[1] ? 1 : c.index[1]);
+        unsigned end_col = (c.is_all[3] ? cols_num_ : c.index[3]);
+        if (start_row > end_row || start_col > end_col) {
+            throw invalid_matrix_coords_error("start row or col are greater than end", *this, c);
+        }
+        if (start_row < 1 || end_row > rows_num_ || start_col < 1 || end_col > cols_num_) {
+            throw invalid_matrix_coords_error("index out of range", *this, c);
+        }
+        return {start_row, end_row, start_col, end_col};
+    }
 
-    /// Сделанные срезы
-    mutable std::set<const Matrix_proxy<T, M>*> proxy_;
-};
+    /// Заполнение матрицы блоком другого контейнера (обходятся только элементы блока)
+    template <class C>
+    void assign_block(const C& map, unsigned start_row, unsigned end_row, unsigned start_col, unsigned end_col) {
+        rows_num_ = end_row - start_row + 1;
+        cols_num_ = end_col - start_col + 1;
+        Triplet_builder<T> builder(rows_num_);
+        storage_for_each_in(map, start_row, end_row, start_col, end_col,
+            [&](unsigned row_num, unsigned col_num, const auto& elem) {
+                builder.add(row_num - start_row + 1, col_num - start_col + 1, elem);
+            });
+        build(builder, triplet_duplicates::overwrite);
+    }
 
-/**
-    \brief Класс с тестами для класса Matrix
+    /**
+        \brief Транспонированный контейнер проходом подсчета по столбцам
 
-    Данный класс содержит тесты для класса Matrix.
-*/
-class MatrixTest {
-public:
-    void operator() () {
-        if (Matrix<int>::make_unary(2, 3, 0.5) != Matrix<int>({{1, {{1, 1}}}, {2, {{2, 1}}}}, 
-            2, 3, 0.5))
-        {
-            throw test_failed_error("unary test failed");
+        Первый проход считает элементы в каждом столбце, префиксные суммы
+        дают начало строки результата, второй проход раскладывает номера
+        строк и указатели на значения. Элементы упорядоченного контейнера
+        приходят по строкам, поэтому в каждой строке результата они уже
+        идут по возрастанию столбцов, и контейнер заполняется добавлением в
+        конец. Значения копируются один раз.
+    */
+    storage_type transposed_storage() const {
+        std::vector<std::size_t> start(std::size_t(cols_num_) + 2, 0);
+        for (const auto& elem : nonzeros()) {
+            ++start[elem.col + 1];
         }
-        if (Matrix<int>::make_ones(2, 1, 0.5) != Matrix<int>({{1, {{1, 1}}}, {2, {{1, 1}}}}, 
-            2, 1, 0.5))
-        {
-            throw test_failed_error("ones test failed");
+        for (unsigned c = 1; c <= cols_num_; ++c) {
+            start[c + 1] += start[c];
         }
-        if (Matrix<int>::make_zeros(5, 6, 0.5) != Matrix<int>({}, 
-            5, 6, 0.5))
-        {
-            throw test_failed_error("zeros test failed");
+        std::vector<unsigned> rows(start[cols_num_ + 1]);
+        std::vector<const T*> values(rows.size());
+        auto next = start;
+        for (const auto& elem : nonzeros()) {
+            auto pos = next[elem.col]++;
+            rows[pos] = elem.row;
+            values[pos] = &elem.value;
         }
-        if (Matrix<RationalNumber<int>>::from_file("matrix_sample_rat", 0.5) != Matrix<RationalNumber<int>>(
-            {
-                {1, {{1, RationalNumber(100)}}},
-                {6000, {{2, RationalNumber(23, 5)}}},
-                {7, {{1, RationalNumber(5, 3)}}},
-                {22, {{2, RationalNumber(44)}}}
-            }, 
-            50000, 6000, 0.5))
-        {
-            throw test_failed_error("from_file test failed");
+        storage_type res;
+        storage_resize(res, cols_num_, rows_num_);
+        storage_reserve(res, rows.size());
+        for (unsigned c = 1; c <= cols_num_; ++c) {
+            for (auto pos = start[c]; pos < start[c + 1]; ++pos) {
+                storage_append(res, c, rows[pos], *values[pos]);
+            }
         }
-        if (Matrix<int>::make_ones(2, 1, 0.5).to_file_string() != 
-            "matrix integer 2 1\n1 1 1\n2 1 1\n")
-        {
-            throw test_failed_error("to_file_string test failed");
+        return res;
+    }
+
+    /// Вклад элемента в хэш содержимого
+    static std::uint64_t entry_hash(unsigned row_num, unsigned col_num, const T& value) {
+        if constexpr (is_matrix_hashable<T>::value) {
+            return matrix_hash_mix(matrix_hash_mix((std::uint64_t(row_num) << 32) | col_num) ^ std::hash<T>{}(value));
+        } else {
+            return 0;
         }
-        if (~Matrix<int>({{1, {{2, 4}}}}, 3, 4, 0.5) != 
-            Matrix<int>({{2, {{1, 4}}}}, 4, 3, 0.5)) 
-        {
-            throw test_failed_error("transpose test failed");
+    }
+
+    /// Вклад хранимой ячейки в хэш содержимого (0, если ячейка не хранится)
+    std::uint64_t stored_hash(unsigned row_num, unsigned col_num) const {
+        auto row = map_.find(row_num);
+        if (row == map_.end()) {
+            return 0;
         }
-        if (-Matrix<int>({{1, {{2, 4}}}}, 3, 4, 0.5) != 
-            Matrix<int>({{1, {{2, -4}}}}, 3, 4, 0.5)) 
-        {
-            throw test_failed_error("minus test failed");
+        auto elem = row->second.find(col_num);
+        return elem == row->second.end() ? 0 : entry_hash(row_num, col_num, elem->second);
+    }
+
+    /**
+        \brief Изменение элемента с немедленным удалением нуля
+
+        Используется записью через operator[] и срезы-представления: ячейка,
+        ставшая меньше eps, удаляется сразу, поэтому полный проход
+        delete_zeros не нужен. f применяется к копии значения, так что
+        исключение из f не меняет ни матрицу, ни хэш.
+    */
+    template <class F>
+    void update_element(unsigned row_num, unsigned col_num, F f) {
+        using std::abs;
+        delete_zeros();
+        T value{};
+        bool stored = false;
+        const auto& map = map_;
+        if (auto row = map.find(row_num); row != map.end()) {
+            if (auto elem = row->second.find(col_num); elem != row->second.end()) {
+                value = elem->second;
+                stored = true;
+            }
         }
-        if (Matrix<int>({{1, {{1, 3}, {2, 4}}}}, 3, 4, 0.5) +
-            Matrix<int>({{1, {{2, 3}, {3, 4}}}}, 3, 4, 0.5) !=
-            Matrix<int>({{1, {{1, 3}, {2, 7}, {3, 4}}}}, 3, 4, 0.5))
-        {
-            throw test_failed_error("add test failed");
+        f(value);
+        auto old_hash = hash_valid_ ? stored_hash(row_num, col_num) : 0;
+        if (abs(value) < eps_) {
+            if (stored) {
+                auto&& row = map_[row_num];
+                row.erase(col_num);
+                if (row.empty()) {
+                    map_.erase(row_num);
+                }
+            }
+            hash_ -= old_hash;
+        } else {
+            auto new_hash = hash_valid_ ? entry_hash(row_num, col_num, value) : 0;
+            map_[row_num][col_num] = std::move(value);
+            hash_ += new_hash - old_hash;
         }
-        if (Matrix<int>({{1, {{1, 3}, {2, 4}}}}, 3, 4, 0.5) -
-            Matrix<int>({{1, {{2, 3}, {3, 4}}}}, 3, 4, 0.5) !=
-            Matrix<int>({{1, {{1, 3}, {2, 1}, {3, -4}}}}, 3, 4, 0.5))
-        {
-            throw test_failed_error("sub test failed");
+    }
+
+    /**
+        \brief Пакетная запись в блок
+
+        Значение каждой ячейки из elems заменяется на f(старое значение, t.value);
+        при clear остальные хранимые ячейки блока удаляются, а старые значения
+        ячеек блока считаются нулями. Ячейки меньше eps удаляются.
+
+        Если вставка в середину контейнера сдвигает массивы (storage_shifting),
+        контейнер пересобирается одним слиянием с отсортированными elems за
+        O(nnz + k log k) вместо O(nnz) на каждую ячейку; исключение из f
+        тогда оставляет матрицу без изменений. Иначе ячейки меняются по одной.
+    */
+    template <class F>
+    void update_block(unsigned start_row, unsigned end_row, unsigned start_col, unsigned end_col,
+        std::vector<matrix_triplet<T>> elems, bool clear, F f)
+    {
+        if (!storage_shifting(std::as_const(map_))) {
+            if (clear) {
+                erase_block(start_row, end_row, start_col, end_col);
+            }
+            for (const auto& t : elems) {
+                update_element(t.row, t.col, [&](T& elem) { f(elem, t.value); });
+            }
+            return;
         }
-        if (Matrix<int>({{1, {{1, 1}, {2, 2}}}, {2, {{1, 3}, {2, 4}}}}, 2, 2, 0.5) *
-            Matrix<int>({{1, {{1, 5}}}, {2, {{1, 6}}}}, 2, 1, 0.5) !=
-            Matrix<int>({{1, {{1, 17}}}, {2, {{1, 39}}}}, 2, 2, 0.5))
-        {
-            throw test_failed_error("mul test failed");
+        using std::abs;
+        delete_zeros();
+        std::sort(elems.begin(), elems.end(), [](const auto& lhs, const auto& rhs) {
+            return std::tie(lhs.row, lhs.col) < std::tie(rhs.row, rhs.col);
+        });
+        auto in_block = [&](unsigned row_num, unsigned col_num) {
+            return start_row <= row_num && row_num <= end_row && start_col <= col_num && col_num <= end_col;
+        };
+        storage_type res;
+        storage_resize(res, rows_num_, cols_num_);
+        auto next = elems.begin();
+        auto emit = [&](T value) {
+            f(value, next->value);
+            if (!(abs(value) < eps_)) {
+                storage_append(res, next->row, next->col, value);
+            }
+            ++next;
+        };
+        for (const auto& [row_num, row] : std::as_const(map_)) {
+            for (const auto& [col_num, elem] : row) {
+                while (next != elems.end() && std::tie(next->row, next->col) < std::tie(row_num, col_num)) {
+                    emit(T{});
+                }
+                bool erased = clear && in_block(row_num, col_num);
+                if (next != elems.end() && next->row == row_num && next->col == col_num) {
+                    emit(erased ? T{} : T(elem));
+                } else if (!erased) {
+                    storage_append(res, row_num, col_num, elem);
+                }
+            }
         }
-        if (Matrix<int>({{1, {{1, 1}, {2, 2}}}, {2, {{1, 3}, {2, 4}}}}, 2, 2, 0.5) * 3 !=
-            Matrix<int>({{1, {{1, 3}, {2, 6}}}, {2, {{1, 9}, {2, 12}}}}, 2, 2, 0.5))
-        {
-            throw test_failed_error("mul with num test failed");
+        while (next != elems.end()) {
+            emit(T{});
         }
-        auto test = Matrix<int>({{1, {{1, 1}, {2, 2}}}, {2, {{1, 3}, {2, 4}}}}, 2, 2, 0.5);
-        test[std::make_pair(1, 2)] = 8;
-        if (test(1, 2) != 8) {
-            throw test_failed_error("change elem test failed");
+        map_ = std::move(res);
+        hash_valid_ = false;
+        storage_adapt(map_, rows_num_, cols_num_);
+    }
+
+    /// Удаление хранимых элементов блока
+    void erase_block(unsigned start_row, unsigned end_row, unsigned start_col, unsigned end_col) {
+        if (storage_shifting(std::as_const(map_))) {
+            update_block(start_row, end_row, start_col, end_col, {}, true, [](T&, const T&) {});
+            return;
         }
-        auto test1 = Matrix<double>({{1, {{1, 1}, {2, 2}}}, {2, {{1, 3}, {2, 4}}}}, 2, 2, 0.5);
-        test1[std::make_pair(1, 2)] = 0.25;
-        if (test1(1, 2) != 0) {
-            throw test_failed_error("eps test failed");
+        delete_zeros();
+        std::vector<std::pair<unsigned, unsigned>> coords;
+        storage_for_each_in(std::as_const(map_), start_row, end_row, start_col, end_col,
+            [&](unsigned row_num, unsigned col_num, const auto&) {
+                coords.emplace_back(row_num, col_num);
+            });
+        for (const auto& [row_num, col_num] : coords) {
+            if (hash_valid_) {
+                hash_ -= stored_hash(row_num, col_num);
+            }
+            auto&& row = map_[row_num];
+            row.erase(col_num);
+            if (row.empty()) {
+                map_.erase(row_num);
+            }
         }
-        std::cout << "matrix tests completed" << std::endl;
     }
-};
-
-/// Класс среза
-template <class T, template <class...> class M>
-class Matrix_proxy {
-public:
-    /// Конструктор
-    Matrix_proxy(Matrix<T, M>* parent, unsigned start_row, unsigned end_row,
-        unsigned start_col, unsigned end_col) : parent_(parent),
-        start_row_(start_row), end_row_(end_row), start_col_(start_col), end_col_(end_col) {}
 
-    /// Деструктор
-    ~Matrix_proxy() {
-        parent_->detach_proxy(this);
+    /// Отсоединение всех срезов (они будут сообщать об удалении родителя)
+    void detach_proxies() {
+        for (const auto& pr : proxy_) {
+            pr->parent_deleted();
+        }
+        proxy_.clear();
     }
 
-    /// Метод удаления родителя
-    void parent_deleted() const {
-        parent_ = nullptr;
+    /// Приведение матрицы, из которой переместили содержимое, к пустой 0 x 0
+    void reset_moved() noexcept(nothrow_move) {
+        map_ = storage_type();
+        rows_num_ = 0;
+        cols_num_ = 0;
+        dirty_ = false;
+        hash_valid_ = false;
+        proxy_.clear();
     }
 
-    /// Метод константного доступа к элементу
-    T operator() (unsigned row_num, unsigned col_num) const {
-        if (parent_ == nullptr) {
-            throw parent_deleted_error("parent deleted");
-        }
-        if (row_num < 1 || row_num > (end_row_ - start_row_ + 1)) {
-            throw invalid_proxy_index_error("invalid row index", this, {row_num, col_num});
-        }
-        if (col_num < 1 || col_num > (end_col_ - start_col_ + 1)) {
-            throw invalid_proxy_index_error("invalid col index", this, {row_num, col_num});
+    /**
+        \brief Замена содержимого результатом выражения
+
+        Для упорядоченных контейнеров курсор выражения выдает элементы по
+        возрастанию (строка, столбец), и они сразу добавляются в новый
+        контейнер; промежуточные матрицы не строятся. Иначе выражение
+        вычисляется по операциям над матрицами.
+    */
+    template <class E>
+    void assign_expr(const E& expr) {
+        unsigned rows_num = expr.rows_num();
+        unsigned cols_num = expr.cols_num();
+        double eps = expr.eps();
+        storage_type res;
+        if constexpr (E::ordered) {
+            using std::abs;
+            storage_resize(res, rows_num, cols_num);
+            for (auto cur = expr.make_cursor(); cur.valid; cur.advance()) {
+                if (!(abs(cur.value) < eps)) {
+                    storage_append(res, cur.row, cur.col, cur.value);
+                }
+            }
+            dirty_ = false;
+        } else {
+            auto value = expr.materialize();
+            value.delete_zeros();
+            res = std::move(value.map_);
+            dirty_ = false;
         }
-        return (*parent_)(row_num - 1 + start_row_, col_num - 1 + start_col_);
+        map_ = std::move(res);
+        hash_valid_ = false;
+        rows_num_ = rows_num;
+        cols_num_ = cols_num;
+        eps_ = eps;
+        storage_adapt(map_, rows_num_, cols_num_);
+    }
+
+    /// Сложение или вычитание выражения одним проходом
+    template <bool Minus, class E>
+    Matrix& update_by_expr(const E& expr) {
+        if (rows_num_ != expr.rows_num() || cols_num_ != expr.cols_num()) {
+            throw size_differentiation_error("size differs", *this, expr.eval());
+        }
+        assign_expr(Matrix_sum<Matrix_leaf<Matrix, false>, E, Minus>(Matrix_leaf<Matrix, false>(*this), expr));
+        return *this;
+    }
+
+    /// Проверка позиции элемента, задаваемого тройкой
+    void check_triplet(unsigned row_num, unsigned col_num) const {
+        if (row_num < 1 || row_num > rows_num_) {
+            throw invalid_index_error("row num out of range", *this, {row_num, col_num});
+        }
+        if (col_num < 1 || col_num > cols_num_) {
+            throw invalid_index_error("col num out of range", *this, {row_num, col_num});
+        }
+    }
+
+    /// Заполнение контейнера из проверенных троек
+    void build(Triplet_builder<T>& triplets, triplet_duplicates mode) {
+        map_ = storage_type();
+        storage_resize(map_, rows_num_, cols_num_);
+        triplets.build(map_, eps_, mode);
+        dirty_ = false;
+        hash_valid_ = false;
+        storage_adapt(map_, rows_num_, cols_num_);
+    }
+
+    /// Массив итераторов на строки (для деления строк на части)
+    auto row_iterators() const {
+        std::vector<decltype(map_.begin())> rows;
+        for (auto it = map_.begin(); it != map_.end(); ++it) {
+            rows.push_back(it);
+        }
+        return rows;
+    }
+
+    /**
+        \brief Слияние строки при сложении
+
+        lrow и rrow - строки слагаемых (nullptr, если строки нет). Элементы
+        суммы по возрастанию столбцов передаются в out, кроме меньших eps.
+    */
+    template <class LRow, class RRow, class Out>
+    void merge_rows(unsigned row_num, const LRow* lrow, const RRow* rrow, Out out) const {
+        using std::abs;
+        auto append = [&](unsigned col_num, const T& value) {
+            if (!(abs(value) < eps_)) {
+                out(row_num, col_num, value);
+            }
+        };
+        if (rrow == nullptr) {
+            for (const auto& [col_num, num] : *lrow) {
+                append(col_num, num);
+            }
+            return;
+        }
+        if (lrow == nullptr) {
+            for (const auto& [col_num, num] : *rrow) {
+                T value = 0;
+                value += num;
+                append(col_num, value);
+            }
+            return;
+        }
+        auto li = lrow->begin();
+        auto ri = rrow->begin();
+        while (li != lrow->end() || ri != rrow->end()) {
+            if (ri == rrow->end() || (li != lrow->end() && li->first < ri->first)) {
+                append(li->first, li->second);
+                ++li;
+            } else if (li == lrow->end() || ri->first < li->first) {
+                T value = 0;
+                value += ri->second;
+                append(ri->first, value);
+                ++ri;
+            } else {
+                T value = li->second;
+                value += ri->second;
+                append(li->first, value);
+                ++li;
+                ++ri;
+            }
+        }
+    }
+
+    /// Контейнер элементов
+    mutable storage_type map_;
+
+    /// Минимальный модуль элемента
+    double eps_;
+
+    /// Количество строк
+    unsigned rows_num_;
+
+    /// Количество столбцов
+    unsigned cols_num_;
+
+    /// Признак возможного наличия нулевых элементов в любом месте контейнера
+    mutable bool dirty_ = false;
+
+    /// Хэш содержимого без перемешивания (сумма вкладов элементов)
+    mutable std::uint64_t hash_ = 0;
+
+    /// Признак актуальности hash_
+    mutable bool hash_valid_ = false;
+
+    /// Сделанные срезы
+    mutable std::set<const Matrix_proxy<T, M>*> proxy_;
+};
+
+/**
+    \brief Ссылка на элемент матрицы
+
+    Возвращается Matrix::operator[] вместо прежнего T&. Чтение возвращает
+    текущее значение элемента, запись сразу изменяет контейнер: ячейка,
+    ставшая меньше eps, удаляется, хэш содержимого обновляется по одной
+    ячейке. Поэтому одновременно можно держать любое число ссылок на разные
+    элементы. Ссылка, сохраненная через auto, продолжает видеть изменения
+    матрицы; для копии значения нужен явный тип (T x = m[c]).
+*/
+template <class T, template <class...> class M>
+class Matrix_element_ref {
+public:
+    /// Конструктор (координаты уже проверены)
+    Matrix_element_ref(Matrix<T, M>* parent, unsigned row_num, unsigned col_num) :
+        parent_(parent), row_num_(row_num), col_num_(col_num) {}
+
+    Matrix_element_ref(const Matrix_element_ref&) = default;
+
+    /// Значение элемента
+    operator T() const {
+        return (*parent_)(row_num_, col_num_);
+    }
+
+    /// Оператор присваивания значения
+    Matrix_element_ref& operator= (const T& value) {
+        parent_->update_element(row_num_, col_num_, [&](T& elem) { elem = value; });
+        return *this;
+    }
+
+    /// Оператор присваивания значения другого элемента
+    Matrix_element_ref& operator= (const Matrix_element_ref& other) {
+        return *this = T(other);
+    }
+
+    /// Оператор сложения с присваиванием
+    template <class V>
+    Matrix_element_ref& operator+= (const V& value) {
+        parent_->update_element(row_num_, col_num_, [&](T& elem) { elem += value; });
+        return *this;
+    }
+
+    /// Оператор вычитания с присваиванием
+    template <class V>
+    Matrix_element_ref& operator-= (const V& value) {
+        parent_->update_element(row_num_, col_num_, [&](T& elem) { elem -= value; });
+        return *this;
+    }
+
+    /// Оператор умножения с присваиванием
+    template <class V>
+    Matrix_element_ref& operator*= (const V& value) {
+        parent_->update_element(row_num_, col_num_, [&](T& elem) { elem *= value; });
+        return *this;
+    }
+
+    /// Оператор деления с присваиванием
+    template <class V>
+    Matrix_element_ref& operator/= (const V& value) {
+        parent_->update_element(row_num_, col_num_, [&](T& elem) { elem /= value; });
+        return *this;
+    }
+
+private:
+    /// Матрица элемента
+    Matrix<T, M>* parent_;
+
+    /// Номер строки
+    unsigned row_num_;
+
+    /// Номер столбца
+    unsigned col_num_;
+};
+
+namespace std {
+
+/// Хэш матрицы по содержимому (согласован с operator==)
+template <class T, template <class...> class M>
+struct hash<Matrix<T, M>> {
+    std::size_t operator() (const Matrix<T, M>& matr) const {
+        return matr.content_hash();
+    }
+};
+
+}
+
+/**
+    \brief Возведение квадратной матрицы в степень k
+
+    Возведение в квадрат: log2(k) квадратов и не больше log2(k) умножений
+    на накопленный результат вместо k - 1 умножений. Степень 0 дает
+    единичную матрицу.
+*/
+template <class T, template <class...> class M>
+Matrix<T, M> pow(const Matrix<T, M>& base, unsigned long long k,
+    const Matrix_execution& policy = Matrix_execution::sequential())
+{
+    if (base.get_rows_num() != base.get_cols_num()) {
+        throw multiplication_error("power of non-square matrix", base, base);
+    }
+    if (k == 0) {
+        return Matrix<T, M>::make_unary(base.get_rows_num(), base.get_cols_num(), base.get_eps());
+    }
+    std::optional<Matrix<T, M>> res;
+    Matrix<T, M> square = base;
+    while (true) {
+        if (k & 1) {
+            if (res) {
+                res->multiply(square, policy);
+            } else {
+                res = square;
+            }
+        }
+        k >>= 1;
+        if (k == 0) {
+            break;
+        }
+        auto next = square;
+        next.multiply(square, policy);
+        square = std::move(next);
+    }
+    return std::move(*res);
+}
+
+/**
+    \brief Произведение цепочки матриц с выбором порядка умножений
+
+    Порядок выбирается динамическим программированием по отрезкам
+    цепочки, как в задаче о расстановке скобок. Стоимость умножения
+    A (m x s) на B (s x n) оценивается числом умножений элементов алгоритма
+    Густавсона nnz(A) * nnz(B) / s плюс размером результата. Заполненность
+    результата оценивается в предположении равномерного распределения
+    элементов: ячейка ненулевая с вероятностью 1 - (1 - dA * dB)^s. Для
+    плотных матриц оценка совпадает с обычной m * s * n.
+
+    Матрицы хранятся по указателю и должны жить до вычисления.
+*/
+template <class T, template <class...> class M = std::map>
+class Matrix_chain {
+public:
+    Matrix_chain() = default;
+
+    /// Конструктор по списку матриц
+    Matrix_chain(std::initializer_list<std::reference_wrapper<const Matrix<T, M>>> matrices) {
+        for (const auto& matr : matrices) {
+            add(matr.get());
+        }
+    }
+
+    /// Метод добавления матрицы в конец цепочки
+    Matrix_chain& add(const Matrix<T, M>& matr) {
+        if (!items_.empty() && items_.back()->get_cols_num() != matr.get_rows_num()) {
+            throw multiplication_error("chain dimensions differ", *items_.back(), matr);
+        }
+        items_.push_back(&matr);
+        planned_ = false;
+        return *this;
+    }
+
+    std::size_t size() const { return items_.size(); }
+
+    /// Оценка стоимости выбранного порядка
+    double estimated_cost() const {
+        plan();
+        return items_.empty() ? 0 : cost_[0][items_.size() - 1];
+    }
+
+    /// Оценка числа элементов произведения
+    double estimated_nnz() const {
+        plan();
+        return items_.empty() ? 0 : nnz_[0][items_.size() - 1];
+    }
+
+    /// Выбранный порядок в виде скобок, например "((A1 A2) A3)"
+    std::string order() const {
+        plan();
+        return items_.empty() ? std::string() : order(0, items_.size() - 1);
+    }
+
+    /// Вычисление произведения в выбранном порядке
+    Matrix<T, M> evaluate(const Matrix_execution& policy = Matrix_execution::sequential()) const {
+        if (items_.empty()) {
+            throw empty_chain_error("empty matrix chain");
+        }
+        plan();
+        return evaluate(0, items_.size() - 1, policy);
+    }
+
+private:
+    /// Заполнение таблиц динамического программирования
+    void plan() const {
+        if (planned_) {
+            return;
+        }
+        std::size_t n = items_.size();
+        cost_.assign(n, std::vector<double>(n, 0));
+        nnz_.assign(n, std::vector<double>(n, 0));
+        split_.assign(n, std::vector<std::size_t>(n, 0));
+        for (std::size_t i = 0; i < n; ++i) {
+            auto range = items_[i]->nonzeros();
+            nnz_[i][i] = double(std::distance(range.begin(), range.end()));
+        }
+        for (std::size_t len = 2; len <= n; ++len) {
+            for (std::size_t i = 0; i + len <= n; ++i) {
+                std::size_t j = i + len - 1;
+                double rows_num = items_[i]->get_rows_num();
+                double cols_num = items_[j]->get_cols_num();
+                cost_[i][j] = std::numeric_limits<double>::infinity();
+                for (std::size_t k = i; k < j; ++k) {
+                    double inner = items_[k]->get_cols_num();
+                    double left = nnz_[i][k];
+                    double right = nnz_[k + 1][j];
+                    double product = estimate_nnz(rows_num, inner, cols_num, left, right);
+                    double cost = cost_[i][k] + cost_[k + 1][j] + left * right / std::max(inner, 1.0) + product;
+                    if (cost < cost_[i][j]) {
+                        cost_[i][j] = cost;
+                        nnz_[i][j] = product;
+                        split_[i][j] = k;
+                    }
+                }
+            }
+        }
+        planned_ = true;
+    }
+
+    /// Оценка заполненности произведения (m x s) * (s x n) по числу элементов сомножителей
+    static double estimate_nnz(double rows_num, double inner, double cols_num, double left, double right) {
+        if (rows_num == 0 || inner == 0 || cols_num == 0) {
+            return 0;
+        }
+        double p = (left / (rows_num * inner)) * (right / (inner * cols_num));
+        if (p >= 1) {
+            return rows_num * cols_num;
+        }
+        return -std::expm1(inner * std::log1p(-p)) * rows_num * cols_num;
+    }
+
+    std::string order(std::size_t i, std::size_t j) const {
+        if (i == j) {
+            return "A" + std::to_string(i + 1);
+        }
+        return "(" + order(i, split_[i][j]) + " " + order(split_[i][j] + 1, j) + ")";
+    }
+
+    Matrix<T, M> evaluate(std::size_t i, std::size_t j, const Matrix_execution& policy) const {
+        if (i == j) {
+            return *items_[i];
+        }
+        auto res = evaluate(i, split_[i][j], policy);
+        std::size_t k = split_[i][j] + 1;
+        if (k == j) {
+            res.multiply(*items_[k], policy);
+        } else {
+            res.multiply(evaluate(k, j, policy), policy);
+        }
+        return res;
+    }
+
+    std::vector<const Matrix<T, M>*> items_;
+    /// Оценка стоимости, числа элементов и точка разбиения отрезка [i, j]
+    mutable std::vector<std::vector<double>> cost_;
+    mutable std::vector<std::vector<double>> nnz_;
+    mutable std::vector<std::vector<std::size_t>> split_;
+    mutable bool planned_ = false;
+};
+
+/// Произведение цепочки матриц в порядке, выбранном Matrix_chain
+template <class T, template <class...> class M, class... Rest>
+Matrix<T, M> chain_product(const Matrix<T, M>& first, const Rest&... rest) {
+    return Matrix_chain<T, M>({std::cref(first), std::cref(rest)...}).evaluate();
+}
+
+/// Проверка размеров операндов сложения и вычитания
+template <class L, class R>
+void check_sum_operands(const L& lhs, const R& rhs) {
+    if (lhs.rows_num() != rhs.rows_num() || lhs.cols_num() != rhs.cols_num()) {
+        throw size_differentiation_error("size differs", lhs.eval(), rhs.eval());
+    }
+}
+
+/// Оператор сложения (ленивый, см. Matrix_expr)
+template <class L, class R, class = std::enable_if_t<is_matrix_operand_v<L> && is_matrix_operand_v<R>>>
+auto operator+ (L&& lhs, R&& rhs) {
+    auto l = make_matrix_operand(std::forward<L>(lhs));
+    auto r = make_matrix_operand(std::forward<R>(rhs));
+    check_sum_operands(l, r);
+    return Matrix_sum<decltype(l), decltype(r), false>(std::move(l), std::move(r));
+}
+
+/// Оператор вычитания (ленивый, см. Matrix_expr)
+template <class L, class R, class = std::enable_if_t<is_matrix_operand_v<L> && is_matrix_operand_v<R>>>
+auto operator- (L&& lhs, R&& rhs) {
+    auto l = make_matrix_operand(std::forward<L>(lhs));
+    auto r = make_matrix_operand(std::forward<R>(rhs));
+    check_sum_operands(l, r);
+    return Matrix_sum<decltype(l), decltype(r), true>(std::move(l), std::move(r));
+}
+
+/// Оператор умножения на число (ленивый, см. Matrix_expr)
+template <class X, class = std::enable_if_t<is_matrix_operand_v<X>>>
+auto operator* (X&& lhs, double rhs) {
+    auto e = make_matrix_operand(std::forward<X>(lhs));
+    return Matrix_scaled<decltype(e)>(std::move(e), rhs);
+}
+
+/// Оператор умножения выражения на матрицу
+template <class E, class T2, template <class...> class M2>
+auto operator* (const Matrix_expr<E>& lhs, const Matrix<T2, M2>& rhs) {
+    auto res = lhs.eval();
+    res *= rhs;
+    return res;
+}
+
+/// Оператор умножения матрицы на выражение
+template <class T, template <class...> class M, class E>
+Matrix<T, M> operator* (Matrix<T, M> lhs, const Matrix_expr<E>& rhs) {
+    lhs *= rhs.eval();
+    return lhs;
+}
+
+/**
+    \brief Класс с тестами для класса Matrix
+
+    Данный класс содержит тесты для класса Matrix.
+*/
+class MatrixTest {
+public:
+    void operator() () {
+        if (Matrix<int>::make_unary(2, 3, 0.5) != Matrix<int>({{1, {{1, 1}}}, {2, {{2, 1}}}}, 
+            2, 3, 0.5))
+        {
+            throw test_failed_error("unary test failed");
+        }
+        if (Matrix<int>::make_ones(2, 1, 0.5) != Matrix<int>({{1, {{1, 1}}}, {2, {{1, 1}}}}, 
+            2, 1, 0.5))
+        {
+            throw test_failed_error("ones test failed");
+        }
+        if (Matrix<int>::make_zeros(5, 6, 0.5) != Matrix<int>({}, 
+            5, 6, 0.5))
+        {
+            throw test_failed_error("zeros test failed");
+        }
+        if (Matrix<RationalNumber<int>>::from_file("matrix_sample_rat", 0.5) != Matrix<RationalNumber<int>>(
+            {
+                {1, {{1, RationalNumber(100)}}},
+                {6000, {{2, RationalNumber(23, 5)}}},
+                {7, {{1, RationalNumber(5, 3)}}},
+                {22, {{2, RationalNumber(44)}}}
+            }, 
+            50000, 6000, 0.5))
+        {
+            throw test_failed_error("from_file test failed");
+        }
+        {
+            // разбор без сортировки: повтор элемента перезаписывает значение
+            std::ofstream("matrix_test_tmp") << "# c\n\nmatrix rational 3 3\n3 3 <1/2>\r\n1 2 <-3/4> x\n3 3 <5>\n";
+            auto m = Matrix<RationalNumber<int>>::from_file("matrix_test_tmp", 0.5);
+            if (m(3, 3) != RationalNumber(5) || m(1, 2) != RationalNumber(-3, 4) || m(2, 2) != RationalNumber(0)) {
+                throw test_failed_error("from_file order test failed");
+            }
+            for (const char* bad : {"matrix rational 3 3\n1 2\n", "matrix rational 3 3\n1 a <1>\n",
+                "matrix rational 3 3\n4 1 <1>\n", "matrix rational 3 3\n1 4 <1>\n",
+                "matrix rational 3 3\n1 1 <1/0>\n", "matrix rational 3 3\n1 1 1\n",
+                "matrix integer 3 3\n", "matrix rational 3\n", "# empty\n"})
+            {
+                std::ofstream("matrix_test_tmp") << bad;
+                bool thrown = false;
+                try {
+                    Matrix<RationalNumber<int>>::from_file("matrix_test_tmp", 0.5);
+                } catch (file_invalid_error& ex) {
+                    thrown = true;
+                }
+                if (!thrown) {
+                    throw test_failed_error(std::string("from_file error test failed: ") + bad);
+                }
+            }
+            // при eps = 0 хранятся только записанные в файле элементы, включая нули
+            std::ofstream("matrix_test_tmp") << "matrix integer 2 2\n2 1 7\n1 1 5\n2 2 0\n";
+            if (Matrix<int>::from_file("matrix_test_tmp", 0).to_file_string() !=
+                "matrix integer 2 2\n1 1 5\n2 1 7\n2 2 0\n" ||
+                Matrix<int, dense_map>::from_file("matrix_test_tmp", 0).to_file_string() !=
+                "matrix integer 2 2\n1 1 5\n2 1 7\n2 2 0\n")
+            {
+                throw test_failed_error("from_file zero eps test failed");
+            }
+            std::remove("matrix_test_tmp");
+        }
+        {
+            // двоичный формат: запись, открытие без копирования, считывание
+            auto r = Matrix<RationalNumber<int>>::from_file("matrix_sample_rat", 0.5);
+            r.to_binary_file("matrix_test_tmp");
+            auto view = Matrix<RationalNumber<int>>::open_binary_file("matrix_test_tmp");
+            if (view.nnz() != 4 || view(6000, 2) != RationalNumber(23, 5) || view(6000, 1) != RationalNumber(0)) {
+                throw test_failed_error("binary view test failed");
+            }
+            if (Matrix<RationalNumber<int>>::from_binary_file("matrix_test_tmp", 0.5) != r) {
+                throw test_failed_error("binary rational test failed");
+            }
+            auto d = Matrix<double, csr_map>({{2, {{1, 0.5}, {3, -1.25}}}}, 2, 3, 1e-9);
+            d.to_binary_file("matrix_test_tmp");
+            if (Matrix<double, csr_map>::from_binary_file("matrix_test_tmp", 1e-9) != d) {
+                throw test_failed_error("binary float test failed");
+            }
+            bool thrown = false;
+            try {
+                Matrix<int>::open_binary_file("matrix_test_tmp");
+            } catch (file_invalid_error& ex) {
+                thrown = ex.file == "matrix_test_tmp";
+            }
+            if (!thrown) {
+                throw test_failed_error("binary type test failed");
+            }
+            std::ofstream("matrix_test_tmp", std::ios::app) << "x";
+            thrown = false;
+            try {
+                Matrix<double>::open_binary_file("matrix_test_tmp");
+            } catch (file_invalid_error& ex) {
+                thrown = true;
+            }
+            if (!thrown) {
+                throw test_failed_error("binary size test failed");
+            }
+            std::remove("matrix_test_tmp");
+        }
+        {
+            // неупорядоченные контейнеры записываются по (строка, столбец)
+            auto check_unordered = [](auto m, const char* name) {
+                using M = decltype(m);
+                unsigned seed = 11;
+                for (unsigned k = 0; k < 60; ++k) {
+                    seed = seed * 1103515245 + 12345;
+                    m[std::make_pair(seed % 40 + 1, (seed >> 12) % 40 + 1)] = int(seed % 9) + 1;
+                }
+                m[std::make_pair(1u, 4u)] = 3;
+                m[std::make_pair(1u, 2u)] = 5;
+                m.to_binary_file("matrix_test_tmp");
+                if (M::from_binary_file("matrix_test_tmp", 0.5) != m) {
+                    throw test_failed_error(std::string("binary ") + name + " round trip test failed");
+                }
+                auto view = M::open_binary_file("matrix_test_tmp");
+                for (unsigned i = 1; i <= 40; ++i) {
+                    for (unsigned j = 1; j <= 40; ++j) {
+                        if (view(i, j) != m(i, j)) {
+                            throw test_failed_error(std::string("binary ") + name + " view test failed");
+                        }
+                    }
+                }
+                std::remove("matrix_test_tmp");
+            };
+            check_unordered(Matrix<int, std::unordered_map>(40, 40, 0.5), "unordered");
+            check_unordered(Matrix<int, flat_hash_map>(40, 40, 0.5), "hash");
+        }
+        if (Matrix<int>::make_ones(2, 1, 0.5).to_file_string() != 
+            "matrix integer 2 1\n1 1 1\n2 1 1\n")
+        {
+            throw test_failed_error("to_file_string test failed");
+        }
+        {
+            // форматирование через to_chars совпадает с std::to_string
+            double values[] = {1e-7, -2.5e-7, 0.1, 1.0 / 3, -123456.7890125, 2.0000005, 1e20, 4.35e-4};
+            Matrix<double, csr_map> m(1, 8, 1e-12);
+            std::string expected = "matrix float 1 8\n";
+            for (unsigned j = 1; j <= 8; ++j) {
+                m[std::make_pair(1u, j)] = values[j - 1];
+                expected += "1 " + std::to_string(j) + " " + std::to_string(values[j - 1]) + "\n";
+            }
+            std::ostringstream out;
+            m.write_to(out);
+            if (out.str() != expected || m.to_file_string() != expected) {
+                throw test_failed_error("write_to test failed");
+            }
+        }
+        if (~Matrix<int>({{1, {{2, 4}}}}, 3, 4, 0.5) != 
+            Matrix<int>({{2, {{1, 4}}}}, 4, 3, 0.5)) 
+        {
+            throw test_failed_error("transpose test failed");
+        }
+        if (-Matrix<int>({{1, {{2, 4}}}}, 3, 4, 0.5) != 
+            Matrix<int>({{1, {{2, -4}}}}, 3, 4, 0.5)) 
+        {
+            throw test_failed_error("minus test failed");
+        }
+        if (Matrix<int>({{1, {{1, 3}, {2, 4}}}}, 3, 4, 0.5) +
+            Matrix<int>({{1, {{2, 3}, {3, 4}}}}, 3, 4, 0.5) !=
+            Matrix<int>({{1, {{1, 3}, {2, 7}, {3, 4}}}}, 3, 4, 0.5))
+        {
+            throw test_failed_error("add test failed");
+        }
+        if (Matrix<int>({{1, {{1, 3}, {2, 4}}}}, 3, 4, 0.5) -
+            Matrix<int>({{1, {{2, 3}, {3, 4}}}}, 3, 4, 0.5) !=
+            Matrix<int>({{1, {{1, 3}, {2, 1}, {3, -4}}}}, 3, 4, 0.5))
+        {
+            throw test_failed_error("sub test failed");
+        }
+        if (Matrix<int>({{1, {{1, 1}, {2, 2}}}, {2, {{1, 3}, {2, 4}}}}, 2, 2, 0.5) *
+            Matrix<int>({{1, {{1, 5}}}, {2, {{1, 6}}}}, 2, 1, 0.5) !=
+            Matrix<int>({{1, {{1, 17}}}, {2, {{1, 39}}}}, 2, 2, 0.5))
+        {
+            throw test_failed_error("mul test failed");
+        }
+        if ((Matrix<int>({{1, {{1, 1}, {2, 1}}}, {2, {{1, 2}}}}, 2, 2, 0.5) *
+            Matrix<int>({{1, {{1, 1}, {2, 3}}}, {2, {{1, -1}}}}, 2, 2, 0.5)).to_file_string() !=
+            "matrix integer 2 2\n1 2 3\n2 1 2\n2 2 6\n")
+        {
+            throw test_failed_error("sparse mul test failed");
+        }
+        if (Matrix<int>({{1, {{1, 1}, {2, 2}}}, {2, {{1, 3}, {2, 4}}}}, 2, 2, 0.5) * 3 !=
+            Matrix<int>({{1, {{1, 3}, {2, 6}}}, {2, {{1, 9}, {2, 12}}}}, 2, 2, 0.5))
+        {
+            throw test_failed_error("mul with num test failed");
+        }
+        auto test = Matrix<int>({{1, {{1, 1}, {2, 2}}}, {2, {{1, 3}, {2, 4}}}}, 2, 2, 0.5);
+        test[std::make_pair(1, 2)] = 8;
+        if (test(1, 2) != 8) {
+            throw test_failed_error("change elem test failed");
+        }
+        auto test1 = Matrix<double>({{1, {{1, 1}, {2, 2}}}, {2, {{1, 3}, {2, 4}}}}, 2, 2, 0.5);
+        test1[std::make_pair(1, 2)] = 0.25;
+        if (test1(1, 2) != 0) {
+            throw test_failed_error("eps test failed");
+        }
+        test1[std::make_pair(2, 1)] = 0.25;
+        test1[std::make_pair(2, 2)] = 0.1;
+        if (test1.to_file_string() != "matrix float 2 2\n1 1 1.000000\n") {
+            throw test_failed_error("lazy eps test failed");
+        }
+        {
+            // запись через несколько удерживаемых ссылок
+            Matrix<int> x({{1, {{1, 1}}}}, 2, 2, 0.5);
+            auto a = x[std::make_pair(1, 1)];
+            auto b = x[std::make_pair(1, 2)];
+            a = 0;
+            b = 2;
+            b += 1;
+            if (x.to_file_string() != "matrix integer 2 2\n1 2 3\n" || x != Matrix<int>({{1, {{2, 3}}}}, 2, 2, 0.5)) {
+                throw test_failed_error("retained element refs test failed");
+            }
+            b -= 3;
+            if (x.to_file_string() != "matrix integer 2 2\n" || int(a) != 0 || int(b) != 0) {
+                throw test_failed_error("retained element refs erase test failed");
+            }
+            // явный тип и константная матрица дают копию значения
+            x[std::make_pair(2, 2)] = 4;
+            int copy = x[std::make_pair(2, 2)];
+            auto read = std::as_const(x)[std::make_pair(2, 2)];
+            static_assert(std::is_same_v<decltype(read), int>);
+            x[std::make_pair(2, 2)] = 7;
+            if (copy != 4 || read != 4 || std::as_const(x)[std::make_pair(2, 2)] != 7) {
+                throw test_failed_error("element value copy test failed");
+            }
+        }
+        if (Matrix<int>::make_zeros(2, 2, 1e-11).to_file_string() != "matrix integer 2 2\n") {
+            throw test_failed_error("dirty eps test failed");
+        }
+        {
+            std::vector<std::tuple<unsigned, unsigned, double>> coo = {
+                {2, 3, 1.5}, {1, 2, 2}, {2, 3, 1}, {1, 1, 0.25}, {1, 2, -2}, {2, 1, 4},
+            };
+            if (Matrix<double>::from_triplets(coo, 2, 3, 0.5).to_file_string() !=
+                "matrix float 2 3\n2 1 4.000000\n2 3 2.500000\n")
+            {
+                throw test_failed_error("triplets sum test failed");
+            }
+            auto csr = Matrix<double, csr_map>::from_triplets(coo, 2, 3, 0.5, triplet_duplicates::overwrite);
+            if (csr.to_file_string() != "matrix float 2 3\n1 2 -2.000000\n2 1 4.000000\n2 3 1.000000\n") {
+                throw test_failed_error("triplets overwrite test failed");
+            }
+            coo.emplace_back(3, 1, 1);
+            bool thrown = false;
+            try {
+                Matrix<double>::from_triplets(coo, 2, 3, 0.5);
+            } catch (invalid_index_error<double, std::map>& ex) {
+                thrown = ex.index == std::make_pair(3u, 1u);
+            }
+            if (!thrown) {
+                throw test_failed_error("triplets index test failed");
+            }
+        }
+        std::cout << "matrix tests completed" << std::endl;
+    }
+};
+
+/**
+    \brief Класс с тестами для хранения в формате CSR
+
+    Данный класс сравнивает результаты операций над Matrix<T, csr_map>
+    с результатами для контейнера по умолчанию.
+*/
+class CsrTest {
+public:
+    void operator() () {
+        Matrix<int> a({{1, {{1, 1}, {3, 2}}}, {3, {{2, 3}}}}, 3, 3, 0.5);
+        Matrix<int> b({{1, {{2, 4}}}, {2, {{1, 5}, {3, 6}}}, {3, {{3, -2}}}}, 3, 3, 0.5);
+        Matrix<int, csr_map> ca({{3, {{2, 3}}}, {1, {{3, 2}, {1, 1}}}}, 3, 3, 0.5);
+        Matrix<int, csr_map> cb({{1, {{2, 4}}}, {2, {{1, 5}, {3, 6}}}, {3, {{3, -2}}}}, 3, 3, 0.5);
+        if (ca.to_file_string() != a.to_file_string()) {
+            throw test_failed_error("csr construct test failed");
+        }
+        if (ca(1, 3) != 2 || ca(2, 2) != 0 || ca(3, 2) != 3) {
+            throw test_failed_error("csr elem test failed");
+        }
+        if ((ca + cb).to_file_string() != (a + b).to_file_string()) {
+            throw test_failed_error("csr add test failed");
+        }
+        if ((ca - ca).to_file_string() != "matrix integer 3 3\n") {
+            throw test_failed_error("csr sub test failed");
+        }
+        if ((ca * cb).to_file_string() != (a * b).to_file_string()) {
+            throw test_failed_error("csr mul test failed");
+        }
+        if ((~ca).to_file_string() != (~a).to_file_string()) {
+            throw test_failed_error("csr transpose test failed");
+        }
+        if ((a + ca).to_file_string() != (a * 2).to_file_string()) {
+            throw test_failed_error("csr mixed add test failed");
+        }
+        ca[std::make_pair(2, 2)] = 7;
+        ca[std::make_pair(1, 1)] = 0;
+        if (ca(2, 2) != 7 || ca(1, 1) != 0 || ca.to_file_string() !=
+            "matrix integer 3 3\n1 3 2\n2 2 7\n3 2 3\n")
+        {
+            throw test_failed_error("csr change elem test failed");
+        }
+        auto cd = Matrix<double, csr_map>::make_unary(3, 3, 0.5) * 0.25;
+        if (cd.to_file_string() != "matrix float 3 3\n") {
+            throw test_failed_error("csr eps test failed");
+        }
+        std::cout << "csr tests completed" << std::endl;
+    }
+};
+
+/**
+    \brief Класс с тестами для параллельного выполнения
+
+    Данный класс проверяет, что результаты операций при параллельном
+    выполнении совпадают с последовательными.
+*/
+class ParallelTest {
+public:
+    template <class T, template <class...> class M>
+    static Matrix<T, M> sample(unsigned n, unsigned seed) {
+        Matrix<T, M> res(n, n, 0.5);
+        for (unsigned k = 0; k < 4 * n; ++k) {
+            seed = seed * 1103515245 + 12345;
+            unsigned i = seed % n + 1;
+            unsigned j = (seed / n) % n + 1;
+            res[std::make_pair(i, j)] = T(int(seed % 7)) / T(int(seed % 3) + 1);
+        }
+        return res;
+    }
+
+    template <class T, template <class...> class M>
+    static void check(const std::string& name) {
+        auto a = sample<T, M>(40, 1);
+        auto b = sample<T, M>(40, 2);
+        auto policy = Matrix_execution::parallel(4);
+        auto mul = a;
+        mul.multiply(b, policy);
+        if (mul != a * b || mul.to_file_string() != (a * b).to_file_string()) {
+            throw test_failed_error(name + " parallel mul test failed");
+        }
+        auto add = a;
+        add.add(b, policy);
+        if (add != a + b || add.to_file_string() != (a + b).to_file_string()) {
+            throw test_failed_error(name + " parallel add test failed");
+        }
+        if (a.transpose(policy).to_file_string() != (~a).to_file_string()) {
+            throw test_failed_error(name + " parallel transpose test failed");
+        }
+    }
+
+    void operator() () {
+        check<int, std::map>("int");
+        check<RationalNumber<int>, std::map>("rational");
+        check<int, csr_map>("csr int");
+        check<int, flat_hash_map>("hash int");
+        {
+            // при eps = 0 произведение полное, как при прямом вычислении скалярных произведений
+            auto check_full = [](auto a, const auto& b, const std::string& name) {
+                auto par = a;
+                par.multiply(b, Matrix_execution::parallel(2));
+                a *= b;
+                const char* expected = "matrix integer 2 2\n1 1 6\n1 2 0\n2 1 0\n2 2 0\n";
+                if (a.to_file_string() != expected || par.to_file_string() != expected) {
+                    throw test_failed_error(name + " zero eps mul test failed");
+                }
+            };
+            check_full(Matrix<int>({{1, {{1, 2}}}}, 2, 3, 0), Matrix<int>({{1, {{1, 3}}}}, 3, 2, 0), "map");
+            check_full(Matrix<int, csr_map>({{1, {{1, 2}}}}, 2, 3, 0),
+                Matrix<int, csr_map>({{1, {{1, 3}}}}, 3, 2, 0), "csr");
+            check_full(Matrix<int, dense_map>({{1, {{1, 2}}}}, 2, 3, 0),
+                Matrix<int, dense_map>({{1, {{1, 3}}}}, 3, 2, 0), "dense");
+        }
+        {
+            // файл на несколько кусков: повторы, комментарии, строки не по порядку
+            std::string text = "# parallel\nmatrix integer 1000 1000\n";
+            unsigned seed = 3;
+            for (unsigned k = 0; k < 30000; ++k) {
+                seed = seed * 1103515245 + 12345;
+                text += std::to_string(seed % 1000 + 1) + " " + std::to_string((seed >> 10) % 1000 + 1) + " "
+                    + std::to_string(int(seed % 19) - 9) + (k % 100 == 0 ? "\n# comment\n" : "\n");
+            }
+            std::ofstream("matrix_test_tmp") << text;
+            auto seq = Matrix<int, csr_map>::from_file("matrix_test_tmp", 0.5);
+            auto par = Matrix<int, csr_map>::from_file("matrix_test_tmp", 0.5, Matrix_execution::parallel(4));
+            if (seq.to_file_string() != par.to_file_string()) {
+                throw test_failed_error("parallel from_file test failed");
+            }
+            auto middle = text.find('\n', text.size() / 2) + 1;
+            std::ofstream("matrix_test_tmp") << text.substr(0, middle) << "1 1001 1\n" << text.substr(middle);
+            bool thrown = false;
+            try {
+                Matrix<int>::from_file("matrix_test_tmp", 0.5, Matrix_execution::parallel(4));
+            } catch (file_invalid_error& ex) {
+                thrown = true;
+            }
+            if (!thrown) {
+                throw test_failed_error("parallel from_file error test failed");
+            }
+            std::remove("matrix_test_tmp");
+        }
+        std::cout << "parallel tests completed" << std::endl;
+    }
+};
+
+/**
+    \brief Класс с тестами для плотного хранения
+
+    Данный класс сравнивает операции над Matrix<double, dense_map> с
+    операциями над разреженными матрицами.
+*/
+class DenseTest {
+public:
+    template <template <class...> class M>
+    static Matrix<double, M> sample(unsigned rows_num, unsigned cols_num, unsigned seed) {
+        Matrix<double, M> res(rows_num, cols_num, 1e-12);
+        for (unsigned i = 1; i <= rows_num; ++i) {
+            for (unsigned j = 1; j <= cols_num; ++j) {
+                seed = seed * 1103515245 + 12345;
+                if (seed % 5 != 0) {
+                    res[std::make_pair(i, j)] = double(seed % 1000) / 100 - 5;
+                }
+            }
+        }
+        return res;
+    }
+
+    template <class A, class B>
+    static bool near(const A& a, const B& b) {
+        if (a.get_rows_num() != b.get_rows_num() || a.get_cols_num() != b.get_cols_num()) {
+            return false;
+        }
+        for (unsigned i = 1; i <= a.get_rows_num(); ++i) {
+            for (unsigned j = 1; j <= a.get_cols_num(); ++j) {
+                if (std::abs(a(i, j) - b(i, j)) > 1e-9) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void operator() () {
+        auto d = Matrix<double, dense_map>({{1, {{2, 1.5}}}, {3, {{1, -2}}}}, 3, 2, 0.5);
+        if (d(1, 2) != 1.5 || d(3, 1) != -2 || d(2, 2) != 0) {
+            throw test_failed_error("dense elem test failed");
+        }
+        if (d.to_file_string() != "matrix float 3 2\n1 2 1.500000\n3 1 -2.000000\n") {
+            throw test_failed_error("dense to_file_string test failed");
+        }
+        d[std::make_pair(2, 2)] = 0.25;
+        if (d(2, 2) != 0 || d.to_file_string() != "matrix float 3 2\n1 2 1.500000\n3 1 -2.000000\n") {
+            throw test_failed_error("dense eps test failed");
+        }
+        {
+            // при eps = 0 записанные нули хранятся, как в словарном контейнере
+            auto sz = Matrix<double>::make_zeros(2, 3, 0);
+            auto dz = Matrix<double, dense_map>::make_zeros(2, 3, 0);
+            sz[std::make_pair(1, 2)] = 4;
+            dz[std::make_pair(1, 2)] = 4;
+            if (dz.to_file_string() != sz.to_file_string() || (~dz).to_file_string() != (~sz).to_file_string()) {
+                throw test_failed_error("dense stored zeros test failed");
+            }
+            Matrix<double> se(3, 3, 0);
+            Matrix<double, dense_map> de(3, 3, 0);
+            se[std::make_pair(2, 3)] = 0;
+            de[std::make_pair(2, 3)] = 0;
+            se[std::make_pair(1, 1)] = 5;
+            de[std::make_pair(1, 1)] = 5;
+            se.transpose_in_place();
+            de.transpose_in_place();
+            if (de.to_file_string() != se.to_file_string() ||
+                de.to_file_string() != "matrix float 3 3\n1 1 5.000000\n3 2 0.000000\n")
+            {
+                throw test_failed_error("dense stored zero write test failed");
+            }
+        }
+        auto a = sample<dense_map>(37, 53, 1);
+        auto b = sample<dense_map>(53, 29, 2);
+        auto sa = sample<std::map>(37, 53, 1);
+        auto sb = sample<std::map>(53, 29, 2);
+        if (!near(a * b, sa * sb)) {
+            throw test_failed_error("dense mul test failed");
+        }
+        auto pa = a;
+        pa.multiply(b, Matrix_execution::parallel(3));
+        if (!near(pa, sa * sb)) {
+            throw test_failed_error("dense parallel mul test failed");
+        }
+        if (!near(sa * b, sa * sb) || !near(a * sb, sa * sb)) {
+            throw test_failed_error("dense mixed mul test failed");
+        }
+        {
+            // при eps = 0 блочное произведение хранит нули, как разреженное
+            auto dz = Matrix<double, dense_map>({{1, {{1, 2}}}}, 2, 3, 0);
+            dz *= Matrix<double, dense_map>({{1, {{1, 3}}}}, 3, 2, 0);
+            auto sz = Matrix<double>({{1, {{1, 2}}}}, 2, 3, 0);
+            sz *= Matrix<double>({{1, {{1, 3}}}}, 3, 2, 0);
+            if (sz.to_file_string() != "matrix float 2 2\n1 1 6.000000\n1 2 0.000000\n2 1 0.000000\n2 2 0.000000\n" ||
+                dz.to_file_string() != sz.to_file_string())
+            {
+                throw test_failed_error("dense zero eps mul test failed");
+            }
+        }
+        {
+            // порядок сложения в неупорядоченном контейнере другой: сравнение с допуском
+            auto ua = sample<std::unordered_map>(37, 53, 1);
+            auto ub = sample<std::unordered_map>(53, 29, 2);
+            auto up = ua;
+            up.multiply(ub, Matrix_execution::parallel(3));
+            if (!near(ua * ub, sa * sb) || !near(up, sa * sb)) {
+                throw test_failed_error("unordered double mul test failed");
+            }
+        }
+        if (!near(a + sa, sa * 2) || !near(sa + a, sa * 2)) {
+            throw test_failed_error("dense mixed add test failed");
+        }
+        if (!near(~a, ~sa) || !near(a - a, Matrix<double>(37, 53, 1e-12))) {
+            throw test_failed_error("dense transpose test failed");
+        }
+        {
+            // переносимое микроядро должно совпадать с векторным
+            alignas(64) double panel[3 * dense_gemm_nr];
+            double block[dense_gemm_mr * 3];
+            for (unsigned k = 0; k < 3 * dense_gemm_nr; ++k) {
+                panel[k] = k % 7 - 3;
+            }
+            for (unsigned k = 0; k < dense_gemm_mr * 3; ++k) {
+                block[k] = k % 5 - 2;
+            }
+            double tile[dense_gemm_mr * dense_gemm_nr];
+            double expected[dense_gemm_mr * dense_gemm_nr] = {};
+            dense_gemm_micro_scalar(3, block, 3, panel, tile);
+            for (unsigned r = 0; r < dense_gemm_mr; ++r) {
+                for (unsigned j = 0; j < dense_gemm_nr; ++j) {
+                    for (unsigned p = 0; p < 3; ++p) {
+                        expected[r * dense_gemm_nr + j] += block[r * 3 + p] * panel[p * dense_gemm_nr + j];
+                    }
+                }
+            }
+            if (!std::equal(tile, tile + dense_gemm_mr * dense_gemm_nr, expected)) {
+                throw test_failed_error("dense scalar kernel test failed");
+            }
+        }
+        std::cout << "dense tests completed" << std::endl;
+    }
+};
+
+/// Класс тестирования ленивых выражений
+class ExpressionTest {
+public:
+    template <template <class...> class M>
+    static void check(const std::string& name) {
+        auto a = ParallelTest::sample<int, M>(30, 1);
+        auto b = ParallelTest::sample<int, M>(30, 2);
+        auto c = ParallelTest::sample<int, M>(30, 3);
+        auto expected = a;
+        expected += b;
+        auto scaled = c;
+        scaled *= 2.0;
+        expected += -scaled;
+        auto expr = a + b - c * 2.0;
+        static_assert(std::is_base_of_v<Matrix_expr<decltype(expr)>, decltype(expr)>);
+        Matrix<int, M> res = expr;
+        if (res != expected || expr(3, 4) != expected(3, 4) || expr.to_file_string() != expected.to_file_string()) {
+            throw test_failed_error(name + " expression test failed");
+        }
+        res = res - res;
+        if (res.to_file_string() != "matrix integer 30 30\n") {
+            throw test_failed_error(name + " expression alias test failed");
+        }
+        auto upd = a;
+        upd -= b * 0.5 + c;
+        auto half = b;
+        half *= 0.5;
+        if (upd != a + -half - c) {
+            throw test_failed_error(name + " expression update test failed");
+        }
+        // eps применяется в каждом узле, как при вычислении по операциям
+        Matrix<double, M> d({{1, {{1, 0.6}}}, {2, {{2, 2.0}, {3, -0.9}}}}, 3, 3, 0.5);
+        auto eps_expr = d * 0.5 + d * 0.5;
+        Matrix<double, M> d_res = eps_expr;
+        if (d_res != Matrix<double, M>({{2, {{2, 2.0}}}}, 3, 3, 0.5) || eps_expr(1, 1) != 0 || eps_expr(2, 2) != 2.0) {
+            throw test_failed_error(name + " expression eps test failed");
+        }
+        auto eps_diff = d - d * 0.5 - d * 0.5;
+        if (Matrix<double, M>(eps_diff) != Matrix<double, M>({{1, {{1, 0.6}}}, {2, {{3, -0.9}}}}, 3, 3, 0.5)) {
+            throw test_failed_error(name + " expression eps diff test failed");
+        }
+    }
+
+    void operator() () {
+        check<std::map>("map");
+        check<csr_map>("csr");
+        check<std::unordered_map>("unordered");
+        check<flat_hash_map>("hash");
+        auto a = ParallelTest::sample<double, dense_map>(20, 1);
+        auto b = ParallelTest::sample<double, std::map>(20, 2);
+        if (!DenseTest::near(a - b * 0.5 + a, (a - b * 0.5).eval() + a)) {
+            throw test_failed_error("mixed expression test failed");
+        }
+        bool thrown = false;
+        try {
+            auto bad = a + Matrix<double>(20, 21, 0.5);
+            (void)bad;
+        } catch (size_differentiation_error<double, dense_map, double, std::map>& ex) {
+            thrown = true;
+        }
+        if (!thrown) {
+            throw test_failed_error("expression size test failed");
+        }
+        std::cout << "expression tests completed" << std::endl;
+    }
+};
+
+/// Класс тестирования гибридного хранения
+class HybridTest {
+public:
+    /// Трехдиагональная матрица n x n
+    template <template <class...> class M>
+    static Matrix<double, M> band(unsigned n) {
+        Matrix<double, M> res(n, n, 1e-12);
+        for (unsigned i = 1; i <= n; ++i) {
+            for (unsigned j = std::max(i, 2u) - 1; j <= std::min(i + 1, n); ++j) {
+                res[std::make_pair(i, j)] = i == j ? 0.5 : 0.25;
+            }
+        }
+        return res;
+    }
+
+    void operator() () {
+        auto h = band<hybrid_map>(40);
+        auto s = band<std::map>(40);
+        h.configure_storage([](auto& m) { m.set_thresholds({0.3, 0.1, 1024}); });
+        if (h.get_map().is_dense() || !DenseTest::near(h, s)) {
+            throw test_failed_error("hybrid sparse test failed");
+        }
+        for (int k = 0; k < 3; ++k) {
+            h *= h;
+            s *= s;
+        }
+        if (!h.get_map().is_dense() || h.get_map().stats().to_dense != 1 || !DenseTest::near(h, s)) {
+            throw test_failed_error("hybrid to dense test failed");
+        }
+        h *= h;
+        s *= s;
+        if (!DenseTest::near(h, s) || !DenseTest::near(~h, ~s) || !DenseTest::near(h + h, s + s)) {
+            throw test_failed_error("hybrid dense ops test failed");
+        }
+        auto stored = h.nonzeros();
+        if (h.get_map().nnz() != std::size_t(std::distance(stored.begin(), stored.end()))) {
+            throw test_failed_error("hybrid dense nnz test failed");
+        }
+        auto z = h;
+        z -= h;
+        if (z.get_map().is_dense() || z.get_map().nnz() != 0) {
+            throw test_failed_error("hybrid sparse result test failed");
+        }
+        h *= 1e-20;
+        if (h.get_map().is_dense() || h.get_map().stats().to_sparse != 1 || h.get_map().nnz() != 0) {
+            throw test_failed_error("hybrid to sparse test failed");
+        }
+        auto small = band<hybrid_map>(10);
+        small *= Matrix<double, hybrid_map>::make_ones(10, 10, 1e-12);
+        if (small.get_map().is_dense()) {
+            throw test_failed_error("hybrid min cells test failed");
+        }
+        // пороги и статистика у каждой матрицы свои
+        auto eager = band<hybrid_map>(40);
+        auto lazy = band<hybrid_map>(40);
+        eager.configure_storage([](auto& m) { m.set_thresholds({0.05, 0.01, 0}); });
+        lazy.configure_storage([](auto& m) { m.set_thresholds({0.9, 0.01, 0}); });
+        eager *= eager;
+        lazy *= lazy;
+        if (!eager.get_map().is_dense() || lazy.get_map().is_dense() ||
+            eager.get_map().stats().to_dense != 1 || lazy.get_map().stats().to_dense != 0 ||
+            lazy.get_map().thresholds().to_dense != 0.9)
+        {
+            throw test_failed_error("hybrid per matrix thresholds test failed");
+        }
+        std::cout << "hybrid tests completed" << std::endl;
+    }
+};
+
+/// Класс среза
+template <class T, template <class...> class M>
+class Matrix_proxy {
+public:
+    /// Конструктор
+    Matrix_proxy(Matrix<T, M>* parent, unsigned start_row, unsigned end_row,
+        unsigned start_col, unsigned end_col) : parent_(parent),
+        start_row_(start_row), end_row_(end_row), start_col_(start_col), end_col_(end_col) {}
+
+    /// Деструктор
+    ~Matrix_proxy() {
+        if (parent_ != nullptr) {
+            parent_->detach_proxy(this);
+        }
+    }
+
+    /// Метод удаления родителя
+    void parent_deleted() const {
+        parent_ = nullptr;
+    }
+
+    /// Метод смены родителя (содержимое родителя перемещено в другую матрицу)
+    void parent_moved(Matrix<T, M>* parent) const noexcept {
+        parent_ = parent;
+    }
+
+    /// Метод константного доступа к элементу
+    T operator() (unsigned row_num, unsigned col_num) const {
+        if (parent_ == nullptr) {
+            throw parent_deleted_error("parent deleted");
+        }
+        if (row_num < 1 || row_num > (end_row_ - start_row_ + 1)) {
+            throw invalid_proxy_index_error("invalid row index", this, {row_num, col_num});
+        }
+        if (col_num < 1 || col_num > (end_col_ - start_col_ + 1)) {
+            throw invalid_proxy_index_error("invalid col index", this, {row_num, col_num});
+        }
+        return (*parent_)(row_num - 1 + start_row_, col_num - 1 + start_col_);
+    }
+
+    /// Метод получения родителя
+    const Matrix<T, M>* get_parent() const {
+        return parent_;
+    }
+
+    /// Метод получения границ строк
+    std::pair<unsigned, unsigned> get_row_index() const {
+        return {start_row_, end_row_};
+    }
+
+    /// Метод получения границ столбцов
+    std::pair<unsigned, unsigned> get_col_index() const {
+        return {start_col_, end_col_};
+    }
+
+protected:
+    /// родитель
+    mutable Matrix<T, M>* parent_;
+    /// Границы среза
+    unsigned start_row_, end_row_, start_col_, end_col_;
+};
+
+/// Источник записи в срез-представление: матрица или срез-представление с тем же типом элементов
+template <class T, class Src>
+struct is_matrix_view_source : std::false_type {};
+
+template <class T, template <class...> class M>
+struct is_matrix_view_source<T, Matrix<T, M>> : std::true_type {};
+
+template <class T, template <class...> class M, bool Const>
+struct is_matrix_view_source<T, basic_matrix_view<T, M, Const>> : std::true_type {};
+
+template <class T, class Src>
+inline constexpr bool is_matrix_view_source_v = is_matrix_view_source<T, Src>::value;
+
+/**
+    \brief Срез-представление матрицы
+
+    В отличие от Matrix_proxy не выделяется в куче и не регистрируется в
+    родителе: это значение из указателя на матрицу и границ блока, поэтому
+    срез-представление не должно переживать родителя. Чтение обходит только
+    хранимые элементы блока (storage_for_each_in), запись идёт прямо в
+    родителя одним пакетом (update_block): на CSR это одно слияние, а не
+    сдвиг массивов на каждую ячейку. При Const == true запись запрещена.
+*/
+template <class T, template <class...> class M, bool Const>
+class basic_matrix_view {
+public:
+    using matrix_type = std::conditional_t<Const, const Matrix<T, M>, Matrix<T, M>>;
+
+    /// Конструктор
+    basic_matrix_view(matrix_type* parent, unsigned start_row, unsigned end_row,
+        unsigned start_col, unsigned end_col) : parent_(parent),
+        start_row_(start_row), end_row_(end_row), start_col_(start_col), end_col_(end_col) {}
+
+    /// Конструктор копирования
+    basic_matrix_view(const basic_matrix_view&) = default;
+
+    /// Преобразование в срез только для чтения
+    template <bool C = Const, class = std::enable_if_t<C>>
+    basic_matrix_view(const basic_matrix_view<T, M, false>& other) : parent_(other.parent_),
+        start_row_(other.start_row_), end_row_(other.end_row_),
+        start_col_(other.start_col_), end_col_(other.end_col_) {}
+
+    /// Оператор получения количества строк
+    unsigned get_rows_num() const {
+        return end_row_ - start_row_ + 1;
+    }
+
+    /// Оператор получения количества столбцов
+    unsigned get_cols_num() const {
+        return end_col_ - start_col_ + 1;
     }
 
     /// Метод получения родителя
@@ -814,21 +3091,381 @@ public:
         return parent_;
     }
 
-    /// Метод получения границ строк
-    std::pair<unsigned, unsigned> get_row_index() const {
-        return {start_row_, end_row_};
-    }
+    /// Метод получения границ строк
+    std::pair<unsigned, unsigned> get_row_index() const {
+        return {start_row_, end_row_};
+    }
+
+    /// Метод получения границ столбцов
+    std::pair<unsigned, unsigned> get_col_index() const {
+        return {start_col_, end_col_};
+    }
+
+    /// Метод константного доступа к элементу
+    T operator() (unsigned row_num, unsigned col_num) const {
+        check_index(row_num, col_num);
+        return (*parent_)(row_num - 1 + start_row_, col_num - 1 + start_col_);
+    }
+
+    /// Обход хранимых элементов среза: f(строка, столбец, значение) в координатах среза
+    template <class F>
+    void for_each(F f) const {
+        storage_for_each_in(parent_->get_map(), start_row_, end_row_, start_col_, end_col_,
+            [&](unsigned row_num, unsigned col_num, const T& elem) {
+                f(row_num - start_row_ + 1, col_num - start_col_ + 1, elem);
+            });
+    }
+
+    /// Количество хранимых элементов среза
+    std::size_t nnz() const {
+        std::size_t res = 0;
+        for_each([&](unsigned, unsigned, const T&) { ++res; });
+        return res;
+    }
+
+    /// Копирование среза в отдельную матрицу
+    Matrix<T, M> to_matrix() const {
+        return Matrix<T, M>(*this, parent_->get_eps());
+    }
+
+    /// Оператор доступа к элементу
+    template <bool C = Const, class = std::enable_if_t<!C>>
+    Matrix_element_ref<T, M> operator[] (std::pair<unsigned, unsigned> coord) {
+        check_index(coord.first, coord.second);
+        return (*parent_)[std::make_pair(coord.first - 1 + start_row_, coord.second - 1 + start_col_)];
+    }
+
+    /// Оператор присваивания (копирует содержимое, а не границы)
+    basic_matrix_view& operator= (const basic_matrix_view& other) {
+        static_assert(!Const, "assignment to const view");
+        assign(collect(other));
+        return *this;
+    }
+
+    /// Оператор присваивания среза
+    template <class Src, class = std::enable_if_t<!Const && is_matrix_view_source_v<T, Src>>>
+    basic_matrix_view& operator= (const Src& other) {
+        assign(collect(other));
+        return *this;
+    }
+
+    /// Оператор сложения с присваиванием
+    template <class Src, class = std::enable_if_t<!Const && is_matrix_view_source_v<T, Src>>>
+    basic_matrix_view& operator+= (const Src& other) {
+        parent_->update_block(start_row_, end_row_, start_col_, end_col_, collect(other), false,
+            [](T& elem, const T& value) { elem += value; });
+        return *this;
+    }
+
+    /// Оператор вычитания с присваиванием
+    template <class Src, class = std::enable_if_t<!Const && is_matrix_view_source_v<T, Src>>>
+    basic_matrix_view& operator-= (const Src& other) {
+        parent_->update_block(start_row_, end_row_, start_col_, end_col_, collect(other), false,
+            [](T& elem, const T& value) { elem -= value; });
+        return *this;
+    }
+
+    /// Оператор умножения на число с присваиванием
+    template <bool C = Const, class = std::enable_if_t<!C>>
+    basic_matrix_view& operator*= (const T& num) {
+        std::vector<matrix_triplet<T>> elems;
+        storage_for_each_in(std::as_const(*parent_).get_map(), start_row_, end_row_, start_col_, end_col_,
+            [&](unsigned row_num, unsigned col_num, const T& elem) {
+                elems.push_back({row_num, col_num, elem});
+            });
+        parent_->update_block(start_row_, end_row_, start_col_, end_col_, std::move(elems), false,
+            [&](T& elem, const T&) { elem *= num; });
+        return *this;
+    }
+
+    /// Обнуление среза
+    template <bool C = Const, class = std::enable_if_t<!C>>
+    void clear() {
+        parent_->erase_block(start_row_, end_row_, start_col_, end_col_);
+    }
+
+protected:
+    template <class T2, template <class...> class M2, bool Const2>
+    friend class basic_matrix_view;
+
+    /// Проверка индекса в координатах среза
+    void check_index(unsigned row_num, unsigned col_num) const {
+        if (row_num < 1 || row_num > get_rows_num() || col_num < 1 || col_num > get_cols_num()) {
+            throw invalid_index_error("invalid view index", *parent_,
+                {row_num - 1 + start_row_, col_num - 1 + start_col_});
+        }
+    }
+
+    /**
+        \brief Хранимые элементы источника в координатах родителя
+
+        Элементы копируются до записи, поэтому источник может перекрываться
+        со срезом (например, быть срезом той же матрицы).
+    */
+    template <template <class...> class M2>
+    std::vector<matrix_triplet<T>> collect(const Matrix<T, M2>& other) const {
+        if (other.get_rows_num() != get_rows_num() || other.get_cols_num() != get_cols_num()) {
+            throw size_differentiation_error("size differs", to_matrix(), other);
+        }
+        std::vector<matrix_triplet<T>> res;
+        for (const auto& [row_num, row] : other.get_map()) {
+            for (const auto& [col_num, elem] : row) {
+                res.push_back({row_num - 1 + start_row_, col_num - 1 + start_col_, elem});
+            }
+        }
+        return res;
+    }
+
+    template <template <class...> class M2, bool Const2>
+    std::vector<matrix_triplet<T>> collect(const basic_matrix_view<T, M2, Const2>& other) const {
+        if (other.get_rows_num() != get_rows_num() || other.get_cols_num() != get_cols_num()) {
+            throw size_differentiation_error("size differs", to_matrix(), other.to_matrix());
+        }
+        std::vector<matrix_triplet<T>> res;
+        other.for_each([&](unsigned row_num, unsigned col_num, const T& elem) {
+            res.push_back({row_num - 1 + start_row_, col_num - 1 + start_col_, elem});
+        });
+        return res;
+    }
+
+    /// Замена содержимого среза
+    void assign(std::vector<matrix_triplet<T>> elems) {
+        parent_->update_block(start_row_, end_row_, start_col_, end_col_, std::move(elems), true,
+            [](T& elem, const T& value) { elem = value; });
+    }
+
+    /// родитель
+    matrix_type* parent_;
+    /// Границы среза
+    unsigned start_row_, end_row_, start_col_, end_col_;
+};
+
+/// Вложенный std::map, считающий копирования внешнего контейнера
+template <class K, class V>
+class copy_counting_map : public std::map<K, V> {
+public:
+    using std::map<K, V>::map;
+
+    copy_counting_map() = default;
+    copy_counting_map(copy_counting_map&&) = default;
+    copy_counting_map& operator= (copy_counting_map&&) = default;
+
+    copy_counting_map(const copy_counting_map& other) : std::map<K, V>(other) {
+        count();
+    }
+
+    copy_counting_map& operator= (const copy_counting_map& other) {
+        std::map<K, V>::operator=(other);
+        count();
+        return *this;
+    }
+
+    /// Количество копирований внешних контейнеров
+    static inline unsigned copies = 0;
+
+private:
+    static void count() {
+        if (!std::is_arithmetic_v<V> && !std::is_same_v<V, RationalNumber<int>>) {
+            ++copies;
+        }
+    }
+};
+
+/**
+    \brief Класс с тестами перемещения
+
+    Проверяет, что перемещение забирает контейнер, а не копирует его, и
+    что срезы переходят к новой матрице.
+*/
+class MoveTest {
+public:
+    void operator() () {
+        using counted = Matrix<int, copy_counting_map>;
+        auto a = ParallelTest::sample<int, copy_counting_map>(20, 1);
+        auto b = ParallelTest::sample<int, copy_counting_map>(20, 2);
+        copy_counting_map<unsigned, copy_counting_map<unsigned, int>>::copies = 0;
+        counted moved = std::move(a);
+        counted chain = moved * b * b * b * b;
+        counted sum = chain + b - moved * 2.0 + b * 3.0;
+        sum = chain * b;
+        sum = std::move(chain);
+        // копии - только левые операнды-lvalue умножений (передаются по значению):
+        // moved в первой цепочке и chain в предпоследней строке
+        if (copy_counting_map<unsigned, copy_counting_map<unsigned, int>>::copies != 2) {
+            throw test_failed_error("move copies test failed");
+        }
+        if (moved.get_rows_num() != 20 || a.get_rows_num() != 0 || !a.get_map().empty()) {
+            throw test_failed_error("moved-from test failed");
+        }
+        auto c = Matrix<int>({{1, {{1, 1}, {2, 2}}}, {2, {{2, 3}}}}, 2, 2, 0.5);
+        auto pr = c[Matrix_row_coord(2)];
+        Matrix<int> d = std::move(c);
+        if (pr->get_parent() != &d || (*pr)(1, 2) != 3) {
+            throw test_failed_error("move proxy test failed");
+        }
+        Matrix<int> e(1, 1, 0.5);
+        e = std::move(d);
+        if (pr->get_parent() != &e || (*pr)(1, 2) != 3) {
+            throw test_failed_error("move assign proxy test failed");
+        }
+        e = Matrix<int>(1, 1, 0.5);
+        if (pr->get_parent() != nullptr) {
+            throw test_failed_error("assign detach proxy test failed");
+        }
+        delete pr;
+        std::cout << "move tests completed" << std::endl;
+    }
+};
+
+/**
+    \brief Класс с тестами для матриц на узлах из арены
+
+    Данный класс содержит тесты для pool_map.
+*/
+class PoolTest {
+public:
+    void operator() () {
+        auto a = ParallelTest::sample<int, pool_map>(30, 1);
+        auto b = ParallelTest::sample<int, pool_map>(30, 2);
+        auto ma = ParallelTest::sample<int, std::map>(30, 1);
+        auto mb = ParallelTest::sample<int, std::map>(30, 2);
+        if ((a * b).to_file_string() != (ma * mb).to_file_string() ||
+            (a + b - a * 2.0).to_file_string() != (ma + mb - ma * 2.0).to_file_string() ||
+            (~a).to_file_string() != (~ma).to_file_string())
+        {
+            throw test_failed_error("pool arithmetic test failed");
+        }
+        auto arena = a.get_map().get_allocator().outer_allocator().arena();
+        for (const auto& [row_num, row] : a.get_map()) {
+            if (row.get_allocator().outer_allocator().arena() != arena) {
+                throw test_failed_error("pool shared arena test failed");
+            }
+        }
+        if (!arena || arena->blocks_num() > 8) {
+            throw test_failed_error("pool blocks test failed");
+        }
+        auto c = a;
+        if (c != a || c.get_map().get_allocator() == a.get_map().get_allocator()) {
+            throw test_failed_error("pool copy test failed");
+        }
+        auto reserved = arena->reserved();
+        for (int i = 0; i < 10; ++i) {
+            a[std::make_pair(1u, 1u)] = 0;
+            a.delete_zeros();
+            a[std::make_pair(1u, 1u)] = 5;
+        }
+        if (arena->reserved() != reserved || a(1, 1) != 5) {
+            throw test_failed_error("pool node reuse test failed");
+        }
+        auto ones = Matrix<double, pool_map>::make_ones(20, 20, 0.5);
+        if (ones != Matrix<double, pool_map>(Matrix<double, pool_map>::make_ones(20, 20, 0.5)) ||
+            ones(20, 20) != 1 || ones.to_file_string() != Matrix<double>::make_ones(20, 20, 0.5).to_file_string())
+        {
+            throw test_failed_error("pool ones test failed");
+        }
+        std::cout << "pool tests completed" << std::endl;
+    }
+};
+
+/**
+    \brief Класс с тестами для хеш-контейнера
 
-    /// Метод получения границ столбцов
-    std::pair<unsigned, unsigned> get_col_index() const {
-        return {start_col_, end_col_};
+    Данный класс сравнивает Matrix<int, flat_hash_map> с Matrix<int> при
+    случайных чтениях, записях и удалениях.
+*/
+class FlatHashTest {
+public:
+    void operator() () {
+        const unsigned n = 300;
+        Matrix<int, flat_hash_map> h(n, n, 0.5);
+        Matrix<int> m(n, n, 0.5);
+        unsigned seed = 7;
+        for (unsigned k = 0; k < 50000; ++k) {
+            seed = seed * 1103515245 + 12345;
+            auto pos = std::make_pair(seed % n + 1, (seed >> 12) % n + 1);
+            // треть записей - нули, они удаляют элементы
+            int value = (seed >> 20) % 3 == 0 ? 0 : int(seed % 11) - 5;
+            h[pos] = value;
+            m[pos] = value;
+            if (h(pos.first, n + 1 - pos.second) != m(pos.first, n + 1 - pos.second)) {
+                throw test_failed_error("hash random access test failed");
+            }
+        }
+        Matrix<int> sorted(n, n, 0.5);
+        for (const auto& [row_num, row] : h.get_map()) {
+            for (const auto& [col_num, elem] : row) {
+                sorted[std::make_pair(row_num, col_num)] = elem;
+            }
+        }
+        if (sorted != m) {
+            throw test_failed_error("hash content test failed");
+        }
+        std::size_t m_nnz = 0;
+        for (const auto& [row_num, row] : m.get_map()) {
+            m_nnz += row.size();
+        }
+        if (h.get_map().nnz() != m_nnz) {
+            throw test_failed_error("hash size test failed");
+        }
+        auto h2 = h * h;
+        auto m2 = m * m;
+        for (unsigned i = 1; i <= n; i += 7) {
+            for (unsigned j = 1; j <= n; j += 5) {
+                if (h2(i, j) != m2(i, j)) {
+                    throw test_failed_error("hash multiplication test failed");
+                }
+            }
+        }
+        if ((~h).get_map().nnz() != m_nnz) {
+            throw test_failed_error("hash transpose test failed");
+        }
+        {
+            // ключ (UINT_MAX, UINT_MAX) занят пустой ячейкой
+            const unsigned last = std::numeric_limits<unsigned>::max();
+            flat_hash_map<unsigned, flat_hash_map<unsigned, int>> map;
+            map[1][1] = 1;
+            bool caught = false;
+            try {
+                map[last][last] = 2;
+            } catch (reserved_index_error& ex) {
+                caught = ex.row_num == last && ex.col_num == last;
+            }
+            if (!caught || map[last].find(last) != map[last].end() || map.nnz() != 1) {
+                throw test_failed_error("hash reserved index test failed");
+            }
+            caught = false;
+            try {
+                map[last][last] = 2;
+            } catch (std::runtime_error& ex) {
+                caught = dynamic_cast<reserved_index_error*>(&ex) != nullptr;
+            }
+            if (!caught) {
+                throw test_failed_error("hash reserved index base class test failed");
+            }
+        }
+        {
+            // строки хранятся по непустым номерам: огромный номер строки не занимает памяти
+            const unsigned big = std::numeric_limits<unsigned>::max() - 1;
+            Matrix<int, flat_hash_map> huge(big, big, 0.5);
+            huge[std::make_pair(big, 3u)] = 5;
+            huge[std::make_pair(big - 1, big)] = 7;
+            huge[std::make_pair(big, 3u)] = 0;
+            huge[std::make_pair(big, big)] = 6;
+            std::size_t rows = 0, total = 0;
+            for (const auto& [row_num, row] : huge.get_map()) {
+                ++rows;
+                for (const auto& [col_num, elem] : row) {
+                    total += elem;
+                }
+            }
+            if (rows != 2 || total != 13 || huge(big, big) != 6 || huge(big, 3) != 0 ||
+                huge.get_map().nnz() != 2)
+            {
+                throw test_failed_error("hash huge row index test failed");
+            }
+        }
+        std::cout << "hash tests completed" << std::endl;
     }
-
-protected:
-    /// родитель
-    mutable Matrix<T, M>* parent_;
-    /// Границы среза
-    unsigned start_row_, end_row_, start_col_, end_col_;
 };
 
 /**
@@ -886,4 +3523,645 @@ public:
         }
         std::cout << "proxy tests completed" << std::endl;
     }
+};
+
+/**
+    \brief Контейнер, на котором идет проверка
+
+    Передается в Test::check<M> из for_each_backend: имя для сообщений,
+    признаки контейнера и общие тестовые матрицы. reference строит ту же
+    матрицу на std::map, с которой сверяется результат на проверяемом
+    контейнере.
+*/
+template <template <class...> class M>
+struct backend_case {
+    using storage_type = typename Matrix<int, M>::storage_type;
+    /// Обход по возрастанию (строка, столбец)
+    static constexpr bool ordered = is_ordered_storage<storage_type>::value;
+    /// Плотное хранение
+    static constexpr bool dense = is_dense_storage<storage_type>::value;
+
+    /// Разреженная целочисленная матрица n x n
+    static Matrix<int, M> sample(unsigned n, unsigned seed) {
+        return ParallelTest::sample<int, M>(n, seed);
+    }
+
+    /// Та же матрица на std::map
+    static Matrix<int> reference(unsigned n, unsigned seed) {
+        return ParallelTest::sample<int, std::map>(n, seed);
+    }
+
+    /**
+        \brief Хранимые элементы по возрастанию (строка, столбец)
+
+        Текстовый вывод неупорядоченных контейнеров идет в порядке обхода,
+        поэтому результаты на разных контейнерах сравниваются так.
+    */
+    template <class T, template <class...> class M2>
+    static std::vector<std::tuple<unsigned, unsigned, T>> contents(const Matrix<T, M2>& m) {
+        std::vector<std::tuple<unsigned, unsigned, T>> res;
+        for (const auto& [row_num, row] : m.get_map()) {
+            for (const auto& [col_num, elem] : row) {
+                res.emplace_back(row_num, col_num, static_cast<const T&>(elem));
+            }
+        }
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
+    /// Имя контейнера для сообщений
+    std::string name;
+};
+
+/**
+    \brief Запуск проверки на всех контейнерах
+
+    Вызывает Test::check<M>(backend_case<M>) для каждого контейнера, с
+    которым работает Matrix.
+*/
+template <class Test>
+void for_each_backend() {
+    Test::template check<std::map>({"map"});
+    Test::template check<csr_map>({"csr"});
+    Test::template check<dense_map>({"dense"});
+    Test::template check<hybrid_map>({"hybrid"});
+    Test::template check<flat_hash_map>({"hash"});
+    Test::template check<std::unordered_map>({"unordered"});
+    Test::template check<pool_map>({"pool"});
+}
+
+/**
+    \brief Класс с тестами для срезов-представлений
+
+    Данный класс сравнивает срезы-представления со срезами Matrix_proxy и
+    поэлементными вычислениями на всех контейнерах.
+*/
+class ViewTest {
+public:
+    /// Число хранимых нулей контейнера
+    template <template <class...> class M>
+    static std::size_t stored_zeros(const Matrix<int, M>& m) {
+        std::size_t res = 0;
+        for (const auto& [row_num, row] : m.get_map()) {
+            for (const auto& [col_num, elem] : row) {
+                res += (elem == 0);
+            }
+        }
+        return res;
+    }
+
+    /// Последовательность записей в срезы; хранимые элементы результата
+    template <template <class...> class M>
+    static auto block_writes(double eps) {
+        Matrix<int, M> a(30, 30, eps);
+        auto b = backend_case<M>::sample(30, 5);
+        for (auto [i, j, v] : std::as_const(b).nonzeros()) {
+            a[std::make_pair(i, j)] = v;
+        }
+        a.view(Matrix_coords(3, 4, 20, 25)) += b.view(Matrix_coords(1, 1, 18, 22));
+        a.view(Matrix_coords(10, 1, 30, 10)) -= a.view(Matrix_coords(1, 1, 21, 10));
+        a.view(Matrix_coords(2, 2, 11, 11)) = b.view(Matrix_coords(21, 21, 30, 30));
+        a.view(Matrix_row_coord(7)) *= 0;
+        a.view(Matrix_col_coord(9)).clear();
+        return backend_case<M>::contents(a);
+    }
+
+    template <template <class...> class M>
+    static void check(const backend_case<M>& backend) {
+        auto a = backend.sample(40, 1);
+        auto b = backend.sample(40, 2);
+        const Matrix_coords coords(5, 3, 20, 30);
+        auto v = a.view(coords);
+        auto pr = a[coords];
+        auto ref = Matrix<int, M>(*pr, 0.5);
+        delete pr;
+        if (Matrix<int, M>(v, 0.5) != ref || v.get_rows_num() != 16 || v.get_cols_num() != 28) {
+            throw test_failed_error(backend.name + " view to matrix test failed");
+        }
+        std::size_t nnz = 0;
+        for (unsigned i = 1; i <= 16; ++i) {
+            for (unsigned j = 1; j <= 28; ++j) {
+                nnz += (ref(i, j) != 0);
+                if (v(i, j) != a(i + 4, j + 2)) {
+                    throw test_failed_error(backend.name + " view elem test failed");
+                }
+            }
+        }
+        bool ok = true;
+        v.for_each([&](unsigned i, unsigned j, int elem) {
+            ok = ok && i >= 1 && i <= 16 && j >= 1 && j <= 28 && elem == ref(i, j);
+        });
+        if (!ok || v.nnz() != nnz) {
+            throw test_failed_error(backend.name + " view for_each test failed");
+        }
+        if constexpr (backend_case<M>::ordered) {
+            std::pair<unsigned, unsigned> prev(0, 0);
+            v.for_each([&](unsigned i, unsigned j, int) {
+                ok = ok && prev < std::make_pair(i, j);
+                prev = {i, j};
+            });
+            if (!ok) {
+                throw test_failed_error(backend.name + " view order test failed");
+            }
+        }
+
+        v[std::make_pair(1, 1)] = 42;
+        if (a(5, 3) != 42) {
+            throw test_failed_error(backend.name + " view write test failed");
+        }
+        auto expected = a;
+        for (unsigned i = 5; i <= 20; ++i) {
+            for (unsigned j = 3; j <= 30; ++j) {
+                if (b(i, j) != 0) {
+                    expected[std::make_pair(i, j)] = a(i, j) + b(i, j);
+                }
+            }
+        }
+        v += b.view(coords);
+        if (a != expected) {
+            throw test_failed_error(backend.name + " view addition test failed");
+        }
+        v -= v.to_matrix();
+        if (v.nnz() != 0 || stored_zeros(a) != 0 || a(4, 3) != expected(4, 3) || a(21, 30) != expected(21, 30)) {
+            throw test_failed_error(backend.name + " view cancellation test failed");
+        }
+
+        auto c = backend.sample(40, 3);
+        auto src = c.view(Matrix_coords(5, 5, 14, 14)).to_matrix();
+        c.view(Matrix_coords(1, 1, 10, 10)) = c.view(Matrix_coords(5, 5, 14, 14));
+        if (c.view(Matrix_coords(1, 1, 10, 10)).to_matrix() != src || stored_zeros(c) != 0) {
+            throw test_failed_error(backend.name + " view overlap test failed");
+        }
+        auto row = c.view(Matrix_row_coord(3));
+        row *= 2;
+        row.clear();
+        if (row.nnz() != 0 || row.get_cols_num() != 40) {
+            throw test_failed_error(backend.name + " view clear test failed");
+        }
+
+        bool thrown = false;
+        try {
+            v += Matrix<int, M>(2, 2, 0.5);
+        } catch (size_differentiation_error<int, M, int, M>&) {
+            thrown = true;
+        }
+        if (!thrown) {
+            throw test_failed_error(backend.name + " view size test failed");
+        }
+        thrown = false;
+        try {
+            v(17, 1);
+        } catch (invalid_index_error<int, M>&) {
+            thrown = true;
+        }
+        if (!thrown) {
+            throw test_failed_error(backend.name + " view index test failed");
+        }
+
+        const auto& cb = b;
+        Matrix_const_view<int, M> cv = cb.view(Matrix_col_coord(7));
+        Matrix_const_view<int, M> cv2 = a.view(coords);
+        auto col = b[Matrix_col_coord(7)];
+        auto col_matr = Matrix<int, M>(*col, 0.5);
+        delete col;
+        if (cv.to_matrix() != col_matr || cv2.nnz() != 0) {
+            throw test_failed_error(backend.name + " const view test failed");
+        }
+        // на CSR и разреженном гибридном контейнере запись идет слиянием
+        for (double eps : {0.0, 0.5}) {
+            if (block_writes<M>(eps) != block_writes<std::map>(eps)) {
+                throw test_failed_error(backend.name + " view block write test failed");
+            }
+        }
+    }
+
+    void operator() () {
+        for_each_backend<ViewTest>();
+        {
+            // исключение при слиянии на CSR оставляет матрицу без изменений
+            using R = RationalNumber<int>;
+            Matrix<R, csr_map> m(3, 3, 0.5);
+            m[std::make_pair(2, 2)] = R(1);
+            m[std::make_pair(3, 3)] = R(std::numeric_limits<int>::max());
+            auto ref = m;
+            Matrix<R, csr_map> add(3, 3, 0.5);
+            add[std::make_pair(1, 1)] = R(1);
+            add[std::make_pair(3, 3)] = R(1, 2);
+            bool thrown = false;
+            try {
+                m.view(Matrix_coords(1, 1, 3, 3)) += add;
+            } catch (overflow_error<int, int>&) {
+                thrown = true;
+            }
+            if (!thrown || m.to_file_string() != ref.to_file_string()) {
+                throw test_failed_error("merged view rollback test failed");
+            }
+        }
+        std::cout << "view tests completed" << std::endl;
+    }
+};
+
+/**
+    \brief Класс с тестами для итераторов по хранимым элементам
+
+    Данный класс сверяет обход nonzeros/row_nonzeros с поэлементным
+    доступом и проверяет операторы, построенные на итераторах, на всех
+    контейнерах.
+*/
+class IteratorTest {
+public:
+    template <template <class...> class M>
+    static void check(const backend_case<M>& backend) {
+        const unsigned n = 40;
+        auto a = backend.sample(n, 1);
+        std::size_t nnz = 0;
+        for (unsigned i = 1; i <= n; ++i) {
+            for (unsigned j = 1; j <= n; ++j) {
+                nnz += (a(i, j) != 0);
+            }
+        }
+        std::size_t count = 0;
+        bool ok = true;
+        const auto& ca = a;
+        std::vector<std::tuple<unsigned, unsigned, int>> visited;
+        for (auto [i, j, v] : ca.nonzeros()) {
+            ok = ok && v != 0 && a(i, j) == v;
+            visited.emplace_back(i, j, v);
+            ++count;
+        }
+        std::sort(visited.begin(), visited.end());
+        if (!ok || count != nnz || visited != backend.contents(backend.reference(n, 1))) {
+            throw test_failed_error(backend.name + " nonzero iterator test failed");
+        }
+        count = 0;
+        for (unsigned i = 1; i <= n; ++i) {
+            for (const auto& elem : ca.row_nonzeros(i)) {
+                ok = ok && elem.row == i && a(i, elem.col) == elem.value;
+                ++count;
+            }
+        }
+        if (!ok || count != nnz || !Matrix<int, M>(n, n, 0.5).nonzeros().empty()) {
+            throw test_failed_error(backend.name + " row iterator test failed");
+        }
+        if constexpr (backend_case<M>::ordered) {
+            auto range = ca.nonzeros();
+            for (auto it = range.begin(), prev = it; it != range.end(); prev = it++) {
+                if (it != prev && std::make_pair(prev->row, prev->col) >= std::make_pair(it->row, it->col)) {
+                    throw test_failed_error(backend.name + " iterator order test failed");
+                }
+            }
+        }
+
+        auto b = a;
+        for (auto [i, j, v] : b.row_nonzeros(7)) {
+            v = 0;
+        }
+        for (auto&& elem : b.nonzeros()) {
+            elem.value *= 3;
+        }
+        for (unsigned i = 1; i <= n; ++i) {
+            for (unsigned j = 1; j <= n; ++j) {
+                if (b(i, j) != (i == 7 ? 0 : 3 * a(i, j))) {
+                    throw test_failed_error(backend.name + " iterator write test failed");
+                }
+            }
+        }
+        if (!b.row_nonzeros(7).empty() || b == a || !(b == b) || a != ca) {
+            throw test_failed_error(backend.name + " iterator equality test failed");
+        }
+        auto c = a;
+        c[std::make_pair(n, n)] = a(n, n) + 1;
+        if (c == a || a == c) {
+            throw test_failed_error(backend.name + " iterator equality test failed");
+        }
+
+        auto t = ~a;
+        if (t.get_rows_num() != n || t.nonzeros().empty() || ~t != a) {
+            throw test_failed_error(backend.name + " transpose test failed");
+        }
+        for (auto [i, j, v] : t.nonzeros()) {
+            if (a(j, i) != v) {
+                throw test_failed_error(backend.name + " transpose test failed");
+            }
+        }
+        bool thrown = false;
+        try {
+            a.row_nonzeros(n + 1);
+        } catch (invalid_index_error<int, M>&) {
+            thrown = true;
+        }
+        if (!thrown) {
+            throw test_failed_error(backend.name + " row iterator index test failed");
+        }
+    }
+
+    void operator() () {
+        for_each_backend<IteratorTest>();
+        std::cout << "iterator tests completed" << std::endl;
+    }
+};
+
+/**
+    \brief Класс с тестами для хэша содержимого матриц
+
+    Данный класс сверяет поддерживаемый при записи хэш с пересчитанным
+    заново и проверяет использование матриц как ключей std::unordered_set.
+*/
+class ContentHashTest {
+public:
+    /// Хэш, посчитанный заново (сложение с нулевой матрицей сбрасывает хэш)
+    template <class T, template <class...> class M>
+    static std::size_t fresh_hash(const Matrix<T, M>& m) {
+        auto copy = m;
+        copy += Matrix<T, M>(m.get_rows_num(), m.get_cols_num(), m.get_eps());
+        return copy.content_hash();
+    }
+
+    template <template <class...> class M>
+    static void check(const backend_case<M>& backend) {
+        const unsigned n = 40;
+        auto a = backend.sample(n, 1);
+        auto b = a;
+        if (a.content_hash() != b.content_hash() || a.content_hash() != fresh_hash(a)) {
+            throw test_failed_error(backend.name + " content hash test failed");
+        }
+        // хэш не зависит от контейнера и порядка его обхода
+        if (a.content_hash() != backend.reference(n, 1).content_hash()) {
+            throw test_failed_error(backend.name + " backend hash test failed");
+        }
+        int old = b(3, 4);
+        b[std::make_pair(3, 4)] = old + 1;
+        if (b.content_hash() == a.content_hash() || b.content_hash() != fresh_hash(b) || a == b) {
+            throw test_failed_error(backend.name + " hash update test failed");
+        }
+        b[std::make_pair(3, 4)] = old;
+        if (b.content_hash() != a.content_hash() || a != b) {
+            throw test_failed_error(backend.name + " hash restore test failed");
+        }
+        {
+            // запись через ссылки, полученные до подсчета хэша
+            auto x = a;
+            auto first = x[std::make_pair(3, 4)];
+            auto second = x[std::make_pair(4, 3)];
+            x.content_hash();
+            first = old + 1;
+            second = 0;
+            auto y = a;
+            y[std::make_pair(3, 4)] = old + 1;
+            y[std::make_pair(4, 3)] = 0;
+            std::unordered_set<Matrix<int, M>> set = {y};
+            if (x != y || x.content_hash() != fresh_hash(x) || set.count(x) != 1) {
+                throw test_failed_error(backend.name + " hash retained refs test failed");
+            }
+        }
+        // запись нуля удаляет элемент, запись в пустую ячейку добавляет
+        for (auto [i, j, v] : a.nonzeros()) {
+            b[std::make_pair(i, j)] = 0;
+            b[std::make_pair(j, i)] += 2;
+            break;
+        }
+        auto v = b.view(Matrix_coords(5, 5, 24, 24));
+        v += a.view(Matrix_coords(1, 1, 20, 20));
+        v -= v.to_matrix();
+        if (b.content_hash() != fresh_hash(b)) {
+            throw test_failed_error(backend.name + " hash incremental test failed");
+        }
+        b *= 2;
+        if (b.content_hash() != fresh_hash(b)) {
+            throw test_failed_error(backend.name + " hash reset test failed");
+        }
+        {
+            // унарный минус не переносит хэш исходной матрицы
+            Matrix<int, M> neg(n, n, a.get_eps());
+            for (auto [i, j, v] : std::as_const(a).nonzeros()) {
+                neg[std::make_pair(i, j)] = -v;
+            }
+            a.content_hash();
+            auto minus = -a;
+            std::unordered_set<Matrix<int, M>> neg_set = {neg};
+            if (minus != neg || minus.content_hash() != fresh_hash(neg) || neg_set.count(minus) != 1) {
+                throw test_failed_error(backend.name + " negation hash test failed");
+            }
+        }
+        auto c = backend.sample(n, 2);
+        std::unordered_set<Matrix<int, M>> set = {a, c, a, ~(~c)};
+        if (set.size() != 2 || set.count(a) != 1 || set.count(b) != 0) {
+            throw test_failed_error(backend.name + " unordered set test failed");
+        }
+    }
+
+    void operator() () {
+        for_each_backend<ContentHashTest>();
+        Matrix<RationalNumber<int>> r1({{1, {{2, RationalNumber(1, 2)}}}, {3, {{1, RationalNumber(7)}}}}, 3, 3, 0.5);
+        Matrix<RationalNumber<int>> r2(3, 3, 0.5);
+        r2[std::make_pair(3, 1)] = RationalNumber(14, 2);
+        r2[std::make_pair(1, 2)] = RationalNumber(3, 6);
+        if (std::hash<Matrix<RationalNumber<int>>>{}(r1) != std::hash<Matrix<RationalNumber<int>>>{}(r2) || r1 != r2) {
+            throw test_failed_error("rational matrix hash test failed");
+        }
+        {
+            // исключение из записи не меняет ни элементы, ни хэш
+            using R = RationalNumber<int>;
+            Matrix<R> m({{1, {{1, R(std::numeric_limits<int>::max())}}}}, 3, 3, 0.5);
+            Matrix<R> ref = m;
+            m.content_hash();
+            bool thrown = false;
+            try {
+                m[std::make_pair(1, 1)] += R(1, 2);
+            } catch (overflow_error<int, int>& ex) {
+                thrown = true;
+            }
+            if (!thrown || m != ref || m.content_hash() != fresh_hash(ref)) {
+                throw test_failed_error("hash overflow rollback test failed");
+            }
+            thrown = false;
+            try {
+                m[std::make_pair(2, 2)] /= R(0);
+            } catch (zero_division_error& ex) {
+                thrown = true;
+            }
+            if (!thrown || m != ref || m.content_hash() != fresh_hash(ref) ||
+                m.to_file_string() != ref.to_file_string())
+            {
+                throw test_failed_error("hash zero division rollback test failed");
+            }
+        }
+        std::cout << "content hash tests completed" << std::endl;
+    }
+};
+
+/**
+    \brief Класс с тестами для транспонирования
+
+    Данный класс сверяет operator~ и transpose_in_place с поэлементным
+    транспонированием на всех контейнерах, в том числе на размерах, не
+    кратных листу рекурсивного плотного транспонирования.
+*/
+class TransposeTest {
+public:
+    /// Обход контейнера идет по возрастанию (строка, столбец)
+    template <class T, template <class...> class M>
+    static bool stored_in_order(const Matrix<T, M>& m) {
+        std::pair<unsigned, unsigned> prev(0, 0);
+        for (const auto& [row_num, row] : m.get_map()) {
+            for (const auto& [col_num, elem] : row) {
+                if (!(prev < std::make_pair(row_num, col_num))) {
+                    return false;
+                }
+                prev = {row_num, col_num};
+            }
+        }
+        return true;
+    }
+
+    template <template <class...> class M>
+    static void check(const backend_case<M>& backend) {
+        for (auto [rows_num, cols_num] : {std::make_pair(1u, 1u), std::make_pair(37u, 53u),
+            std::make_pair(70u, 3u), std::make_pair(100u, 100u), std::make_pair(33u, 33u)})
+        {
+            auto a = DenseTest::sample<M>(rows_num, cols_num, rows_num + cols_num);
+            auto t = ~a;
+            if (t.get_rows_num() != cols_num || t.get_cols_num() != rows_num) {
+                throw test_failed_error(backend.name + " transpose size test failed");
+            }
+            for (unsigned i = 1; i <= rows_num; ++i) {
+                for (unsigned j = 1; j <= cols_num; ++j) {
+                    if (t(j, i) != a(i, j)) {
+                        throw test_failed_error(backend.name + " transpose test failed");
+                    }
+                }
+            }
+            auto in_place = a;
+            in_place.transpose_in_place();
+            if (in_place != t || in_place.get_rows_num() != cols_num || in_place.get_cols_num() != rows_num) {
+                throw test_failed_error(backend.name + " in-place transpose test failed");
+            }
+            // оба способа выбирают одно представление, порядок обхода не нарушается
+            bool dense = storage_dense(t.get_map()) != nullptr;
+            if (dense != (storage_dense(in_place.get_map()) != nullptr) || (backend_case<M>::dense && !dense) ||
+                (backend_case<M>::ordered && !(stored_in_order(t) && stored_in_order(in_place))))
+            {
+                throw test_failed_error(backend.name + " transpose layout test failed");
+            }
+            in_place.transpose_in_place();
+            if (in_place != a || ~t != a) {
+                throw test_failed_error(backend.name + " double transpose test failed");
+            }
+            auto ref = ~DenseTest::sample<std::map>(rows_num, cols_num, rows_num + cols_num);
+            if (backend.contents(t) != backend.contents(ref)) {
+                throw test_failed_error(backend.name + " backend transpose test failed");
+            }
+        }
+        auto sparse = backend.sample(60, 4);
+        auto sparse_t = sparse;
+        sparse_t.transpose_in_place();
+        for (auto [i, j, v] : sparse.nonzeros()) {
+            if (sparse_t(j, i) != v) {
+                throw test_failed_error(backend.name + " sparse transpose test failed");
+            }
+        }
+        if (sparse_t.nonzeros().empty() || ~sparse != sparse_t ||
+            (backend_case<M>::ordered && !stored_in_order(sparse_t)))
+        {
+            throw test_failed_error(backend.name + " sparse transpose test failed");
+        }
+    }
+
+    void operator() () {
+        for_each_backend<TransposeTest>();
+        std::cout << "transpose tests completed" << std::endl;
+    }
+};
+
+/**
+    \brief Класс с тестами для степени матрицы и цепочек произведений
+
+    Данный класс сверяет pow и Matrix_chain с умножением слева направо и
+    проверяет выбор порядка умножений.
+*/
+class ChainTest {
+public:
+    template <template <class...> class M>
+    static void check(const backend_case<M>& backend) {
+        auto a = backend.sample(20, 1);
+        auto power = a;
+        for (unsigned k = 1; k <= 5; ++k) {
+            if (pow(a, k) != power) {
+                throw test_failed_error(backend.name + " power test failed");
+            }
+            power *= a;
+        }
+        if (pow(a, 0) != Matrix<int, M>::make_unary(20, 20, 0.5)) {
+            throw test_failed_error(backend.name + " zero power test failed");
+        }
+        bool thrown = false;
+        try {
+            pow(Matrix<int, M>(2, 3, 0.5), 2);
+        } catch (multiplication_error<int, M, int, M>&) {
+            thrown = true;
+        }
+        if (!thrown) {
+            throw test_failed_error(backend.name + " power size test failed");
+        }
+
+        auto b = backend.sample(20, 2);
+        auto c = backend.sample(20, 3);
+        Matrix<int, M> v(20, 1, 0.5);
+        for (unsigned i = 1; i <= 20; i += 2) {
+            v[std::make_pair(i, 1)] = int(i);
+        }
+        Matrix_chain<int, M> chain{a, b, c, v};
+        if (chain.order() != "(A1 (A2 (A3 A4)))" || chain.evaluate() != a * b * c * v ||
+            chain_product(a, b, c, v) != a * b * c * v)
+        {
+            throw test_failed_error(backend.name + " chain test failed");
+        }
+        // тот же результат, что на std::map
+        auto ref_a = backend.reference(20, 1);
+        auto ref_b = backend.reference(20, 2);
+        auto ref_c = backend.reference(20, 3);
+        Matrix_chain<int> ref_chain{ref_a, ref_b, ref_c};
+        if (backend.contents(Matrix_chain<int, M>{a, b, c}.evaluate()) != backend.contents(ref_chain.evaluate()) ||
+            backend.contents(pow(a, 5)) != backend.contents(pow(ref_a, 5)))
+        {
+            throw test_failed_error(backend.name + " backend chain test failed");
+        }
+        thrown = false;
+        try {
+            chain.add(a);
+        } catch (multiplication_error<int, M, int, M>&) {
+            thrown = true;
+        }
+        if (!thrown) {
+            throw test_failed_error(backend.name + " chain size test failed");
+        }
+    }
+
+    void operator() () {
+        for_each_backend<ChainTest>();
+        // классический пример: (10 x 30) (30 x 5) (5 x 60)
+        auto a1 = DenseTest::sample<dense_map>(10, 30, 1);
+        auto a2 = DenseTest::sample<dense_map>(30, 5, 2);
+        auto a3 = DenseTest::sample<dense_map>(5, 60, 3);
+        Matrix_chain<double, dense_map> chain{a1, a2, a3};
+        if (chain.order() != "((A1 A2) A3)" || !DenseTest::near(chain.evaluate(), a1 * a2 * a3)) {
+            throw test_failed_error("dense chain test failed");
+        }
+        Matrix<double, dense_map> d = DenseTest::sample<dense_map>(30, 30, 4) * 0.1;
+        if (!DenseTest::near(pow(d, 13),
+            d * d * d * d * d * d * d * d * d * d * d * d * d))
+        {
+            throw test_failed_error("dense power test failed");
+        }
+        bool thrown = false;
+        try {
+            Matrix_chain<double>().evaluate();
+        } catch (std::runtime_error& ex) {
+            thrown = dynamic_cast<empty_chain_error*>(&ex) != nullptr;
+        }
+        if (!thrown) {
+            throw test_failed_error("empty chain test failed");
+        }
+        std::cout << "chain tests completed" << std::endl;
+    }
 };
\ No newline at end of file
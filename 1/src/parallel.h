@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+    \brief Пул потоков
+
+    Фиксированный набор рабочих потоков с общей очередью задач. Поток,
+    ожидающий завершения своих задач, сам выполняет задачи из очереди,
+    поэтому вложенные вызовы run() не приводят к взаимной блокировке.
+*/
+class Thread_pool {
+public:
+    /// Конструктор по количеству потоков
+    explicit Thread_pool(unsigned threads_num) {
+        for (unsigned i = 0; i < threads_num; ++i) {
+            workers_.emplace_back([this] { worker(); });
+        }
+    }
+
+    Thread_pool(const Thread_pool&) = delete;
+    Thread_pool& operator= (const Thread_pool&) = delete;
+
+    /// Деструктор (дожидается выполнения оставшихся задач)
+    ~Thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& w : workers_) {
+            w.join();
+        }
+    }
+
+    /// Общий пул по количеству аппаратных потоков
+    static Thread_pool& shared() {
+        static Thread_pool pool(std::max(1u, std::thread::hardware_concurrency()));
+        return pool;
+    }
+
+    /// Метод получения количества потоков
+    unsigned size() const {
+        return workers_.size();
+    }
+
+    /**
+        \brief Выполнение f(0), ..., f(count - 1)
+
+        Возвращает управление после завершения всех задач. Первое
+        выброшенное задачей исключение пробрасывается вызывающему.
+    */
+    template <class F>
+    void run(unsigned count, F f) {
+        struct batch_state {
+            std::mutex mutex;
+            std::condition_variable done;
+            unsigned remaining;
+            std::exception_ptr error;
+        };
+        auto state = std::make_shared<batch_state>();
+        state->remaining = count;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (unsigned i = 0; i < count; ++i) {
+                tasks_.emplace_back([state, &f, i] {
+                    try {
+                        f(i);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(state->mutex);
+                        if (!state->error) {
+                            state->error = std::current_exception();
+                        }
+                    }
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (--state->remaining == 0) {
+                        state->done.notify_all();
+                    }
+                });
+            }
+        }
+        cv_.notify_all();
+        while (true) {
+            std::function<void()> task;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!tasks_.empty()) {
+                    task = std::move(tasks_.front());
+                    tasks_.pop_front();
+                }
+            }
+            if (!task) {
+                break;
+            }
+            task();
+        }
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&] { return state->remaining == 0; });
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+private:
+    void worker() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    /// Рабочие потоки
+    std::vector<std::thread> workers_;
+    /// Очередь задач
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+/**
+    \brief Политика выполнения операций над матрицами
+
+    Последовательная политика выполняет операцию в вызывающем потоке.
+    Параллельная делит строки на части по количеству потоков и выполняет
+    их в общем пуле. Каждая строка результата считается так же, как и при
+    последовательном выполнении, поэтому результаты совпадают побитово.
+*/
+class Matrix_execution {
+public:
+    /// Последовательное выполнение
+    static Matrix_execution sequential() {
+        return Matrix_execution(1, false);
+    }
+
+    /// Параллельное выполнение (0 потоков - по размеру общего пула)
+    static Matrix_execution parallel(unsigned threads_num = 0) {
+        return Matrix_execution(threads_num == 0 ? Thread_pool::shared().size() : threads_num, true);
+    }
+
+    /// Метод проверки параллельности
+    bool is_parallel() const {
+        return parallel_;
+    }
+
+    /// Метод получения количества потоков
+    unsigned threads_num() const {
+        return threads_num_;
+    }
+
+    /// Количество частей, на которые делится count строк
+    unsigned parts(std::size_t count) const {
+        return std::max<std::size_t>(1, std::min<std::size_t>(count, threads_num_));
+    }
+
+    /**
+        \brief Выполнение f(part, begin, end) для частей отрезка [0, count)
+
+        Части идут подряд и имеют почти равные длины.
+    */
+    template <class F>
+    void for_parts(std::size_t count, F f) const {
+        unsigned parts_num = parts(count);
+        auto range = [&](unsigned part) {
+            std::size_t begin = count * part / parts_num;
+            std::size_t end = count * (part + 1) / parts_num;
+            f(part, begin, end);
+        };
+        if (!parallel_ || parts_num == 1) {
+            for (unsigned part = 0; part < parts_num; ++part) {
+                range(part);
+            }
+            return;
+        }
+        Thread_pool::shared().run(parts_num, range);
+    }
+
+private:
+    Matrix_execution(unsigned threads_num, bool parallel) :
+        threads_num_(std::max(1u, threads_num)), parallel_(parallel) {}
+
+    /// Количество потоков
+    unsigned threads_num_;
+    /// Признак параллельного выполнения
+    bool parallel_;
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <new>
+#include <scoped_allocator>
+#include <utility>
+#include <vector>
+
+/**
+    \brief Арена узлов контейнеров
+
+    Память выделяется большими блоками (размер блока растет вдвое до
+    max_block_size) и раздается узлам по порядку. Освобожденные узлы
+    попадают в список свободных узлов своего размера и используются
+    повторно. Все блоки освобождаются разом при уничтожении арены.
+    Арена не потокобезопасна.
+*/
+class Node_arena {
+public:
+    /// Шаг размеров узлов
+    static constexpr std::size_t granularity = alignof(std::max_align_t);
+    /// Наибольший размер узла, который берется из арены
+    static constexpr std::size_t max_node_size = 256;
+    /// Размер первого блока
+    static constexpr std::size_t min_block_size = 4096;
+    /// Наибольший размер блока
+    static constexpr std::size_t max_block_size = 1 << 20;
+
+    Node_arena() = default;
+    Node_arena(const Node_arena&) = delete;
+    Node_arena& operator= (const Node_arena&) = delete;
+
+    ~Node_arena() {
+        for (auto block : blocks_) {
+            ::operator delete(block);
+        }
+    }
+
+    /// Выделение памяти под узел
+    void* allocate(std::size_t size) {
+        if (size > max_node_size) {
+            return ::operator new(size);
+        }
+        auto index = size_class(size);
+        if (auto node = free_[index]) {
+            free_[index] = *static_cast<void**>(node);
+            return node;
+        }
+        size = (index + 1) * granularity;
+        if (left_ < size) {
+            next_block();
+        }
+        void* res = current_;
+        current_ += size;
+        left_ -= size;
+        return res;
+    }
+
+    /// Возврат узла (в список свободных узлов его размера)
+    void deallocate(void* p, std::size_t size) {
+        if (size > max_node_size) {
+            ::operator delete(p);
+            return;
+        }
+        auto index = size_class(size);
+        *static_cast<void**>(p) = free_[index];
+        free_[index] = p;
+    }
+
+    /// Количество выделенных блоков
+    std::size_t blocks_num() const {
+        return blocks_.size();
+    }
+
+    /// Суммарный размер выделенных блоков в байтах
+    std::size_t reserved() const {
+        return reserved_;
+    }
+
+private:
+    static std::size_t size_class(std::size_t size) {
+        return (std::max(size, sizeof(void*)) + granularity - 1) / granularity - 1;
+    }
+
+    void next_block() {
+        auto size = blocks_.empty() ? min_block_size : std::min(2 * block_size_, max_block_size);
+        blocks_.reserve(blocks_.size() + 1);
+        current_ = static_cast<char*>(::operator new(size));
+        blocks_.push_back(current_);
+        block_size_ = size;
+        left_ = size;
+        reserved_ += size;
+    }
+
+    std::vector<void*> blocks_;
+    /// Списки свободных узлов по размерам
+    void* free_[max_node_size / granularity] = {};
+    char* current_ = nullptr;
+    std::size_t left_ = 0;
+    std::size_t block_size_ = 0;
+    std::size_t reserved_ = 0;
+};
+
+/**
+    \brief Распределитель памяти из арены узлов
+
+    Копии распределителя разделяют одну арену; арена создается при первом
+    выделении памяти. Копия контейнера получает новую арену, при
+    перемещении и обмене арена переходит вместе с узлами.
+*/
+template <class T>
+class pool_allocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    pool_allocator() noexcept = default;
+
+    template <class U>
+    pool_allocator(const pool_allocator<U>& other) noexcept : arena_(other.arena()) {}
+
+    T* allocate(std::size_t n) {
+        if (!arena_) {
+            arena_ = std::make_shared<Node_arena>();
+        }
+        return static_cast<T*>(arena_->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        arena_->deallocate(p, n * sizeof(T));
+    }
+
+    /// Копия контейнера получает собственную арену
+    pool_allocator select_on_container_copy_construction() const {
+        return pool_allocator();
+    }
+
+    /// Арена распределителя (nullptr до первого выделения)
+    const std::shared_ptr<Node_arena>& arena() const {
+        return arena_;
+    }
+
+    template <class U>
+    bool operator== (const pool_allocator<U>& other) const { return arena_ == other.arena(); }
+    template <class U>
+    bool operator!= (const pool_allocator<U>& other) const { return arena_ != other.arena(); }
+
+private:
+    std::shared_ptr<Node_arena> arena_;
+};
+
+/**
+    \brief std::map с узлами из арены
+
+    При использовании в Matrix (Matrix<T, pool_map>) строки создаются
+    внутри узлов внешнего контейнера и через scoped_allocator_adaptor
+    получают его арену, так что все узлы матрицы лежат в нескольких
+    больших блоках и освобождаются вместе с матрицей.
+*/
+template <class K, class V>
+using pool_map = std::map<K, V, std::less<K>, std::scoped_allocator_adaptor<pool_allocator<std::pair<const K, V>>>>;
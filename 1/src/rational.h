@@ -6,9 +6,12 @@
 #include <ostream>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <cmath>
 
 #include <cstdlib>
+#include <functional>
 
 #include <iostream>
 
@@ -82,23 +85,94 @@ class test_failed_error : public std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
+/// Количество младших нулевых битов (x != 0)
+template <class U>
+int trailing_zeros(U x) {
+    if constexpr (sizeof(U) <= sizeof(unsigned)) {
+        return __builtin_ctz(x);
+    } else if constexpr (sizeof(U) <= sizeof(unsigned long long)) {
+        return __builtin_ctzll(x);
+    } else {
+        unsigned long long low = (unsigned long long)x;
+        return low != 0 ? __builtin_ctzll(low) : 64 + __builtin_ctzll((unsigned long long)(x >> 64));
+    }
+}
+
 /**
     \brief Вычисление НОД
 
-    Данная функция вычисляет НОД двух чисел.
+    Данная функция вычисляет НОД двух чисел (неотрицательный). Для
+    встроенных типов - бинарный алгоритм Стейна: только сдвиги и
+    вычитания, без деления.
 */
 template <class T>
 T get_max_delim(T a, T b) {
-    if (a == b) {
-        return a;
+    if constexpr (std::is_integral_v<T>) {
+        using U = std::make_unsigned_t<T>;
+        U u = a < 0 ? U(0) - U(a) : U(a);
+        U v = b < 0 ? U(0) - U(b) : U(b);
+        if (u == 0 || v == 0) {
+            return T(u | v);
+        }
+        int shift = trailing_zeros(U(u | v));
+        u >>= trailing_zeros(u);
+        v >>= trailing_zeros(v);
+        // оба нечетные; разность четная и не нулевая, пока u != v
+        while (u != v) {
+            U low = u < v ? u : v;
+            U diff = u < v ? v - u : u - v;
+            u = low;
+            v = diff >> trailing_zeros(diff);
+        }
+        return T(u << shift);
+    } else {
+        T tmp;
+        while (b != 0) {
+            tmp = a % b;
+            a = b;
+            b = tmp;
+        }
+        return a < 0 ? -a : a;
     }
-    T tmp;
-    while (b != 0) {
-        tmp = a % b;
-        a = b;
-        b = tmp;
+}
+
+/**
+    \brief Сложение с проверкой переполнения
+
+    Для встроенных типов - __builtin_add_overflow; типы без ограничения
+    разрядности (std::numeric_limits<T>::is_bounded == false) не
+    переполняются. Возвращает true при переполнении.
+*/
+template <class A, class B, class R>
+bool add_overflow(A a, B b, R* res) {
+    if constexpr (std::numeric_limits<R>::is_bounded) {
+        return __builtin_add_overflow(a, b, res);
+    } else {
+        *res = R(a) + R(b);
+        return false;
+    }
+}
+
+/// Вычитание с проверкой переполнения
+template <class A, class B, class R>
+bool sub_overflow(A a, B b, R* res) {
+    if constexpr (std::numeric_limits<R>::is_bounded) {
+        return __builtin_sub_overflow(a, b, res);
+    } else {
+        *res = R(a) - R(b);
+        return false;
+    }
+}
+
+/// Умножение с проверкой переполнения
+template <class A, class B, class R>
+bool mul_overflow(A a, B b, R* res) {
+    if constexpr (std::numeric_limits<R>::is_bounded) {
+        return __builtin_mul_overflow(a, b, res);
+    } else {
+        *res = R(a) * R(b);
+        return false;
     }
-    return a;
 }
 
 template <class T>
@@ -106,25 +180,28 @@ T from_string(std::string s) {
     T res = 0;
     int index = 0;
     bool neg = false;
+    if (!s.empty() && s[0] == '-') {
+        neg = true;
+        index = 1;
+    }
+    if (index == s.size()) {
+        throw std::runtime_error("no digits");
+    }
     while (index < s.size()) {
-        if (index == 0 && s[0] == '-') {
-            neg = true;
-            continue;
-        }
         if (s[index] < '0' || s[index] > '9') {
             throw std::runtime_error("invalid string characters");
         }
         int current_digit = s[index] - '0';
-        if (__builtin_mul_overflow(res, 10, &res)) {
+        if (mul_overflow(res, 10, &res)) {
             throw std::runtime_error("number too big");
         }
-        if (__builtin_add_overflow(res, current_digit, &res)) {
+        if (add_overflow(res, current_digit, &res)) {
             throw std::runtime_error("number too big");
         }
         index += 1;
     }
     if (neg) {
-        if (__builtin_mul_overflow(res, -1, &res)) {
+        if (mul_overflow(res, -1, &res)) {
             throw std::runtime_error("number too big");
         }
     }
@@ -134,6 +211,9 @@ T from_string(std::string s) {
 template <class T>
 RationalNumber<T> make_canonical(RationalNumber<T> arg);
 
+template <class T, class T2>
+int rational_compare(const RationalNumber<T>& lhs, const RationalNumber<T2>& rhs);
+
 template <class T>
 std::string to_string(RationalNumber<T>& num) {
     return std::string(num);
@@ -158,21 +238,21 @@ public:
     RationalNumber() :
         numerator_{0}, denominator_{1} 
     {
-        static_assert(std::is_integral<T>::value, "invalid type (must be integral)");
+        static_assert(std::numeric_limits<T>::is_integer, "invalid type (must be integral)");
     }
 
     /// Конструктор из целого числа
     RationalNumber(T numerator) :
         numerator_{numerator}, denominator_{1}
     {
-        static_assert(std::is_integral<T>::value, "invalid type (must be integral)");
+        static_assert(std::numeric_limits<T>::is_integer, "invalid type (must be integral)");
     }
 
     /// Конструктор по числителю и знаменателю
     RationalNumber(T numerator, T denominator) :
         numerator_{numerator}, denominator_{denominator} 
     {
-        static_assert(std::is_integral<T>::value, "invalid type (must be integral)");
+        static_assert(std::numeric_limits<T>::is_integer, "invalid type (must be integral)");
         if (denominator == 0) {
             throw zero_division_error("denominator cannot be zero");
         }
@@ -190,7 +270,7 @@ public:
     template<class T2>
     RationalNumber(const RationalNumber<T2>& other) {
         static_assert(sizeof(T2) <= sizeof(T), "type size decreases");
-        static_assert(!(std::is_signed_v<T> ^ std::is_signed_v<T2>), "type signess differs");
+        static_assert(std::numeric_limits<T>::is_signed == std::numeric_limits<T2>::is_signed, "type signess differs");
         numerator_ = other.get_numerator();
         denominator_ = other.get_denominator();
     }
@@ -258,7 +338,8 @@ public:
 
     /// Оператор преобразования в строку
     operator std::string() const {
-        return std::to_string(numerator_) + "/" + std::to_string(denominator_);
+        using std::to_string;
+        return to_string(numerator_) + "/" + to_string(denominator_);
     }
 
     /// Оператор приведения к каноническому виду
@@ -271,7 +352,7 @@ public:
     /// Оператор унарного минуса
     RationalNumber operator- () const {
         T new_numerator;
-        if (__builtin_mul_overflow(numerator_, -1, &new_numerator)) {
+        if (mul_overflow(numerator_, -1, &new_numerator)) {
             throw overflow_error("type overflow", *this, RationalNumber(-1), operation::mul);
         }
         return RationalNumber(new_numerator, denominator_);
@@ -280,7 +361,7 @@ public:
     /// Оператор +=
     RationalNumber operator+= (const RationalNumber& rhs) {
         auto eq_denom = make_equal_denominator(*this, rhs);
-        if (__builtin_add_overflow(eq_denom.first.numerator_, eq_denom.second.numerator_, &numerator_)) {
+        if (add_overflow(eq_denom.first.numerator_, eq_denom.second.numerator_, &numerator_)) {
             throw overflow_error("type overflow", *this, rhs, operation::add);
         }
         denominator_ = eq_denom.first.denominator_;
@@ -291,7 +372,7 @@ public:
     /// Оператор -=
     RationalNumber operator-= (const RationalNumber& rhs) {
         auto eq_denom = make_equal_denominator(*this, rhs);
-        if (__builtin_sub_overflow(eq_denom.first.numerator_, eq_denom.second.numerator_, &numerator_)) {
+        if (sub_overflow(eq_denom.first.numerator_, eq_denom.second.numerator_, &numerator_)) {
             throw overflow_error("type overflow", *this, rhs, operation::sub);
         }
         denominator_ = eq_denom.first.denominator_;
@@ -301,11 +382,16 @@ public:
 
     /// Оператор *=
     RationalNumber operator*= (const RationalNumber& rhs) {
+        // перекрестное сокращение: (a/b) * (c/d) = (a/g1 * c/g2) / (b/g2 * d/g1)
+        // уменьшает промежуточные произведения; операнды могут быть не
+        // сокращены (конструктор не сокращает), поэтому результат сокращается
+        T g1 = get_max_delim(numerator_, rhs.denominator_);
+        T g2 = get_max_delim(rhs.numerator_, denominator_);
         T new_denominator;
-        if (__builtin_mul_overflow(denominator_, rhs.denominator_, &new_denominator)) {
+        if (mul_overflow(denominator_ / g2, rhs.denominator_ / g1, &new_denominator)) {
             throw overflow_error("type overflow", *this, rhs, operation::mul);
         }
-        if (__builtin_mul_overflow(numerator_, rhs.numerator_, &numerator_)) {
+        if (mul_overflow(numerator_ / g1, rhs.numerator_ / g2, &numerator_)) {
             throw overflow_error("type overflow", *this, rhs, operation::mul);
         }
         denominator_ = new_denominator;
@@ -315,13 +401,22 @@ public:
 
     /// Оператор /=
     RationalNumber operator/= (const RationalNumber& rhs) {
+        if (rhs.numerator_ == 0) {
+            throw zero_division_error("division by zero");
+        }
+        T g1 = get_max_delim(numerator_, rhs.numerator_);
+        T g2 = get_max_delim(rhs.denominator_, denominator_);
         T new_denominator;
-        if (__builtin_mul_overflow(denominator_, rhs.numerator_, &new_denominator)) {
+        if (mul_overflow(denominator_ / g2, rhs.numerator_ / g1, &new_denominator)) {
             throw overflow_error("type overflow", *this, rhs, operation::div);
         }
-        if (__builtin_mul_overflow(numerator_, rhs.denominator_, &numerator_)) {
+        if (mul_overflow(numerator_ / g1, rhs.denominator_ / g2, &numerator_)) {
             throw overflow_error("type overflow", *this, rhs, operation::div);
         }
+        if (new_denominator < 0) {
+            numerator_ = -numerator_;
+            new_denominator = -new_denominator;
+        }
         denominator_ = new_denominator;
         make_canonical();
         return *this;
@@ -385,12 +480,10 @@ public:
         return lhs;
     }
 
-    /// Оператор равенства
+    /// Оператор равенства (перекрестное умножение, без приведения копий)
     template <class T2>
     friend bool operator== (const RationalNumber& lhs, const RationalNumber<T2>& rhs) {
-        RationalNumber lhs_can = ::make_canonical(lhs);
-        RationalNumber rhs_can = ::make_canonical(rhs);
-        return (lhs_can.get_numerator() == rhs_can.get_numerator() && lhs_can.get_denominator() == rhs_can.get_denominator());
+        return rational_compare(lhs, rhs) == 0;
     }
 
     /// Оператор неравенства
@@ -401,24 +494,13 @@ public:
 
     /// Оператор "меньше"
     friend bool operator< (const RationalNumber& lhs, const RationalNumber& rhs) {
-        auto eq_denom = make_equal_denominator(lhs, rhs);
-        return eq_denom.first.get_numerator() < eq_denom.second.get_numerator();
+        return rational_compare(lhs, rhs) < 0;
     }
 
     /// Оператор "меньше" для чисел разных типов
     template <class T2>
     friend bool operator< (const RationalNumber& lhs, const RationalNumber<T2>& rhs) {
-        if (lhs == rhs) {
-            return false;
-        }
-        if (lhs.get_numerator() > 0 && rhs.get_numerator() < 0) {
-            return false;
-        }
-        if (lhs.get_numerator() < 0 && rhs.get_numerator() > 0) {
-            return true;
-        }
-        auto eq_denom = make_equal_denominator(lhs, rhs);
-        return eq_denom.first.get_numerator() < eq_denom.second.get_numerator();
+        return rational_compare(lhs, rhs) < 0;
     }
 
     /// Оператор "больше"
@@ -447,7 +529,7 @@ public:
 
     /// Оператор преобразования к int
     explicit operator int() const {
-        long long res = numerator_ / denominator_;
+        long long res = static_cast<long long>(numerator_ / denominator_);
         if (res > std::numeric_limits<int>::max() || res < std::numeric_limits<int>::min()) {
             throw overflow_error("type overflow", *this, RationalNumber(0), operation::to_int);
         }
@@ -456,17 +538,17 @@ public:
 
     /// Оператор преобразования к double
     explicit operator double() const {
-        return (double)numerator_ / denominator_;
+        return double(numerator_) / double(denominator_);
     }
 
     /// Оператор округления вниз
     T floor() const {
-        return std::floor(double(*this));
+        return T(std::floor(double(*this)));
     }
 
     /// Оператор округления
     T round() const {
-        return std::round(double(*this));
+        return T(std::round(double(*this)));
     }
 };
 
@@ -482,6 +564,77 @@ RationalNumber<T> make_canonical(RationalNumber<T> arg) {
     return arg;
 }
 
+/// Тип, в котором произведение двух значений T вычисляется без переполнения
+template <class T, class = void>
+struct rational_wide {
+    using type = T;
+};
+
+template <class T>
+struct rational_wide<T, std::enable_if_t<std::is_integral_v<T> && (sizeof(T) <= sizeof(long long))>> {
+    using type = std::conditional_t<std::is_signed_v<T>, __int128, unsigned __int128>;
+};
+
+/**
+    \brief Сравнение a/b и c/d (b, d > 0) по цепным дробям
+
+    Сравниваются целые части, затем обратные величины остатков; все
+    значения не превосходят исходных, поэтому переполнения нет.
+    Возвращает знак a/b - c/d.
+*/
+template <class W>
+int rational_compare_fractions(W a, W b, W c, W d) {
+    auto floor_div = [](const W& x, const W& y) {
+        W q = x / y;
+        if (x % y != 0 && x < 0) {
+            --q;
+        }
+        return q;
+    };
+    int sign = 1;
+    while (true) {
+        W q1 = floor_div(a, b);
+        W q2 = floor_div(c, d);
+        if (q1 != q2) {
+            return q1 < q2 ? -sign : sign;
+        }
+        W r1 = a - q1 * b;
+        W r2 = c - q2 * d;
+        if (r1 == 0 || r2 == 0) {
+            return sign * (int(r1 != 0) - int(r2 != 0));
+        }
+        // r1/b < r2/d  <=>  b/r1 > d/r2
+        a = b;
+        b = r1;
+        c = d;
+        d = r2;
+        sign = -sign;
+    }
+}
+
+/**
+    \brief Сравнение рациональных чисел
+
+    Данная функция возвращает знак lhs - rhs. Числа сравниваются
+    перекрестным умножением в расширенном типе (для типов до 64 бит -
+    __int128), без приведения к каноническому виду; если произведения не
+    помещаются и в него, используется сравнение по цепным дробям.
+*/
+template <class T, class T2>
+int rational_compare(const RationalNumber<T>& lhs, const RationalNumber<T2>& rhs) {
+    using W = typename rational_wide<std::common_type_t<T, T2>>::type;
+    W a = W(lhs.get_numerator());
+    W b = W(lhs.get_denominator());
+    W c = W(rhs.get_numerator());
+    W d = W(rhs.get_denominator());
+    W x;
+    W y;
+    if (!mul_overflow(a, d, &x) && !mul_overflow(c, b, &y)) {
+        return x < y ? -1 : y < x ? 1 : 0;
+    }
+    return rational_compare_fractions(a, b, c, d);
+}
+
 /**
     \brief Приведение к общему знаменателю
 
@@ -494,15 +647,15 @@ std::pair<RationalNumber<T>, RationalNumber<T2>> make_equal_denominator(const Ra
     auto first_mul = arg2.get_denominator() / max_delim;
     auto second_mul = arg1.get_denominator() / max_delim;
     T new_denominator;
-    if (__builtin_mul_overflow(first_mul, arg1.get_denominator(), &new_denominator)) {
+    if (mul_overflow(first_mul, arg1.get_denominator(), &new_denominator)) {
         throw overflow_error("type overflow", arg1, arg2, operation::eq_denom);
     }
     T new_numerator_1;
-    if (__builtin_mul_overflow(first_mul, arg1.get_numerator(), &new_numerator_1)) {
+    if (mul_overflow(first_mul, arg1.get_numerator(), &new_numerator_1)) {
         throw overflow_error("type overflow", arg1, arg2, operation::eq_denom);
     }
     T2 new_numerator_2;
-    if (__builtin_mul_overflow(second_mul, arg2.get_numerator(), &new_numerator_2)) {
+    if (mul_overflow(second_mul, arg2.get_numerator(), &new_numerator_2)) {
         throw overflow_error("type overflow", arg1, arg2, operation::eq_denom);
     }
     return {RationalNumber<T>{new_numerator_1, new_denominator}, RationalNumber<T2>{new_numerator_2, new_denominator}};
@@ -516,6 +669,24 @@ RationalNumber<T> abs(const RationalNumber<T>& num) {
     return num;
 }
 
+/// Объединение хэшей (как boost::hash_combine)
+inline std::size_t hash_combine(std::size_t seed, std::size_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+namespace std {
+
+/// Хэш рационального числа (по несократимой записи, так как конструктор дробь не сокращает)
+template <class T>
+struct hash<RationalNumber<T>> {
+    std::size_t operator() (const RationalNumber<T>& num) const {
+        auto canonical = make_canonical(num);
+        return hash_combine(std::hash<T>{}(canonical.get_numerator()), std::hash<T>{}(canonical.get_denominator()));
+    }
+};
+
+}
+
 /**
     \brief Класс с тестами для класса RationalNumber
 
@@ -554,6 +725,12 @@ public:
         if (a / b != RationalNumber(18, 25)) {
             throw test_failed_error("dividing test failed");
         }
+        if (std::string(RationalNumber<int>(2, 4) * RationalNumber<int>(3)) != "3/2" ||
+            std::string(RationalNumber<int>(2, 4) / RationalNumber<int>(1)) != "1/2" ||
+            std::string(RationalNumber<int>(4, 6) / RationalNumber<int>(-10, 4)) != "-4/15")
+        {
+            throw test_failed_error("non-reduced operands test failed");
+        }
         if ((RationalNumber(3, 5) += b) != RationalNumber(43, 30)) {
             throw test_failed_error("add-copy test failed");
         }
@@ -608,6 +785,47 @@ public:
         if (std::string(b) != "5/6") {
             throw test_failed_error("string test failed");
         }
+        if (get_max_delim(-6, 4) != 2 || get_max_delim(0, -5) != 5 || get_max_delim(48ll, 180ll) != 12) {
+            throw test_failed_error("gcd test failed");
+        }
+        auto neg = make_canonical(RationalNumber(-6, 4));
+        if (neg.get_numerator() != -3 || neg.get_denominator() != 2 || RationalNumber<int>("-3/4") != RationalNumber(-3, 4)) {
+            throw test_failed_error("negative canonical test failed");
+        }
+        catched = false;
+        try {
+            RationalNumber<int>("-");
+        } catch (invalid_string_error&) {
+            catched = true;
+        }
+        if (!catched) {
+            throw test_failed_error("sign-only string test failed");
+        }
+        // перекрестное сокращение: промежуточные произведения не переполняются
+        auto big = RationalNumber(1000000000, 3);
+        if (big * RationalNumber(3, 1000000000) != RationalNumber(1) || big / big != RationalNumber(1) ||
+            (RationalNumber(2, 3) / RationalNumber(-4, 9)).get_denominator() != 2)
+        {
+            throw test_failed_error("cross cancellation test failed");
+        }
+        const long long llmax = std::numeric_limits<long long>::max();
+        if (!(RationalNumber<long long>(llmax, 2) < RationalNumber<long long>(llmax, 1)) ||
+            RationalNumber<long long>(llmax - 1, llmax) == RationalNumber<long long>(llmax - 2, llmax - 1))
+        {
+            throw test_failed_error("wide comparison test failed");
+        }
+        const __int128 max128 = std::numeric_limits<__int128>::max();
+        if (!(RationalNumber<__int128>(max128, max128 - 1) < RationalNumber<__int128>(max128 - 1, max128 - 2)) ||
+            !(RationalNumber<__int128>(-max128, max128 - 1) < RationalNumber<__int128>(-max128 + 1, max128 - 1)))
+        {
+            throw test_failed_error("continued fraction comparison test failed");
+        }
+        std::hash<RationalNumber<int>> rat_hash;
+        if (rat_hash(RationalNumber(2, 4)) != rat_hash(RationalNumber(3, 6)) ||
+            rat_hash(RationalNumber(1, 2)) == rat_hash(RationalNumber(-1, 2)))
+        {
+            throw test_failed_error("hash test failed");
+        }
         std::cout << "rational tests completed" << std::endl;
     }
 };
@@ -0,0 +1,488 @@
+#pragma once
+
+#include "matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+    \brief Исключение несовпадения длины вектора
+
+    Данный класс является исключением для ситуации, когда длина вектора
+    не совпадает с размером матрицы (или матрица не квадратная).
+*/
+class vector_size_error : public std::runtime_error {
+public:
+    vector_size_error(std::string what, std::size_t expected, std::size_t size) :
+        std::runtime_error(what), expected(expected), size(size) {}
+    std::size_t expected;
+    std::size_t size;
+};
+
+/**
+    \brief Произведение матрицы на вектор y = A x
+
+    Векторы хранятся в std::vector с нумерацией с 0: элемент i вектора
+    соответствует строке (столбцу) i + 1 матрицы. Проход идет только по
+    хранимым элементам: для csr_map - прямо по массивам CSR, для плотного
+    представления - по строкам плотного массива, для остальных контейнеров -
+    по итераторам строк. При параллельном выполнении строки делятся на
+    части; каждая строка считается так же, как и последовательно.
+*/
+template <class T, template <class...> class M>
+void spmv(const Matrix<T, M>& a, const std::vector<T>& x, std::vector<T>& y,
+    const Matrix_execution& policy = Matrix_execution::sequential())
+{
+    if (x.size() != a.get_cols_num()) {
+        throw vector_size_error("vector size differs", a.get_cols_num(), x.size());
+    }
+    a.delete_zeros();
+    const auto& map = a.get_map();
+    y.assign(a.get_rows_num(), T(0));
+    if constexpr (std::is_same_v<typename Matrix<T, M>::storage_type, csr_map<unsigned, csr_map<unsigned, T>>>) {
+        const auto& row_ptr = map.row_ptr();
+        const auto* col_idx = map.col_idx().data();
+        const auto* values = map.values().data();
+        std::size_t rows = std::min<std::size_t>(a.get_rows_num() + 1, row_ptr.size() - 1);
+        policy.for_parts(rows, [&](unsigned, std::size_t begin, std::size_t end) {
+            for (auto r = std::max<std::size_t>(begin, 1); r < end; ++r) {
+                T sum = 0;
+                for (auto pos = row_ptr[r]; pos < row_ptr[r + 1]; ++pos) {
+                    sum += values[pos] * x[col_idx[pos] - 1];
+                }
+                y[r - 1] = sum;
+            }
+        });
+        return;
+    }
+    if (const auto* dense = storage_dense(map)) {
+        std::size_t rows = std::min<std::size_t>(a.get_rows_num(), dense->rows());
+        std::size_t cols = std::min<std::size_t>(a.get_cols_num(), dense->cols());
+        policy.for_parts(rows, [&](unsigned, std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                const T* row = dense->data() + i * dense->stride();
+                T sum = 0;
+                for (std::size_t j = 0; j < cols; ++j) {
+                    sum += row[j] * x[j];
+                }
+                y[i] = sum;
+            }
+        });
+        return;
+    }
+    std::vector<decltype(map.begin())> rows;
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        rows.push_back(it);
+    }
+    policy.for_parts(rows.size(), [&](unsigned, std::size_t begin, std::size_t end) {
+        for (auto k = begin; k < end; ++k) {
+            const auto& [row_num, row] = *rows[k];
+            T sum = 0;
+            for (const auto& [col_num, elem] : row) {
+                sum += elem * x[col_num - 1];
+            }
+            y[row_num - 1] = sum;
+        }
+    });
+}
+
+/// Произведение матрицы на вектор, возвращающее результат
+template <class T, template <class...> class M>
+std::vector<T> spmv(const Matrix<T, M>& a, const std::vector<T>& x,
+    const Matrix_execution& policy = Matrix_execution::sequential())
+{
+    std::vector<T> y;
+    spmv(a, x, y, policy);
+    return y;
+}
+
+/**
+    \brief Скалярное произведение векторов
+
+    Частичные суммы считаются по блокам фиксированной длины и складываются
+    по порядку, поэтому результат не зависит от количества потоков.
+*/
+inline double vector_dot(const std::vector<double>& x, const std::vector<double>& y,
+    const Matrix_execution& policy = Matrix_execution::sequential())
+{
+    constexpr std::size_t block = 4096;
+    std::size_t blocks = (x.size() + block - 1) / block;
+    std::vector<double> partial(blocks, 0);
+    policy.for_parts(blocks, [&](unsigned, std::size_t begin, std::size_t end) {
+        for (auto b = begin; b < end; ++b) {
+            double sum = 0;
+            for (auto i = b * block; i < std::min(x.size(), (b + 1) * block); ++i) {
+                sum += x[i] * y[i];
+            }
+            partial[b] = sum;
+        }
+    });
+    double res = 0;
+    for (auto sum : partial) {
+        res += sum;
+    }
+    return res;
+}
+
+/// Евклидова норма вектора
+inline double vector_norm(const std::vector<double>& x,
+    const Matrix_execution& policy = Matrix_execution::sequential())
+{
+    return std::sqrt(vector_dot(x, x, policy));
+}
+
+/// Выполнение f(i) для всех элементов вектора длины n по частям политики
+template <class F>
+void vector_for_each(std::size_t n, const Matrix_execution& policy, F f) {
+    policy.for_parts(n, [&](unsigned, std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            f(i);
+        }
+    });
+}
+
+/// Предобусловливатель без преобразования (z = r)
+class Identity_preconditioner {
+public:
+    void apply(const std::vector<double>& r, std::vector<double>& z) const {
+        z = r;
+    }
+};
+
+/**
+    \brief Предобусловливатель Якоби (z = D^-1 r)
+
+    D - диагональ матрицы; нулевые диагональные элементы заменяются
+    единицей.
+*/
+class Jacobi_preconditioner {
+public:
+    template <template <class...> class M>
+    explicit Jacobi_preconditioner(const Matrix<double, M>& a) :
+        inverse_(std::min(a.get_rows_num(), a.get_cols_num()), 1.0)
+    {
+        for (std::size_t i = 0; i < inverse_.size(); ++i) {
+            double d = a(i + 1, i + 1);
+            if (d != 0) {
+                inverse_[i] = 1 / d;
+            }
+        }
+    }
+
+    void apply(const std::vector<double>& r, std::vector<double>& z) const {
+        z.resize(r.size());
+        for (std::size_t i = 0; i < r.size(); ++i) {
+            z[i] = i < inverse_.size() ? r[i] * inverse_[i] : r[i];
+        }
+    }
+
+private:
+    std::vector<double> inverse_;
+};
+
+/// Параметры итерационного решателя
+struct solver_options {
+    /// Требуемая относительная невязка ||b - A x|| / ||b||
+    double tolerance = 1e-10;
+    /// Наибольшее количество итераций
+    unsigned max_iterations = 1000;
+    /// Сохранять невязку после каждой итерации
+    bool track_residuals = false;
+    /// Начальное приближение (пустое - нулевой вектор)
+    std::vector<double> initial;
+    /// Политика выполнения произведений и операций над векторами
+    Matrix_execution policy = Matrix_execution::sequential();
+};
+
+/// Результат итерационного решателя
+struct solver_result {
+    /// Решение
+    std::vector<double> x;
+    /// Достигнута ли требуемая невязка
+    bool converged = false;
+    /// Количество выполненных итераций
+    unsigned iterations = 0;
+    /// Относительная невязка решения
+    double residual = 0;
+    /// Невязки: [0] - начальная, [k] - после k-й итерации (при track_residuals)
+    std::vector<double> residuals;
+};
+
+/// Проверка размеров системы и начальная невязка r = b - A x
+template <template <class...> class M>
+void solver_start(const Matrix<double, M>& a, const std::vector<double>& b, const solver_options& options,
+    solver_result& res, std::vector<double>& r)
+{
+    if (a.get_rows_num() != a.get_cols_num()) {
+        throw vector_size_error("matrix is not square", a.get_rows_num(), a.get_cols_num());
+    }
+    if (b.size() != a.get_rows_num()) {
+        throw vector_size_error("right side size differs", a.get_rows_num(), b.size());
+    }
+    if (options.initial.empty()) {
+        res.x.assign(b.size(), 0);
+        r = b;
+        return;
+    }
+    if (options.initial.size() != b.size()) {
+        throw vector_size_error("initial vector size differs", b.size(), options.initial.size());
+    }
+    res.x = options.initial;
+    spmv(a, res.x, r, options.policy);
+    vector_for_each(r.size(), options.policy, [&](std::size_t i) { r[i] = b[i] - r[i]; });
+}
+
+/// Запись невязки, возвращает true, если требуемая точность достигнута
+inline bool solver_record(solver_result& res, const solver_options& options, double residual) {
+    res.residual = residual;
+    if (options.track_residuals) {
+        res.residuals.push_back(residual);
+    }
+    res.converged = residual <= options.tolerance;
+    return res.converged;
+}
+
+/**
+    \brief Метод сопряженных градиентов с предобусловливанием
+
+    Для симметричных положительно определенных матриц. На итерации -
+    одно произведение матрицы на вектор и одно применение
+    предобусловливателя. Останавливается, когда относительная невязка не
+    больше options.tolerance, после max_iterations итераций или при
+    вырождении (p^T A p <= 0 - матрица не положительно определена).
+*/
+template <template <class...> class M, class Preconditioner = Identity_preconditioner>
+solver_result conjugate_gradient(const Matrix<double, M>& a, const std::vector<double>& b,
+    const Preconditioner& precond = Preconditioner(), const solver_options& options = solver_options())
+{
+    const auto& policy = options.policy;
+    solver_result res;
+    std::vector<double> r;
+    solver_start(a, b, options, res, r);
+    double b_norm = vector_norm(b, policy);
+    if (b_norm == 0) {
+        res.x.assign(b.size(), 0);
+        solver_record(res, options, 0);
+        return res;
+    }
+    if (solver_record(res, options, vector_norm(r, policy) / b_norm)) {
+        return res;
+    }
+    std::vector<double> z;
+    precond.apply(r, z);
+    std::vector<double> p = z;
+    std::vector<double> ap;
+    double rz = vector_dot(r, z, policy);
+    while (res.iterations < options.max_iterations) {
+        spmv(a, p, ap, policy);
+        double pap = vector_dot(p, ap, policy);
+        if (!(pap > 0)) {
+            break;
+        }
+        double alpha = rz / pap;
+        vector_for_each(r.size(), policy, [&](std::size_t i) {
+            res.x[i] += alpha * p[i];
+            r[i] -= alpha * ap[i];
+        });
+        ++res.iterations;
+        if (solver_record(res, options, vector_norm(r, policy) / b_norm)) {
+            break;
+        }
+        precond.apply(r, z);
+        double rz_next = vector_dot(r, z, policy);
+        double beta = rz_next / rz;
+        rz = rz_next;
+        vector_for_each(p.size(), policy, [&](std::size_t i) { p[i] = z[i] + beta * p[i]; });
+    }
+    return res;
+}
+
+/**
+    \brief Стабилизированный метод бисопряженных градиентов (BiCGSTAB)
+
+    Для несимметричных матриц; предобусловливание справа. На итерации -
+    два произведения матрицы на вектор и два применения
+    предобусловливателя. Останавливается по невязке, количеству итераций
+    или при вырождении (rho = 0 или omega = 0).
+*/
+template <template <class...> class M, class Preconditioner = Identity_preconditioner>
+solver_result bicgstab(const Matrix<double, M>& a, const std::vector<double>& b,
+    const Preconditioner& precond = Preconditioner(), const solver_options& options = solver_options())
+{
+    const auto& policy = options.policy;
+    solver_result res;
+    std::vector<double> r;
+    solver_start(a, b, options, res, r);
+    double b_norm = vector_norm(b, policy);
+    if (b_norm == 0) {
+        res.x.assign(b.size(), 0);
+        solver_record(res, options, 0);
+        return res;
+    }
+    if (solver_record(res, options, vector_norm(r, policy) / b_norm)) {
+        return res;
+    }
+    auto n = r.size();
+    std::vector<double> r_hat = r;
+    std::vector<double> p(n, 0), v(n, 0), s(n), t, y, z;
+    double rho = 1;
+    double alpha = 1;
+    double omega = 1;
+    while (res.iterations < options.max_iterations) {
+        double rho_next = vector_dot(r_hat, r, policy);
+        if (rho_next == 0) {
+            break;
+        }
+        double beta = (rho_next / rho) * (alpha / omega);
+        rho = rho_next;
+        vector_for_each(n, policy, [&](std::size_t i) { p[i] = r[i] + beta * (p[i] - omega * v[i]); });
+        precond.apply(p, y);
+        spmv(a, y, v, policy);
+        double r_hat_v = vector_dot(r_hat, v, policy);
+        if (r_hat_v == 0) {
+            break;
+        }
+        alpha = rho / r_hat_v;
+        vector_for_each(n, policy, [&](std::size_t i) { s[i] = r[i] - alpha * v[i]; });
+        ++res.iterations;
+        // невязка после половины шага может уже быть достаточной
+        double s_residual = vector_norm(s, policy) / b_norm;
+        if (s_residual <= options.tolerance) {
+            vector_for_each(n, policy, [&](std::size_t i) { res.x[i] += alpha * y[i]; });
+            solver_record(res, options, s_residual);
+            break;
+        }
+        precond.apply(s, z);
+        spmv(a, z, t, policy);
+        double tt = vector_dot(t, t, policy);
+        omega = tt == 0 ? 0 : vector_dot(t, s, policy) / tt;
+        vector_for_each(n, policy, [&](std::size_t i) {
+            res.x[i] += alpha * y[i] + omega * z[i];
+            r[i] = s[i] - omega * t[i];
+        });
+        if (solver_record(res, options, vector_norm(r, policy) / b_norm) || omega == 0) {
+            break;
+        }
+    }
+    return res;
+}
+
+/// Класс тестирования произведения на вектор и итерационных решателей
+class SolverTest {
+public:
+    /// Матрица одномерного уравнения -u'' + c u' с шагом h = 1
+    template <template <class...> class M>
+    static Matrix<double, M> laplace(unsigned n, double convection) {
+        std::vector<std::tuple<unsigned, unsigned, double>> coo;
+        for (unsigned i = 1; i <= n; ++i) {
+            coo.emplace_back(i, i, 2 + 0.001 * i);
+            if (i > 1) {
+                coo.emplace_back(i, i - 1, -1 - convection);
+            }
+            if (i < n) {
+                coo.emplace_back(i, i + 1, -1 + convection);
+            }
+        }
+        return Matrix<double, M>::from_triplets(coo, n, n, 1e-300);
+    }
+
+    /// Относительная невязка решения
+    template <template <class...> class M>
+    static double residual(const Matrix<double, M>& a, const std::vector<double>& x, const std::vector<double>& b) {
+        auto ax = spmv(a, x);
+        for (std::size_t i = 0; i < ax.size(); ++i) {
+            ax[i] -= b[i];
+        }
+        return vector_norm(ax) / vector_norm(b);
+    }
+
+    template <template <class...> class M>
+    static void check_spmv(const std::string& name) {
+        auto a = ParallelTest::sample<double, M>(40, 5);
+        std::vector<double> x(40);
+        Matrix<double, M> column(40, 1, 1e-300);
+        for (unsigned i = 0; i < 40; ++i) {
+            x[i] = 0.5 + i % 7;
+            column[std::make_pair(i + 1, 1u)] = x[i];
+        }
+        auto y = spmv(a, x);
+        auto product = a * column;
+        for (unsigned i = 0; i < 40; ++i) {
+            if (std::abs(y[i] - product(i + 1, 1)) > 1e-9) {
+                throw test_failed_error(name + " spmv test failed");
+            }
+        }
+        if (spmv(a, x, Matrix_execution::parallel(4)) != y) {
+            throw test_failed_error(name + " parallel spmv test failed");
+        }
+    }
+
+    void operator() () {
+        check_spmv<std::map>("map");
+        check_spmv<csr_map>("csr");
+        check_spmv<dense_map>("dense");
+        check_spmv<flat_hash_map>("hash");
+        const unsigned n = 400;
+        std::vector<double> b(n);
+        for (unsigned i = 0; i < n; ++i) {
+            b[i] = 1 + (i % 5);
+        }
+        solver_options options;
+        options.tolerance = 1e-10;
+        options.track_residuals = true;
+        auto a = laplace<csr_map>(n, 0);
+        auto cg = conjugate_gradient(a, b, Identity_preconditioner(), options);
+        if (!cg.converged || residual(a, cg.x, b) > 1e-9 ||
+            cg.residuals.size() != cg.iterations + 1 || cg.residuals.back() != cg.residual)
+        {
+            throw test_failed_error("cg test failed");
+        }
+        options.policy = Matrix_execution::parallel(4);
+        auto cg_par = conjugate_gradient(a, b, Identity_preconditioner(), options);
+        if (cg_par.x != cg.x || cg_par.iterations != cg.iterations) {
+            throw test_failed_error("parallel cg test failed");
+        }
+        options.policy = Matrix_execution::sequential();
+        // плохо масштабированная система: Якоби сокращает число итераций
+        std::vector<std::tuple<unsigned, unsigned, double>> coo;
+        for (unsigned i = 1; i <= n; ++i) {
+            double scale = 1 + (i % 10) * 100;
+            coo.emplace_back(i, i, 4 * scale);
+            if (i < n) {
+                coo.emplace_back(i, i + 1, 1);
+                coo.emplace_back(i + 1, i, 1);
+            }
+        }
+        auto scaled = Matrix<double>::from_triplets(coo, n, n, 1e-300);
+        auto plain = conjugate_gradient(scaled, b, Identity_preconditioner(), options);
+        auto jacobi = conjugate_gradient(scaled, b, Jacobi_preconditioner(scaled), options);
+        if (!jacobi.converged || jacobi.iterations >= plain.iterations || residual(scaled, jacobi.x, b) > 1e-9) {
+            throw test_failed_error("jacobi cg test failed");
+        }
+        auto nonsym = laplace<csr_map>(n, 0.3);
+        auto bi = bicgstab(nonsym, b, Jacobi_preconditioner(nonsym), options);
+        if (!bi.converged || residual(nonsym, bi.x, b) > 1e-9 || bi.residuals.size() != bi.iterations + 1) {
+            throw test_failed_error("bicgstab test failed");
+        }
+        options.initial = bi.x;
+        auto warm = bicgstab(nonsym, b, Identity_preconditioner(), options);
+        if (!warm.converged || warm.iterations > 1) {
+            throw test_failed_error("bicgstab initial test failed");
+        }
+        bool thrown = false;
+        try {
+            spmv(a, std::vector<double>(n + 1));
+        } catch (vector_size_error& ex) {
+            thrown = ex.expected == n && ex.size == n + 1;
+        }
+        if (!thrown) {
+            throw test_failed_error("spmv size test failed");
+        }
+        std::cout << "solver tests completed" << std::endl;
+    }
+};
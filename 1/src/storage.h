@@ -0,0 +1,258 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+    \brief Элемент контейнера, выдаваемый итератором
+
+    Аналог std::pair, у которого второе поле является ссылкой на значение,
+    хранящееся в массиве. Поддерживает структурное связывание.
+*/
+template <class K, class V>
+struct storage_entry {
+    K first;
+    V& second;
+};
+
+/**
+    \brief Признак упорядоченного контейнера
+
+    Контейнер считается упорядоченным, если обход строк и элементов в строке
+    идет по возрастанию номеров. Для таких контейнеров операции над матрицами
+    строят результат слиянием за один проход.
+*/
+template <class C>
+struct is_ordered_storage : std::true_type {};
+
+template <class K, class V, class... Rest>
+struct is_ordered_storage<std::unordered_map<K, V, Rest...>> : std::false_type {};
+
+/**
+    \brief Признак плотного контейнера
+
+    Плотный контейнер хранит все ячейки матрицы; для него Matrix
+    использует отдельные вычислительные ядра.
+*/
+template <class C>
+struct is_dense_storage : std::false_type {};
+
+/**
+    \brief Задание размеров контейнера
+
+    Вызывается Matrix при создании контейнера и изменении размеров матрицы.
+    Разреженным контейнерам размеры не нужны.
+*/
+template <class C>
+void storage_resize(C&, unsigned, unsigned) {}
+
+template <class K, class V>
+class dense_map;
+
+/**
+    \brief Доступ к плотному представлению контейнера
+
+    Возвращает указатель на плотный контейнер, если элементы сейчас
+    хранятся плотно, иначе nullptr. Используется для выбора ядра умножения.
+*/
+template <class C>
+dense_map<unsigned, dense_map<unsigned, typename C::mapped_type::mapped_type>>* storage_dense(C&) {
+    return nullptr;
+}
+
+/// Доступ к плотному представлению константного контейнера
+template <class C>
+const dense_map<unsigned, dense_map<unsigned, typename C::mapped_type::mapped_type>>* storage_dense(const C&) {
+    return nullptr;
+}
+
+/**
+    \brief Подстройка представления под заполненность
+
+    Вызывается Matrix после операций, меняющих много элементов.
+    Контейнеры с одним представлением ничего не делают.
+*/
+template <class C>
+void storage_adapt(C&, unsigned, unsigned) {}
+
+/**
+    \brief Сдвигает ли вставка в середину контейнера массивы
+
+    Для контейнеров на общих массивах вставка и удаление отдельного элемента
+    стоят O(nnz); Matrix тогда записывает блок одним проходом слияния
+    в новый контейнер. Общая версия: вставка дешевая.
+*/
+template <class C>
+bool storage_shifting(const C&) {
+    return false;
+}
+
+/**
+    \brief Добавление элемента в конец контейнера
+
+    Общая версия: обычная вставка. Для упорядоченных контейнеров элементы
+    должны подаваться по возрастанию (строка, столбец), тогда специализации
+    выполняют вставку за амортизированное O(1).
+*/
+template <class C, class V>
+void storage_append(C& map, unsigned row_num, unsigned col_num, const V& value) {
+    map[row_num][col_num] = value;
+}
+
+/// Добавление элемента в конец вложенного std::map (вставка с подсказкой)
+template <class T, class... Rest, class... RowRest>
+void storage_append(std::map<unsigned, std::map<unsigned, T, RowRest...>, Rest...>& map,
+    unsigned row_num, unsigned col_num, const T& value)
+{
+    auto row_it = map.end();
+    if (map.empty() || std::prev(map.end())->first != row_num) {
+        row_it = map.emplace_hint(map.end(), row_num, std::map<unsigned, T, RowRest...>{});
+    } else {
+        row_it = std::prev(map.end());
+    }
+    row_it->second.emplace_hint(row_it->second.end(), col_num, value);
+}
+
+/// Есть ли у контейнера резервирование места
+template <class C, class = void>
+struct has_storage_reserve : std::false_type {};
+
+template <class C>
+struct has_storage_reserve<C, std::void_t<decltype(std::declval<C&>().reserve(std::size_t(0)))>> :
+    std::true_type {};
+
+/**
+    \brief Резервирование места под nnz элементов
+
+    Вызывается перед заполнением пустого контейнера известным числом
+    элементов. Контейнеры без reserve ничего не делают.
+*/
+template <class C>
+void storage_reserve(C& map, std::size_t nnz) {
+    if constexpr (has_storage_reserve<C>::value) {
+        map.reserve(nnz);
+    }
+}
+
+/// Внешний std::unordered_map хранит строки, а не элементы: резервирование по nnz избыточно
+template <class K, class V, class... Rest>
+void storage_reserve(std::unordered_map<K, V, Rest...>&, std::size_t) {}
+
+/**
+    \brief Удаление элементов по условию
+
+    Общая версия собирает подходящие элементы и удаляет их по одному,
+    удаляя опустевшие строки.
+*/
+template <class C, class Pred>
+void storage_erase_if(C& map, Pred pred) {
+    std::vector<std::pair<unsigned, unsigned>> to_delete;
+    for (auto& [row_num, row] : map) {
+        for (auto& [col_num, elem] : row) {
+            if (pred(elem)) {
+                to_delete.push_back({row_num, col_num});
+            }
+        }
+    }
+    for (const auto& [row_num, col_num] : to_delete) {
+        map[row_num].erase(col_num);
+        if (map[row_num].empty()) {
+            map.erase(row_num);
+        }
+    }
+}
+
+/**
+    \brief Признак собственного транспонирования контейнера
+
+    Контейнер может объявить storage_transpose(const C& src, C& dst);
+    иначе Matrix транспонирует через итераторы по элементам и сборку из
+    троек с сортировкой подсчетом.
+*/
+template <class C, class = void>
+struct has_storage_transpose : std::false_type {};
+
+template <class C>
+struct has_storage_transpose<C, std::void_t<decltype(storage_transpose(std::declval<const C&>(), std::declval<C&>()))>> :
+    std::true_type {};
+
+/// Есть ли у контейнера (или строки) поиск первого ключа не меньше заданного
+template <class C, class = void>
+struct has_storage_lower_bound : std::false_type {};
+
+template <class C>
+struct has_storage_lower_bound<C, std::void_t<decltype(std::declval<const C&>().lower_bound(0u))>> :
+    std::true_type {};
+
+/// Проверка наличия size у контейнера
+template <class C, class = void>
+struct has_storage_size : std::false_type {};
+
+template <class C>
+struct has_storage_size<C, std::void_t<decltype(std::declval<const C&>().size())>> : std::true_type {};
+
+/// Число строк контейнера меньше n (false, если контейнер не знает своего размера)
+template <class C>
+bool storage_size_less(const C& map, std::size_t n) {
+    if constexpr (has_storage_size<C>::value) {
+        return map.size() < n;
+    } else {
+        return false;
+    }
+}
+
+/**
+    \brief Обход элементов блока [row_begin, row_end] x [col_begin, col_end]
+
+    f(row_num, col_num, value) вызывается только для хранимых элементов
+    блока. Строки упорядоченного контейнера ищутся через lower_bound, если
+    он есть, иначе - поиском по каждому номеру строки блока; в строке
+    первый элемент ищется lower_bound по столбцу. Если строк в контейнере
+    заведомо меньше, чем в блоке, просматривается весь контейнер. Неупорядоченные
+    строки просматриваются целиком.
+*/
+template <class C, class F>
+void storage_for_each_in(C& map, unsigned row_begin, unsigned row_end,
+    unsigned col_begin, unsigned col_end, F f)
+{
+    constexpr bool ordered = is_ordered_storage<std::remove_const_t<C>>::value;
+    auto visit_row = [&](unsigned row_num, auto&& row) {
+        using R = std::remove_reference_t<decltype(row)>;
+        if constexpr (ordered && has_storage_lower_bound<R>::value) {
+            for (auto it = row.lower_bound(col_begin); it != row.end() && it->first <= col_end; ++it) {
+                f(row_num, it->first, it->second);
+            }
+        } else {
+            for (auto it = row.begin(); it != row.end(); ++it) {
+                if (it->first >= col_begin && it->first <= col_end) {
+                    f(row_num, it->first, it->second);
+                }
+            }
+        }
+    };
+    if constexpr (ordered && has_storage_lower_bound<std::remove_const_t<C>>::value) {
+        for (auto it = map.lower_bound(row_begin); it != map.end() && it->first <= row_end; ++it) {
+            visit_row(it->first, it->second);
+        }
+    } else if (storage_size_less(map, std::size_t(row_end - row_begin) + 1)) {
+        for (auto it = map.begin(); it != map.end(); ++it) {
+            if (it->first >= row_begin && it->first <= row_end) {
+                visit_row(it->first, it->second);
+            }
+        }
+    } else {
+        for (unsigned row_num = row_begin; row_num <= row_end; ++row_num) {
+            auto it = map.find(row_num);
+            if (it != map.end()) {
+                visit_row(row_num, it->second);
+            }
+        }
+    }
+}
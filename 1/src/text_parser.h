@@ -0,0 +1,205 @@
+#pragma once
+
+#include "rational.h"
+#include <charconv>
+#include <cstddef>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+/// Проверка пробельного символа (без учета локали)
+inline bool text_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+/**
+    \brief Последовательное чтение строк текста
+
+    Строки возвращаются как string_view внутрь исходного текста, без
+    копирования и без символа перевода строки.
+*/
+class Text_lines {
+public:
+    explicit Text_lines(std::string_view text) : text_(text) {}
+
+    /// Метод получения следующей строки (false, если текст закончился)
+    bool next(std::string_view& line) {
+        if (pos_ >= text_.size()) {
+            return false;
+        }
+        auto end = text_.find('\n', pos_);
+        if (end == std::string_view::npos) {
+            end = text_.size();
+        }
+        line = text_.substr(pos_, end - pos_);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        pos_ = end + 1;
+        return true;
+    }
+
+    /// Метод получения позиции начала следующей строки
+    std::size_t position() const {
+        return pos_;
+    }
+
+private:
+    std::string_view text_;
+    std::size_t pos_ = 0;
+};
+
+/// Разбиение строки на слова по пробельным символам без выделения памяти
+class Text_tokens {
+public:
+    explicit Text_tokens(std::string_view line) : line_(line) {}
+
+    /// Метод получения следующего слова (false, если слов больше нет)
+    bool next(std::string_view& token) {
+        while (pos_ < line_.size() && text_is_space(line_[pos_])) {
+            ++pos_;
+        }
+        if (pos_ == line_.size()) {
+            return false;
+        }
+        auto begin = pos_;
+        while (pos_ < line_.size() && !text_is_space(line_[pos_])) {
+            ++pos_;
+        }
+        token = line_.substr(begin, pos_ - begin);
+        return true;
+    }
+
+    /// Метод чтения до count слов в массив, возвращает количество прочитанных
+    std::size_t read(std::string_view* tokens, std::size_t count) {
+        std::size_t res = 0;
+        while (res < count && next(tokens[res])) {
+            ++res;
+        }
+        return res;
+    }
+
+private:
+    std::string_view line_;
+    std::size_t pos_ = 0;
+};
+
+/// Разбор целого числа, занимающего всю строку
+template <class T>
+std::enable_if_t<std::is_integral_v<T>, bool> parse_value(std::string_view s, T& out) {
+    const char* first = s.data();
+    if (!s.empty() && s[0] == '+') {
+        ++first;
+    }
+    auto [ptr, ec] = std::from_chars(first, s.data() + s.size(), out);
+    return ec == std::errc() && ptr == s.data() + s.size() && first != ptr;
+}
+
+/// Разбор вещественного числа, занимающего всю строку
+inline bool parse_value(std::string_view s, double& out) {
+    const char* first = s.data();
+    if (!s.empty() && s[0] == '+') {
+        ++first;
+    }
+    auto [ptr, ec] = std::from_chars(first, s.data() + s.size(), out);
+    return ec == std::errc() && ptr == s.data() + s.size() && first != ptr;
+}
+
+/// Разбор рационального числа вида <числитель> или <числитель/знаменатель>
+template <class T>
+bool parse_value(std::string_view s, RationalNumber<T>& out) {
+    if (s.size() < 3 || s.front() != '<' || s.back() != '>') {
+        return false;
+    }
+    s = s.substr(1, s.size() - 2);
+    auto slash = s.find('/');
+    T numerator;
+    T denominator = 1;
+    if (!parse_value(s.substr(0, slash), numerator)) {
+        return false;
+    }
+    if (slash != std::string_view::npos &&
+        (!parse_value(s.substr(slash + 1), denominator) || denominator <= 0))
+    {
+        return false;
+    }
+    out = RationalNumber<T>(numerator, denominator);
+    return true;
+}
+
+/// Результат разбора строки элемента матрицы
+enum class text_line_status {
+    /// пустая строка или комментарий
+    skip,
+    /// элемент прочитан
+    element,
+    /// меньше трех слов
+    invalid_line,
+    /// номер строки или столбца не число
+    invalid_index,
+    /// номер строки вне матрицы
+    invalid_row,
+    /// номер столбца вне матрицы
+    invalid_col,
+    /// значение не разбирается
+    invalid_value,
+};
+
+/**
+    \brief Разбор строки "строка столбец значение"
+
+    Проверки идут в том же порядке, что и сообщения об ошибках
+    Matrix::from_file. Лишние слова после значения игнорируются.
+*/
+template <class T>
+text_line_status parse_element_line(std::string_view line, unsigned rows_num, unsigned cols_num,
+    unsigned& row_num, unsigned& col_num, T& value)
+{
+    std::string_view w[3];
+    Text_tokens tokens(line);
+    auto count = tokens.read(w, 3);
+    if (count == 0 || w[0][0] == '#') {
+        return text_line_status::skip;
+    }
+    if (count < 3) {
+        return text_line_status::invalid_line;
+    }
+    if (!parse_value(w[0], row_num) || !parse_value(w[1], col_num)) {
+        return text_line_status::invalid_index;
+    }
+    if (row_num < 1 || row_num > rows_num) {
+        return text_line_status::invalid_row;
+    }
+    if (col_num < 1 || col_num > cols_num) {
+        return text_line_status::invalid_col;
+    }
+    if (!parse_value(w[2], value)) {
+        return text_line_status::invalid_value;
+    }
+    return text_line_status::element;
+}
+
+/// Текст сообщения об ошибке для результата разбора строки элемента
+template <class T>
+const char* text_line_error(text_line_status status) {
+    switch (status) {
+    case text_line_status::invalid_line:
+        return "invalid line: ";
+    case text_line_status::invalid_index:
+        return "invalid index: ";
+    case text_line_status::invalid_row:
+        return "invalid row index: ";
+    case text_line_status::invalid_col:
+        return "invalid col index: ";
+    case text_line_status::invalid_value:
+        if (std::is_same_v<T, int>) {
+            return "invalid integer: ";
+        }
+        if (std::is_same_v<T, double>) {
+            return "invalid float: ";
+        }
+        return "invalid rational: ";
+    default:
+        return "";
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "rational.h"
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+
+/**
+    \brief Буферизованная запись текста в поток
+
+    Числа форматируются через to_chars прямо в буфер фиксированного
+    размера, заполненный буфер сбрасывается в поток целиком. Память не
+    зависит от объема записанного текста.
+*/
+class Text_writer {
+public:
+    /// Размер буфера в байтах
+    static constexpr std::size_t buffer_size = 1 << 16;
+    /// Наибольшая длина одного числа
+    static constexpr std::size_t max_value_size = 384;
+
+    explicit Text_writer(std::ostream& out) : out_(out) {}
+
+    Text_writer(const Text_writer&) = delete;
+    Text_writer& operator= (const Text_writer&) = delete;
+
+    ~Text_writer() {
+        flush();
+    }
+
+    /// Запись символа
+    void put(char c) {
+        reserve(1);
+        buffer_[size_++] = c;
+    }
+
+    /// Запись строки
+    void put(std::string_view s) {
+        while (!s.empty()) {
+            reserve(1);
+            auto count = std::min(s.size(), buffer_size - size_);
+            std::copy_n(s.data(), count, buffer_ + size_);
+            size_ += count;
+            s.remove_prefix(count);
+        }
+    }
+
+    /// Запись целого числа
+    template <class T>
+    std::enable_if_t<std::is_integral_v<T>> put_value(T value) {
+        reserve(max_value_size);
+        size_ = std::to_chars(buffer_ + size_, buffer_ + buffer_size, value).ptr - buffer_;
+    }
+
+    /// Запись вещественного числа (как std::to_string: 6 знаков после точки)
+    void put_value(double value) {
+        reserve(max_value_size);
+        size_ = std::to_chars(buffer_ + size_, buffer_ + buffer_size, value,
+            std::chars_format::fixed, 6).ptr - buffer_;
+    }
+
+    /// Запись рационального числа в виде <числитель/знаменатель>
+    template <class T>
+    void put_value(const RationalNumber<T>& value) {
+        put('<');
+        put_value(value.get_numerator());
+        put('/');
+        put_value(value.get_denominator());
+        put('>');
+    }
+
+    /// Сброс буфера в поток
+    void flush() {
+        if (size_ > 0) {
+            out_.write(buffer_, size_);
+            size_ = 0;
+        }
+    }
+
+private:
+    /// Освобождение места под count символов
+    void reserve(std::size_t count) {
+        if (buffer_size - size_ < count) {
+            flush();
+        }
+    }
+
+    std::ostream& out_;
+    char buffer_[buffer_size];
+    std::size_t size_ = 0;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "storage.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/// Обработка повторяющихся позиций при сборке матрицы из троек
+enum class triplet_duplicates {
+    /// значения складываются
+    sum,
+    /// остается последнее значение
+    overwrite,
+};
+
+/// Элемент матрицы в координатном формате
+template <class T>
+struct matrix_triplet {
+    unsigned row;
+    unsigned col;
+    T value;
+};
+
+/**
+    \brief Сборка контейнера матрицы из троек (строка, столбец, значение)
+
+    Тройки накапливаются в массиве в любом порядке. При сборке они
+    сортируются по (строка, столбец) подсчетом по строкам (уже
+    упорядоченный массив не переставляется), повторы объединяются, элементы
+    меньше eps отбрасываются, и контейнер заполняется одним проходом
+    добавления в конец (storage_append).
+
+    Номера строк не должны превышать rows_num, переданного в конструктор;
+    проверку выполняет Matrix.
+*/
+template <class T>
+class Triplet_builder {
+public:
+    explicit Triplet_builder(unsigned rows_num) : rows_num_(rows_num) {}
+
+    /// Метод резервирования памяти под count троек
+    void reserve(std::size_t count) {
+        data_.reserve(count);
+    }
+
+    /// Метод добавления тройки
+    void add(unsigned row_num, unsigned col_num, const T& value) {
+        data_.push_back({row_num, col_num, value});
+    }
+
+    /// Метод добавления диапазона троек (кортежи или структуры из трех полей)
+    template <class Range>
+    void append(const Range& triplets) {
+        for (const auto& [row_num, col_num, value] : triplets) {
+            add(row_num, col_num, value);
+        }
+    }
+
+    std::size_t size() const { return data_.size(); }
+    bool empty() const { return data_.empty(); }
+
+    /// Накопленные тройки (после build - упорядоченные)
+    const std::vector<matrix_triplet<T>>& triplets() const { return data_; }
+
+    /// Заполнение пустого контейнера
+    template <class C>
+    void build(C& map, double eps, triplet_duplicates mode) {
+        using std::abs;
+        sort();
+        for (std::size_t i = 0; i < data_.size();) {
+            auto row_num = data_[i].row;
+            auto col_num = data_[i].col;
+            T value = data_[i].value;
+            for (++i; i < data_.size() && data_[i].row == row_num && data_[i].col == col_num; ++i) {
+                if (mode == triplet_duplicates::sum) {
+                    value += data_[i].value;
+                } else {
+                    value = data_[i].value;
+                }
+            }
+            if (!(abs(value) < eps)) {
+                storage_append(map, row_num, col_num, value);
+            }
+        }
+    }
+
+private:
+    static bool less(const matrix_triplet<T>& a, const matrix_triplet<T>& b) {
+        return a.row < b.row || (a.row == b.row && a.col < b.col);
+    }
+
+    /// Устойчивая сортировка: подсчет по строкам, затем по столбцам внутри строк
+    void sort() {
+        if (std::is_sorted(data_.begin(), data_.end(), less)) {
+            return;
+        }
+        std::vector<std::size_t> row_begin(std::size_t(rows_num_) + 2, 0);
+        for (const auto& t : data_) {
+            ++row_begin[t.row + 1];
+        }
+        for (std::size_t r = 0; r <= rows_num_; ++r) {
+            row_begin[r + 1] += row_begin[r];
+        }
+        std::vector<matrix_triplet<T>> sorted(data_.size());
+        auto next = row_begin;
+        for (auto& t : data_) {
+            sorted[next[t.row]++] = std::move(t);
+        }
+        auto col_less = [](const auto& a, const auto& b) { return a.col < b.col; };
+        for (std::size_t r = 0; r <= rows_num_; ++r) {
+            auto first = sorted.begin() + row_begin[r];
+            auto last = sorted.begin() + row_begin[r + 1];
+            if (!std::is_sorted(first, last, col_less)) {
+                std::stable_sort(first, last, col_less);
+            }
+        }
+        data_ = std::move(sorted);
+    }
+
+    unsigned rows_num_;
+    std::vector<matrix_triplet<T>> data_;
+};